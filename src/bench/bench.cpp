@@ -0,0 +1,144 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <regex>
+
+namespace {
+
+/** Time per iteration of each evaluation, sorted. */
+std::vector<double> PerIteration(const benchmark::State &state) {
+    std::vector<double> times;
+    for (const double elapsed : state.GetElapsed()) {
+        times.push_back(elapsed / state.GetNumIters());
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+double Median(const std::vector<double> &sorted) {
+    const size_t n = sorted.size();
+    if (n == 0) {
+        return 0;
+    }
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+} // namespace
+
+bool benchmark::State::UpdateTimer(const time_point finish) {
+    if (m_started) {
+        m_elapsed.push_back(
+            std::chrono::duration<double>(finish - m_start).count());
+        if (m_elapsed.size() == m_num_evals) {
+            return false;
+        }
+    }
+    m_started = true;
+    m_num_iters_left = m_num_iters - 1;
+    m_start = clock::now();
+    return true;
+}
+
+void benchmark::CsvPrinter::header() {
+    std::cout << "# Benchmark, evals, iterations, total, min, max, median, "
+                 "counters"
+              << std::endl;
+}
+
+void benchmark::CsvPrinter::result(const State &state) {
+    const std::vector<double> times = PerIteration(state);
+    const double total = std::accumulate(state.GetElapsed().begin(),
+                                         state.GetElapsed().end(), 0.0);
+    std::cout << state.GetName() << ", " << state.GetElapsed().size() << ", "
+              << state.GetNumIters() << ", " << total << ", "
+              << (times.empty() ? 0 : times.front()) << ", "
+              << (times.empty() ? 0 : times.back()) << ", " << Median(times)
+              << ",";
+    for (const auto &counter : state.GetCounters()) {
+        std::cout << " " << counter.first << "=" << counter.second;
+    }
+    std::cout << std::endl;
+}
+
+void benchmark::JsonPrinter::header() {
+    std::cout << "[";
+}
+
+void benchmark::JsonPrinter::result(const State &state) {
+    const std::vector<double> times = PerIteration(state);
+    const double total = std::accumulate(state.GetElapsed().begin(),
+                                         state.GetElapsed().end(), 0.0);
+    std::cout << (m_first ? "\n" : ",\n") << "  {\"name\": \"" << state.GetName()
+              << "\", \"evals\": " << state.GetElapsed().size()
+              << ", \"iterations\": " << state.GetNumIters()
+              << ", \"total\": " << total
+              << ", \"min\": " << (times.empty() ? 0 : times.front())
+              << ", \"max\": " << (times.empty() ? 0 : times.back())
+              << ", \"median\": " << Median(times) << ", \"counters\": {";
+    bool first_counter = true;
+    for (const auto &counter : state.GetCounters()) {
+        std::cout << (first_counter ? "" : ", ") << "\"" << counter.first
+                  << "\": " << counter.second;
+        first_counter = false;
+    }
+    std::cout << "}}";
+    m_first = false;
+}
+
+void benchmark::JsonPrinter::footer() {
+    std::cout << "\n]" << std::endl;
+}
+
+benchmark::BenchRunner::BenchmarkMap &benchmark::BenchRunner::benchmarks() {
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+benchmark::BenchRunner::BenchRunner(std::string name,
+                                    benchmark::BenchFunction func,
+                                    uint64_t num_iters_for_one_second) {
+    benchmarks().insert(
+        std::make_pair(name, Bench{func, num_iters_for_one_second}));
+}
+
+void benchmark::BenchRunner::RunAll(Printer &printer, uint64_t num_evals,
+                                    double scaling, const std::string &filter,
+                                    bool is_list_only) {
+    const std::regex reFilter(filter);
+    std::smatch baseMatch;
+
+    if (!is_list_only) {
+        printer.header();
+    }
+
+    for (const auto &p : benchmarks()) {
+        if (!std::regex_match(p.first, baseMatch, reFilter)) {
+            continue;
+        }
+
+        if (is_list_only) {
+            std::cout << p.first << std::endl;
+            continue;
+        }
+
+        const uint64_t num_iters = std::max<uint64_t>(
+            1, static_cast<uint64_t>(p.second.num_iters_for_one_second *
+                                     scaling));
+        State state(p.first, num_evals, num_iters);
+        p.second.func(state);
+        printer.result(state);
+    }
+
+    if (!is_list_only) {
+        printer.footer();
+    }
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_BENCH_BENCH_H
+#define MVC_BENCH_BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+// Simple micro-benchmarking framework; API mostly matches a subset of the
+// Google Benchmark framework (see https://github.com/google/benchmark)
+// Why not use the Google Benchmark framework? Because adding Yet Another
+// Dependency (that uses cmake as its build system and has lots of features
+// we don't need) isn't worth it.
+
+/*
+ * Usage:
+
+static void CODE_TO_TIME(benchmark::State& state)
+{
+    ... do any setup needed...
+    while (state.KeepRunning()) {
+       ... do stuff you want to time...
+    }
+    ... do any cleanup needed...
+}
+
+// default to running benchmark for 5000 iterations
+BENCHMARK(CODE_TO_TIME, 5000);
+
+ */
+
+namespace benchmark {
+
+using clock = std::chrono::steady_clock;
+using time_point = std::chrono::time_point<clock>;
+
+/** Times the loop of one benchmark, num_evals times num_iters iterations. */
+class State {
+public:
+    State(std::string name, uint64_t num_evals, uint64_t num_iters)
+        : m_name(std::move(name)), m_num_evals(num_evals),
+          m_num_iters(num_iters) {}
+
+    inline bool KeepRunning() {
+        if (m_num_iters_left != 0) {
+            --m_num_iters_left;
+            return true;
+        }
+        return UpdateTimer(clock::now());
+    }
+
+    const std::string &GetName() const { return m_name; }
+    uint64_t GetNumIters() const { return m_num_iters; }
+    /** Duration of each evaluation in seconds. */
+    const std::vector<double> &GetElapsed() const { return m_elapsed; }
+
+    /**
+     * Report a value measured by the benchmark besides its time, e.g. the
+     * memory used per element. Setting a counter again replaces its value.
+     */
+    void SetCounter(const std::string &name, double value) {
+        m_counters[name] = value;
+    }
+    const std::map<std::string, double> &GetCounters() const {
+        return m_counters;
+    }
+
+private:
+    bool UpdateTimer(time_point finish);
+
+    const std::string m_name;
+    const uint64_t m_num_evals;
+    const uint64_t m_num_iters;
+    uint64_t m_num_iters_left{0};
+    bool m_started{false};
+    time_point m_start;
+    std::vector<double> m_elapsed;
+    std::map<std::string, double> m_counters;
+};
+
+typedef std::function<void(State &)> BenchFunction;
+
+/** Writes the results of the benchmarks in a machine-readable format. */
+class Printer {
+public:
+    virtual ~Printer() = default;
+    virtual void header() = 0;
+    virtual void result(const State &state) = 0;
+    virtual void footer() = 0;
+};
+
+/**
+ * One line of comma separated values per benchmark, the counters in the last
+ * field as space separated name=value pairs.
+ */
+class CsvPrinter : public Printer {
+public:
+    void header() override;
+    void result(const State &state) override;
+    void footer() override {}
+};
+
+/** A JSON array with one object per benchmark. */
+class JsonPrinter : public Printer {
+public:
+    void header() override;
+    void result(const State &state) override;
+    void footer() override;
+
+private:
+    bool m_first{true};
+};
+
+class BenchRunner {
+    struct Bench {
+        BenchFunction func;
+        uint64_t num_iters_for_one_second;
+    };
+    typedef std::map<std::string, Bench> BenchmarkMap;
+    static BenchmarkMap &benchmarks();
+
+public:
+    BenchRunner(std::string name, BenchFunction func,
+                uint64_t num_iters_for_one_second);
+
+    static void RunAll(Printer &printer, uint64_t num_evals, double scaling,
+                       const std::string &filter, bool is_list_only);
+};
+
+} // namespace benchmark
+
+// BENCHMARK(foo, num_iters_for_one_second) expands to:  benchmark::BenchRunner
+// bench_11foo("foo", num_iterations);
+// Choose a num_iters_for_one_second that takes roughly 1 second. The goal is
+// that all benchmarks should take approximately the same time, and scaling
+// factor can be used that the total time is appropriate for your system.
+#define BENCHMARK(n, num_iters_for_one_second)                                 \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(    \
+        BOOST_PP_STRINGIZE(n), n, (num_iters_for_one_second));
+
+#endif // MVC_BENCH_BENCH_H
@@ -0,0 +1,117 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+
+#include "chainparams.h"
+#include "chainparamsbase.h"
+#include "config.h"
+#include "crypto/sha256.h"
+#include "fs.h"
+#include "random.h"
+#include "script/scriptcache.h"
+#include "script/sigcache.h"
+#include "util.h"
+#include "utilstrencodings.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+static const int64_t DEFAULT_BENCH_EVALUATIONS = 5;
+static const char *DEFAULT_BENCH_FILTER = ".*";
+static const char *DEFAULT_BENCH_SCALING = "1.0";
+static const char *DEFAULT_BENCH_PRINTER = "csv";
+
+static std::string HelpMessage() {
+    std::string strUsage = "Usage: bench_mvc [options]\n\nOptions:\n";
+    strUsage += HelpMessageOpt("-?", "Print this help message and exit");
+    strUsage += HelpMessageOpt("-list",
+                               "List the benchmarks that match -filter and "
+                               "exit");
+    strUsage += HelpMessageOpt(
+        "-filter=<regex>",
+        strprintf("Regular expression filter to select benchmarks by name "
+                  "(default: %s)",
+                  DEFAULT_BENCH_FILTER));
+    strUsage += HelpMessageOpt(
+        "-evals=<n>",
+        strprintf("Number of timed evaluations of each benchmark (default: "
+                  "%d)",
+                  DEFAULT_BENCH_EVALUATIONS));
+    strUsage += HelpMessageOpt(
+        "-scaling=<n>",
+        strprintf("Scaling factor for the number of iterations of each "
+                  "evaluation (default: %s)",
+                  DEFAULT_BENCH_SCALING));
+    strUsage += HelpMessageOpt(
+        "-printer=<csv|json>",
+        strprintf("Output format of the results (default: %s)",
+                  DEFAULT_BENCH_PRINTER));
+    return strUsage;
+}
+
+int main(int argc, char **argv) {
+    SetupEnvironment();
+    gArgs.ParseParameters(argc, argv);
+
+    if (gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") ||
+        gArgs.IsArgSet("-help")) {
+        std::cout << HelpMessage();
+        return EXIT_SUCCESS;
+    }
+
+    const int64_t evaluations =
+        gArgs.GetArg("-evals", DEFAULT_BENCH_EVALUATIONS);
+    const std::string filter = gArgs.GetArg("-filter", DEFAULT_BENCH_FILTER);
+    const std::string scaling_str =
+        gArgs.GetArg("-scaling", DEFAULT_BENCH_SCALING);
+    const std::string printer_arg =
+        gArgs.GetArg("-printer", DEFAULT_BENCH_PRINTER);
+    const bool is_list_only = gArgs.GetBoolArg("-list", false);
+
+    double scaling_factor;
+    if (!ParseDouble(scaling_str, &scaling_factor) || scaling_factor <= 0) {
+        std::cerr << "Error parsing -scaling: " << scaling_str << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (evaluations < 1) {
+        std::cerr << "-evals must be at least 1" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<benchmark::Printer> printer;
+    if (printer_arg == "csv") {
+        printer = std::make_unique<benchmark::CsvPrinter>();
+    } else if (printer_arg == "json") {
+        printer = std::make_unique<benchmark::JsonPrinter>();
+    } else {
+        std::cerr << "Unknown -printer: " << printer_arg << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SHA256AutoDetect();
+    RandomInit();
+    SelectParams(CBaseChainParams::MAIN);
+    GlobalConfig::GetModifiableGlobalConfig().SetDefaultBlockSizeParams(
+        Params().GetDefaultBlockSizeParams());
+    InitSignatureCache();
+    InitScriptExecutionCache();
+
+    // The mempool keeps its transaction database under the data directory.
+    const fs::path datadir = fs::temp_directory_path() /
+                             strprintf("bench_mvc_%lu_%i", GetTime(),
+                                       int(GetRand(100000)));
+    fs::create_directories(datadir);
+    gArgs.ForceSetArg("-datadir", datadir.string());
+
+    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor,
+                                   filter, is_list_only);
+
+    ClearDatadirCache();
+    fs::remove_all(datadir);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench_util.h"
+
+#include "consensus/merkle.h"
+#include "hash.h"
+#include "script/script.h"
+
+namespace {
+
+uint256 SeedHash(uint32_t seed, uint32_t index) {
+    CHashWriter hasher(SER_GETHASH, 0);
+    hasher << seed << index;
+    return hasher.GetHash();
+}
+
+CScript P2PKHScript(const uint256 &seed) {
+    const std::vector<uint8_t> keyHash(seed.begin(), seed.begin() + 20);
+    return CScript() << OP_DUP << OP_HASH160 << keyHash << OP_EQUALVERIFY
+                     << OP_CHECKSIG;
+}
+
+CScript P2PKHScriptSig(const uint256 &seed) {
+    // DER signature with sighash byte and compressed public key.
+    std::vector<uint8_t> sig(72, 0x30);
+    std::copy(seed.begin(), seed.end(), sig.begin() + 8);
+    std::vector<uint8_t> pubkey(33, 0x02);
+    std::copy(seed.begin(), seed.end(), pubkey.begin() + 1);
+    return CScript() << sig << pubkey;
+}
+
+} // namespace
+
+CMutableTransaction CreateBenchTransaction(int32_t version, size_t inputs,
+                                           size_t outputs, uint32_t seed) {
+    CMutableTransaction tx;
+    tx.nVersion = version;
+    tx.vin.resize(inputs);
+    for (size_t i = 0; i < inputs; ++i) {
+        const uint256 hash = SeedHash(seed, i);
+        tx.vin[i].prevout = COutPoint(hash, i % 4);
+        tx.vin[i].scriptSig = P2PKHScriptSig(hash);
+    }
+    tx.vout.resize(outputs);
+    for (size_t i = 0; i < outputs; ++i) {
+        tx.vout[i].nValue = Amount(1000 + i);
+        tx.vout[i].scriptPubKey = P2PKHScript(SeedHash(~seed, i));
+    }
+    return tx;
+}
+
+CBlock CreateBenchBlock(size_t txCount, int32_t txVersion) {
+    CBlock block;
+    block.nVersion = 0x20000000;
+    block.nTime = 1600000000;
+    block.nBits = 0x207fffff;
+
+    CMutableTransaction coinbase;
+    coinbase.nVersion = txVersion;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout = COutPoint();
+    coinbase.vin[0].scriptSig = CScript() << 1000 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = Amount(5000000000);
+    coinbase.vout[0].scriptPubKey = P2PKHScript(SeedHash(0, 0));
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+
+    for (size_t i = 1; i < txCount; ++i) {
+        block.vtx.push_back(MakeTransactionRef(
+            CreateBenchTransaction(txVersion, 2, 2, uint32_t(i))));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
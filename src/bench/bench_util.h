@@ -0,0 +1,32 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_BENCH_BENCH_UTIL_H
+#define MVC_BENCH_BENCH_UTIL_H
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Deterministic data shared by the benchmarks. Everything is derived from
+ * the seed so that runs are reproducible; the signatures in the scriptSigs
+ * are placeholders of realistic size and do not verify.
+ */
+
+/**
+ * A transaction spending inputs P2PKH outputs into outputs P2PKH outputs.
+ */
+CMutableTransaction CreateBenchTransaction(int32_t version, size_t inputs,
+                                           size_t outputs, uint32_t seed);
+
+/**
+ * A block with a coinbase and txCount - 1 transactions of two inputs and two
+ * outputs each, with a correct merkle root.
+ */
+CBlock CreateBenchBlock(size_t txCount, int32_t txVersion);
+
+#endif // MVC_BENCH_BENCH_UTIL_H
@@ -0,0 +1,87 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+#include "bench/bench_util.h"
+
+#include "config.h"
+#include "consensus/merkle.h"
+#include "consensus/validation.h"
+#include "core_io.h"
+#include "rpc/jsonwriter.h"
+#include "rpc/text_writer.h"
+#include "streams.h"
+#include "validation.h"
+#include "version.h"
+
+#include <cassert>
+
+namespace {
+
+// Below the size from which CheckBlock() builds the merkle tree in parallel.
+const size_t BENCH_BLOCK_TXS = 1000;
+
+std::vector<uint8_t> SerializedBenchBlock() {
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CreateBenchBlock(BENCH_BLOCK_TXS, 10);
+    return std::vector<uint8_t>(stream.begin(), stream.end());
+}
+
+} // namespace
+
+static void DeserializeBlock(benchmark::State &state) {
+    const std::vector<uint8_t> data = SerializedBenchBlock();
+    while (state.KeepRunning()) {
+        CDataStream stream(data, SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        stream >> block;
+    }
+}
+
+static void DeserializeAndCheckBlock(benchmark::State &state) {
+    const Config &config = GlobalConfig::GetConfig();
+    const std::vector<uint8_t> data = SerializedBenchBlock();
+    while (state.KeepRunning()) {
+        CDataStream stream(data, SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        stream >> block;
+        CValidationState validationState;
+        const bool checked =
+            CheckBlock(config, block, validationState, 1000,
+                       BlockValidationOptions().withCheckPoW(false));
+        assert(checked);
+    }
+}
+
+static void BlockMerkleRootBench(benchmark::State &state) {
+    const CBlock block = CreateBenchBlock(BENCH_BLOCK_TXS, 10);
+    while (state.KeepRunning()) {
+        bool mutated;
+        BlockMerkleRoot(block, &mutated);
+    }
+}
+
+// The transactions of a block as written by getblock with verbosity 2.
+static void BlockToJSON(benchmark::State &state) {
+    const CBlock block = CreateBenchBlock(BENCH_BLOCK_TXS, 10);
+    while (state.KeepRunning()) {
+        CStringWriter strWriter;
+        CJSONWriter jWriter(strWriter, false);
+        jWriter.writeBeginObject();
+        jWriter.writeBeginArray("tx");
+        for (const CTransactionRef &tx : block.vtx) {
+            TxToJSON(*tx, uint256(), true, 0, jWriter);
+        }
+        jWriter.writeEndArray();
+        jWriter.writeEndObject();
+        jWriter.flush();
+        strWriter.MoveOutString();
+    }
+}
+
+BENCHMARK(DeserializeBlock, 300);
+BENCHMARK(DeserializeAndCheckBlock, 150);
+BENCHMARK(BlockMerkleRootBench, 1000);
+BENCHMARK(BlockToJSON, 20);
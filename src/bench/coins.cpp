@@ -0,0 +1,196 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+#include "bench/bench_util.h"
+
+#include "coins.h"
+#include "hash.h"
+#include "memusage.h"
+#include "txdb.h"
+
+#include <cassert>
+#include <thread>
+
+namespace {
+
+const size_t BENCH_COINS = 1000;
+const size_t BENCH_MAP_COINS = 10000;
+const size_t BENCH_FETCH_THREADS = 4;
+const int32_t GENESIS_ACTIVATION_HEIGHT = 1;
+
+std::unique_ptr<CoinsDB> MakeBenchCoinsDB() {
+    return std::make_unique<CoinsDB>(
+        std::numeric_limits<uint64_t>::max(), size_t(8) << 20,
+        CDBWrapper::MaxFiles::Default(), true, true);
+}
+
+/** Adds the outputs of tx to db and returns their outpoints. */
+std::vector<COutPoint> AddBenchCoins(CoinsDB &db, const CTransaction &tx,
+                                     const uint256 &bestBlock) {
+    std::vector<COutPoint> outpoints;
+    {
+        CoinsDBSpan span(db);
+        for (size_t i = 0; i < tx.vout.size(); ++i) {
+            const COutPoint outpoint(tx.GetId(), i);
+            span.AddCoin(outpoint,
+                         CoinWithScript::MakeOwning(CTxOut(tx.vout[i]), 1,
+                                                    false),
+                         false, GENESIS_ACTIVATION_HEIGHT);
+            outpoints.push_back(outpoint);
+        }
+        span.SetBestBlock(bestBlock);
+        const auto writeState = span.TryFlush();
+        assert(writeState == CoinsDBSpan::WriteState::ok);
+    }
+    return outpoints;
+}
+
+void FetchCoins(CoinsDB &db, const std::vector<COutPoint> &outpoints) {
+    CoinsDBSpan span(db);
+    for (const COutPoint &outpoint : outpoints) {
+        const auto coin = span.GetCoinWithScript(outpoint);
+        assert(coin.has_value());
+    }
+}
+
+// CCoinsMap before its nodes were allocated from a pool.
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+    NodeCoinsMap;
+
+std::vector<COutPoint> MapBenchOutpoints() {
+    std::vector<COutPoint> outpoints;
+    for (uint64_t i = 0; i < BENCH_MAP_COINS; ++i) {
+        outpoints.emplace_back(TxId(SerializeHash(i)), uint32_t(i % 4));
+    }
+    return outpoints;
+}
+
+template <typename Map>
+void InsertCoins(Map &map, const std::vector<COutPoint> &outpoints) {
+    for (const COutPoint &outpoint : outpoints) {
+        map.emplace(outpoint,
+                    CCoinsCacheEntry(CoinImpl(Amount(1000), 25, 1, false),
+                                     CCoinsCacheEntry::DIRTY));
+    }
+}
+
+// Memory of the map itself, the coins have no scripts.
+template <typename Map>
+void SetBytesPerCoin(benchmark::State &state, const Map &map) {
+    state.SetCounter("bytes_per_coin",
+                     double(memusage::DynamicUsage(map)) / map.size());
+}
+
+template <typename Map> void CoinsMapInsert(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = MapBenchOutpoints();
+    while (state.KeepRunning()) {
+        Map map;
+        InsertCoins(map, outpoints);
+    }
+    Map map;
+    InsertCoins(map, outpoints);
+    SetBytesPerCoin(state, map);
+}
+
+template <typename Map> void CoinsMapLookup(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = MapBenchOutpoints();
+    Map map;
+    InsertCoins(map, outpoints);
+    while (state.KeepRunning()) {
+        for (const COutPoint &outpoint : outpoints) {
+            const bool found = map.find(outpoint) != map.end();
+            assert(found);
+        }
+    }
+    SetBytesPerCoin(state, map);
+}
+
+} // namespace
+
+// Inserting coins into a new CCoinsMap and destroying it again.
+static void CoinsMapInsertPooled(benchmark::State &state) {
+    CoinsMapInsert<CCoinsMap>(state);
+}
+
+static void CoinsMapInsertNode(benchmark::State &state) {
+    CoinsMapInsert<NodeCoinsMap>(state);
+}
+
+// Looking up each coin of a CCoinsMap once.
+static void CoinsMapLookupPooled(benchmark::State &state) {
+    CoinsMapLookup<CCoinsMap>(state);
+}
+
+static void CoinsMapLookupNode(benchmark::State &state) {
+    CoinsMapLookup<NodeCoinsMap>(state);
+}
+
+// Fetch of coins that are only in the database.
+static void CoinsViewCacheFetch(benchmark::State &state) {
+    const auto db = MakeBenchCoinsDB();
+    const CTransaction tx(CreateBenchTransaction(10, 1, BENCH_COINS, 1));
+    const std::vector<COutPoint> outpoints =
+        AddBenchCoins(*db, tx, uint256S("01"));
+    db->Flush();
+    while (state.KeepRunning()) {
+        db->Uncache(outpoints);
+        FetchCoins(*db, outpoints);
+    }
+}
+
+// Fetch of coins that are in the cache of the database.
+static void CoinsViewCacheFetchCached(benchmark::State &state) {
+    const auto db = MakeBenchCoinsDB();
+    const CTransaction tx(CreateBenchTransaction(10, 1, BENCH_COINS, 1));
+    const std::vector<COutPoint> outpoints =
+        AddBenchCoins(*db, tx, uint256S("01"));
+    FetchCoins(*db, outpoints);
+    while (state.KeepRunning()) {
+        FetchCoins(*db, outpoints);
+    }
+}
+
+// Fetch of cached coins from several threads at once, which contend for the
+// locks of the cache of the database.
+static void CoinsViewCacheFetchCachedParallel(benchmark::State &state) {
+    const auto db = MakeBenchCoinsDB();
+    const CTransaction tx(CreateBenchTransaction(10, 1, BENCH_COINS, 1));
+    const std::vector<COutPoint> outpoints =
+        AddBenchCoins(*db, tx, uint256S("01"));
+    FetchCoins(*db, outpoints);
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < BENCH_FETCH_THREADS; ++i) {
+            threads.emplace_back([&db, &outpoints] {
+                FetchCoins(*db, outpoints);
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+// Adding new coins to a view and flushing them down to the database.
+static void CoinsViewCacheFlush(benchmark::State &state) {
+    const auto db = MakeBenchCoinsDB();
+    uint32_t seed = 0;
+    while (state.KeepRunning()) {
+        const CTransaction tx(
+            CreateBenchTransaction(10, 1, BENCH_COINS, ++seed));
+        AddBenchCoins(*db, tx, tx.GetId());
+        const bool flushed = db->Flush();
+        assert(flushed);
+    }
+}
+
+BENCHMARK(CoinsMapInsertPooled, 200);
+BENCHMARK(CoinsMapInsertNode, 200);
+BENCHMARK(CoinsMapLookupPooled, 500);
+BENCHMARK(CoinsMapLookupNode, 500);
+BENCHMARK(CoinsViewCacheFetch, 200);
+BENCHMARK(CoinsViewCacheFetchCached, 2000);
+BENCHMARK(CoinsViewCacheFetchCachedParallel, 500);
+BENCHMARK(CoinsViewCacheFlush, 100);
@@ -0,0 +1,58 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+#include "bench/bench_util.h"
+
+#include "mining/journal_change_set.h"
+#include "txmempool.h"
+
+namespace {
+
+const size_t BENCH_MEMPOOL_TXS = 1000;
+
+std::vector<CTransactionRef> MempoolBenchTransactions() {
+    std::vector<CTransactionRef> txs;
+    for (size_t i = 0; i < BENCH_MEMPOOL_TXS; ++i) {
+        txs.push_back(MakeTransactionRef(
+            CreateBenchTransaction(10, 2, 2, uint32_t(i))));
+    }
+    return txs;
+}
+
+void AddToMempool(CTxMemPool &pool, const std::vector<CTransactionRef> &txs) {
+    for (const CTransactionRef &tx : txs) {
+        pool.AddUnchecked(tx->GetId(),
+                          CTxMemPoolEntry(tx, Amount(1000), 0, 1, false,
+                                          LockPoints()),
+                          TxStorage::memory, nullptr);
+    }
+}
+
+} // namespace
+
+// Each iteration also clears the mempool again.
+static void MempoolAddUnchecked(benchmark::State &state) {
+    const std::vector<CTransactionRef> txs = MempoolBenchTransactions();
+    CTxMemPool pool;
+    while (state.KeepRunning()) {
+        AddToMempool(pool, txs);
+        pool.Clear();
+    }
+}
+
+// Each iteration also adds the transactions of the block to the mempool.
+static void MempoolRemoveForBlock(benchmark::State &state) {
+    const std::vector<CTransactionRef> txs = MempoolBenchTransactions();
+    const uint256 blockhash = uint256S("01");
+    CTxMemPool pool;
+    while (state.KeepRunning()) {
+        AddToMempool(pool, txs);
+        std::vector<CTransactionRef> txNew;
+        pool.RemoveForBlock(txs, nullptr, blockhash, txNew);
+    }
+}
+
+BENCHMARK(MempoolAddUnchecked, 100);
+BENCHMARK(MempoolRemoveForBlock, 100);
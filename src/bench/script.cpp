@@ -0,0 +1,179 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+#include "bench/bench_util.h"
+
+#include "config.h"
+#include "hash.h"
+#include "key.h"
+#include "policy/policy.h"
+#include "script/compiled_script.h"
+#include "script/interpreter.h"
+#include "script/limitedstack.h"
+#include "script/script.h"
+#include "taskcancellation.h"
+
+#include <cassert>
+
+namespace {
+
+const uint32_t GENESIS_FLAGS = StandardScriptVerifyFlags(true, true);
+
+std::vector<uint8_t> Bytes(size_t size, uint8_t fill, uint8_t last) {
+    std::vector<uint8_t> bytes(size, fill);
+    bytes.back() = last;
+    return bytes;
+}
+
+/** Evaluates script on an empty stack and asserts that it succeeds. */
+template <typename Script>
+void EvalBenchScript(benchmark::State &state, const Script &script) {
+    const Config &config = GlobalConfig::GetConfig();
+    const auto source = task::CCancellationSource::Make();
+    const BaseSignatureChecker checker;
+    while (state.KeepRunning()) {
+        LimitedStack stack(config.GetMaxStackMemoryUsage(true, true));
+        ScriptError serror;
+        const auto res = EvalScript(config, true, source->GetToken(), stack,
+                                    script, GENESIS_FLAGS, checker, &serror);
+        assert(res.has_value() && res.value());
+    }
+}
+
+/**
+ * A contract of many small steps as produced by script compilers: pushes of
+ * constants, hashing, arithmetic and branches that are not taken.
+ */
+CScript LargeContractScript() {
+    CScript script;
+    script << Bytes(32, 0x11, 0x22) << OP_0;
+    for (int i = 0; i < 1000; ++i) {
+        script << OP_1ADD << OP_OVER << OP_SHA256 << OP_DROP;
+        script << OP_DUP << Bytes(4, 0x03, 0x01) << OP_MUL << OP_DROP;
+        script << OP_0 << OP_IF << Bytes(20, 0x44, 0x55) << OP_DROP
+               << OP_ENDIF;
+    }
+    script << 1000 << OP_NUMEQUALVERIFY << OP_DROP << OP_1;
+    return script;
+}
+
+} // namespace
+
+// Verification of a signed P2PKH spend, dominated by the ECDSA check.
+static void VerifyScriptP2PKH(benchmark::State &state) {
+    const Config &config = GlobalConfig::GetConfig();
+    const auto source = task::CCancellationSource::Make();
+
+    CKey key;
+    const std::vector<uint8_t> secret(32, 0x42);
+    key.Set(secret.begin(), secret.end(), true);
+    const CPubKey pubkey = key.GetPubKey();
+    const CScript scriptPubKey = CScript()
+                                 << OP_DUP << OP_HASH160
+                                 << ToByteVector(pubkey.GetID())
+                                 << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    CMutableTransaction mtx = CreateBenchTransaction(1, 1, 1, 0);
+    const Amount amount(100000);
+    const SigHashType sigHashType = SigHashType().withForkId();
+    const uint256 sighash = SignatureHash(scriptPubKey, CTransaction(mtx), 0,
+                                          sigHashType, amount);
+    std::vector<uint8_t> sig;
+    key.Sign(sighash, sig);
+    sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+    mtx.vin[0].scriptSig = CScript() << sig << ToByteVector(pubkey);
+    const CTransaction tx(mtx);
+
+    const TransactionSignatureChecker checker(&tx, 0, amount);
+    while (state.KeepRunning()) {
+        ScriptError serror;
+        const auto res = VerifyScript(config, true, source->GetToken(),
+                                      tx.vin[0].scriptSig, scriptPubKey,
+                                      GENESIS_FLAGS, checker, &serror);
+        assert(res.has_value() && res.value());
+    }
+}
+
+static void EvalScriptLargeContract(benchmark::State &state) {
+    EvalBenchScript(state, LargeContractScript());
+}
+
+static void EvalScriptLargeContractCompiled(benchmark::State &state) {
+    EvalBenchScript(state, CCompiledScript(LargeContractScript()));
+}
+
+// Many short-lived stack elements, which stresses their allocation.
+static void EvalScriptStackAllocations(benchmark::State &state) {
+    CScript script;
+    script << Bytes(32, 0x5a, 0x5b);
+    for (int i = 0; i < 500; ++i) {
+        script << OP_DUP << OP_DUP << OP_CAT << OP_SHA256 << OP_NIP
+               << OP_DUP << OP_HASH160 << OP_DUP << OP_EQUALVERIFY
+               << OP_SIZE << OP_DROP;
+    }
+    script << OP_SIZE << OP_NIP;
+    EvalBenchScript(state, script);
+}
+
+// Parsing of a sighash preimage as done by contracts that check the spending
+// transaction: fields are split off a large element and put back together.
+static void EvalScriptSplitCat(benchmark::State &state) {
+    CScript script;
+    script << Bytes(1024, 0x77, 0x01);
+    for (int i = 0; i < 200; ++i) {
+        script << OP_DUP << 104 << OP_SPLIT << OP_NIP
+               << 32 << OP_SPLIT << OP_DROP << OP_SHA256
+               << OP_DROP;
+        script << 4 << OP_SPLIT << OP_SWAP << OP_CAT;
+    }
+    script << OP_SIZE << OP_NIP;
+    EvalBenchScript(state, script);
+}
+
+static void EvalScriptArithmetic(benchmark::State &state, opcodetype opcode,
+                                 size_t operandSize) {
+    const std::vector<uint8_t> a = Bytes(operandSize, 0x5a, 0x2a);
+    const std::vector<uint8_t> b = Bytes(operandSize, 0x13, 0x11);
+    CScript script;
+    for (int i = 0; i < 500; ++i) {
+        script << a << b << opcode << OP_DROP;
+    }
+    script << OP_1;
+    EvalBenchScript(state, script);
+}
+
+#define ARITHMETIC_BENCHMARK(opcode, size, iters)                              \
+    static void EvalScript_##opcode##_##size(benchmark::State &state) {        \
+        EvalScriptArithmetic(state, opcode, size);                             \
+    }                                                                          \
+    BENCHMARK(EvalScript_##opcode##_##size, iters);
+
+BENCHMARK(VerifyScriptP2PKH, 4000);
+BENCHMARK(EvalScriptLargeContract, 250);
+BENCHMARK(EvalScriptLargeContractCompiled, 300);
+BENCHMARK(EvalScriptStackAllocations, 4000);
+BENCHMARK(EvalScriptSplitCat, 6000);
+
+ARITHMETIC_BENCHMARK(OP_ADD, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_ADD, 8, 3000)
+ARITHMETIC_BENCHMARK(OP_ADD, 32, 2000)
+ARITHMETIC_BENCHMARK(OP_SUB, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_SUB, 8, 3000)
+ARITHMETIC_BENCHMARK(OP_SUB, 32, 2000)
+ARITHMETIC_BENCHMARK(OP_MUL, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_MUL, 8, 2000)
+ARITHMETIC_BENCHMARK(OP_MUL, 32, 1500)
+ARITHMETIC_BENCHMARK(OP_DIV, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_DIV, 8, 2000)
+ARITHMETIC_BENCHMARK(OP_DIV, 32, 1500)
+ARITHMETIC_BENCHMARK(OP_MOD, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_MOD, 8, 2000)
+ARITHMETIC_BENCHMARK(OP_MOD, 32, 1500)
+ARITHMETIC_BENCHMARK(OP_NUMEQUAL, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_NUMEQUAL, 8, 3000)
+ARITHMETIC_BENCHMARK(OP_NUMEQUAL, 32, 2000)
+ARITHMETIC_BENCHMARK(OP_LESSTHAN, 4, 3000)
+ARITHMETIC_BENCHMARK(OP_LESSTHAN, 8, 3000)
+ARITHMETIC_BENCHMARK(OP_LESSTHAN, 32, 2000)
@@ -0,0 +1,136 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench.h"
+#include "bench/bench_util.h"
+
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "script/interpreter.h"
+#include "script/script.h"
+
+namespace {
+
+const Amount AMOUNT(100000);
+
+void SignatureHashBench(benchmark::State &state, int32_t version) {
+    const CTransaction tx(CreateBenchTransaction(version, 10, 10, 1));
+    const CScript &scriptCode = tx.vout[0].scriptPubKey;
+    const PrecomputedTransactionData txdata(tx);
+    const SigHashType sigHashType = SigHashType().withForkId();
+    while (state.KeepRunning()) {
+        SignatureHash(scriptCode, tx, 0, sigHashType, AMOUNT, &txdata);
+    }
+}
+
+/** A scriptCode of the size of a typical compiled contract. */
+CScript ContractScriptCode() {
+    CScript script;
+    while (script.size() < 40000) {
+        script << std::vector<uint8_t>(32, uint8_t(script.size()))
+               << OP_SHA256 << OP_DROP;
+    }
+    return script;
+}
+
+void TxSerializeHashBench(benchmark::State &state, int32_t version) {
+    const CMutableTransaction tx =
+        CreateBenchTransaction(version, 100, 100, 2);
+    while (state.KeepRunning()) {
+        TxSerializeHash(tx);
+    }
+}
+
+/** The unlocking and locking scripts of a transaction with 100 of each. */
+std::vector<CScript> TransactionScripts() {
+    const CMutableTransaction tx = CreateBenchTransaction(10, 100, 100, 3);
+    std::vector<CScript> scripts;
+    for (const CTxIn &in : tx.vin) {
+        scripts.push_back(in.scriptSig);
+    }
+    for (const CTxOut &out : tx.vout) {
+        scripts.push_back(out.scriptPubKey);
+    }
+    return scripts;
+}
+
+} // namespace
+
+static void SignatureHashV1(benchmark::State &state) {
+    SignatureHashBench(state, 1);
+}
+
+static void SignatureHashV10(benchmark::State &state) {
+    SignatureHashBench(state, 10);
+}
+
+// First signature of an input with a large scriptCode, which hashes the whole
+// scriptCode and stores the midstate.
+static void SignatureHashContractCold(benchmark::State &state) {
+    const CTransaction tx(CreateBenchTransaction(10, 10, 10, 4));
+    const CScript scriptCode = ContractScriptCode();
+    const SigHashType sigHashType = SigHashType().withForkId();
+    while (state.KeepRunning()) {
+        const PrecomputedTransactionData txdata(tx);
+        SignatureHash(scriptCode, tx, 0, sigHashType, AMOUNT, &txdata);
+    }
+}
+
+// Further signatures of the same input, which resume from the midstate.
+static void SignatureHashContractWarm(benchmark::State &state) {
+    const CTransaction tx(CreateBenchTransaction(10, 10, 10, 4));
+    const CScript scriptCode = ContractScriptCode();
+    const SigHashType sigHashType = SigHashType().withForkId();
+    const PrecomputedTransactionData txdata(tx);
+    SignatureHash(scriptCode, tx, 0, sigHashType, AMOUNT, &txdata);
+    while (state.KeepRunning()) {
+        SignatureHash(scriptCode, tx, 0, sigHashType, AMOUNT, &txdata);
+    }
+}
+
+static void TxSerializeHashV1(benchmark::State &state) {
+    TxSerializeHashBench(state, 1);
+}
+
+static void TxSerializeHashV10(benchmark::State &state) {
+    TxSerializeHashBench(state, 10);
+}
+
+// The script hashes of a version 10 txid, one SHA256 after the other...
+static void SHA256Scripts(benchmark::State &state) {
+    const std::vector<CScript> scripts = TransactionScripts();
+    std::vector<uint256> hashes(scripts.size());
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < scripts.size(); ++i) {
+            CSHA256()
+                .Write(scripts[i].data(), scripts[i].size())
+                .Finalize(hashes[i].begin());
+        }
+    }
+}
+
+// ...and in the parallel lanes of the multi-buffer transform.
+static void SHA256MultiScripts(benchmark::State &state) {
+    const std::vector<CScript> scripts = TransactionScripts();
+    std::vector<const uint8_t *> inputs;
+    std::vector<size_t> lengths;
+    for (const CScript &script : scripts) {
+        inputs.push_back(script.data());
+        lengths.push_back(script.size());
+    }
+    std::vector<uint256> hashes(scripts.size());
+    while (state.KeepRunning()) {
+        SHA256Multi(hashes.front().begin(), inputs.data(), lengths.data(),
+                    inputs.size());
+    }
+}
+
+BENCHMARK(SignatureHashV1, 500000);
+BENCHMARK(SignatureHashV10, 500000);
+BENCHMARK(SignatureHashContractCold, 5000);
+BENCHMARK(SignatureHashContractWarm, 500000);
+BENCHMARK(TxSerializeHashV1, 20000);
+BENCHMARK(TxSerializeHashV10, 20000);
+BENCHMARK(SHA256Scripts, 20000);
+BENCHMARK(SHA256MultiScripts, 30000);
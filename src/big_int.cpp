@@ -18,117 +18,93 @@ void mvc::bint::empty_bn_deleter::operator()(bignum_st* p) const
     ::BN_free(p);
 }
 
-mvc::bint::bint() : value_{nullptr} {}
-
-mvc::bint::bint(const int i) : value_(BN_new(), empty_bn_deleter())
+namespace
 {
-    // assert(value_);
-    if(!value_)
-        throw big_int_error();
-
-    if(i >= 0)
-    {
-        const auto s{BN_set_word(value_.get(), i)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
-    }
-    else if(i > INT_MIN)
+    void set_int64(bignum_st* bn, const int64_t i)
     {
-        const auto s{BN_set_word(value_.get(), -i)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
-        BN_set_negative(value_.get(), 1);
+        if(i >= 0)
+        {
+            const auto s{BN_set_word(bn, i)};
+            // assert(s);
+            if(!s)
+                throw mvc::big_int_error();
+        }
+        else if(i > INT64_MIN)
+        {
+            const auto s{BN_set_word(bn, -i)};
+            // assert(s);
+            if(!s)
+                throw mvc::big_int_error();
+            BN_set_negative(bn, 1);
+        }
+        else
+        {
+            const int64_t ii{i + 1}; // add 1 to avoid overflow in negation
+            auto s{BN_set_word(bn, -ii)};
+            // assert(s);
+            if(!s)
+                throw mvc::big_int_error();
+
+            BN_set_negative(bn, 1);
+
+            // subtract 1 to compensate for earlier addition
+            s = BN_sub(bn, bn, BN_value_one());
+            // assert(s);
+            if(!s)
+                throw mvc::big_int_error();
+        }
     }
-    else
-    {
-        const int ii{i + 1}; // add 1 to avoid overflow in negation
-        auto s{BN_set_word(value_.get(), -ii)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
-
-        BN_set_negative(value_.get(), 1);
 
-        // subtract 1 to compensate for earlier addition
-        s = BN_sub(value_.get(), value_.get(), BN_value_one());
-        // assert(s);
-        if(!s)
-            throw big_int_error();
+    // Absolute value of i, valid for INT64_MIN too
+    uint64_t magnitude(const int64_t i)
+    {
+        return i < 0 ? uint64_t{0} - static_cast<uint64_t>(i)
+                     : static_cast<uint64_t>(i);
     }
 
-    // clang-format off
-    //assert( ((i < 0) && (is_negative(*this))) ||
-    //        ((i == 0) && (BN_is_zero(value_.get()))) ||
-    //        ((i > 0) && (!is_negative(*this))) );
-    // clang-format on
-}
-
-mvc::bint::bint(const int64_t i) : value_(BN_new(), empty_bn_deleter())
-{
-    // assert(value_);
-    if(!value_)
-        throw big_int_error();
-
-    if(i >= 0)
+    int size_bits(uint64_t n)
     {
-        const auto s{BN_set_word(value_.get(), i)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
+        return n ? 64 - __builtin_clzll(n) : 0;
     }
-    else if(i > INT64_MIN)
+
+    // Three-way comparison of a BIGNUM with an int64_t
+    int compare(const bignum_st* bn, const int64_t i)
     {
-        const auto s{BN_set_word(value_.get(), -i)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
-        BN_set_negative(value_.get(), 1);
+        const bool neg{BN_is_negative(bn) != 0};
+        if(neg != (i < 0) || BN_num_bits(bn) > 64)
+            return neg ? -1 : 1;
+
+        const uint64_t a{BN_get_word(bn)};
+        const uint64_t b{magnitude(i)};
+        if(a == b)
+            return 0;
+        return (a < b) != neg ? -1 : 1;
     }
-    else
-    {
-        const int64_t ii{i + 1}; // add 1 to avoid overflow in negation
-        auto s{BN_set_word(value_.get(), -ii)};
-        // assert(s);
-        if(!s)
-            throw big_int_error();
+}
 
-        BN_set_negative(value_.get(), 1);
+mvc::bint::bint() : value_{nullptr} {}
 
-        // subtract 1 to compensate for earlier addition
-        s = BN_sub(value_.get(), value_.get(), BN_value_one());
-        // assert(s);
-        if(!s)
-            throw big_int_error();
-    }
+mvc::bint::bint(const int i) : small_{i} {}
 
-    // clang-format off
-    //assert( ((i < 0) && (is_negative(*this))) ||
-    //      ((i == 0) && (BN_is_zero(value_.get()))) ||
-    //      ((i > 0) && (!is_negative(*this))) );
-    // clang-format on
-}
+mvc::bint::bint(const int64_t i) : small_{i} {}
 
-mvc::bint::bint(const size_t i) : value_(BN_new(), empty_bn_deleter())
+mvc::bint::bint(const size_t i)
 {
-    assert(value_);
+    if(i <= static_cast<size_t>(std::numeric_limits<int64_t>::max()))
+    {
+        small_ = static_cast<int64_t>(i);
+        return;
+    }
+
+    value_.reset(BN_new());
+    // assert(value_);
     if(!value_)
         throw big_int_error();
 
-    // Precondition: i > std::numeric_limits<size_t>::min()
-    // as negation is out-of-range of size_t
-    // assert(i >= std::numeric_limits<size_t>::min());
-    // assert(value_);
     const auto s{BN_set_word(value_.get(), i)};
     // assert(s);
     if(!s)
         throw big_int_error();
-
-    // clang-format off
-    //assert( ((i == 0) && (BN_is_zero(value_.get())))  ||
-    //      ((i > 0) && (!is_negative(*this))) );
-    // clang-format on
 }
 
 mvc::bint::bint(const std::string& n) : value_(BN_new(), empty_bn_deleter())
@@ -144,9 +120,13 @@ mvc::bint::bint(const std::string& n) : value_(BN_new(), empty_bn_deleter())
         throw big_int_error();
 }
 
-mvc::bint::bint(const bint& other) : value_(BN_new(), empty_bn_deleter())
+mvc::bint::bint(const bint& other) : small_{other.small_}
 {
-    // assert(other.value_); // See Note 2 @ eof
+    if(other.is_small())
+        return;
+
+    // See Note 3 @ eof
+    value_.reset(BN_new());
     // assert(value_);
     if(!value_)
         throw big_int_error();
@@ -157,6 +137,28 @@ mvc::bint::bint(const bint& other) : value_(BN_new(), empty_bn_deleter())
         throw big_int_error();
 }
 
+void mvc::bint::promote()
+{
+    if(!is_small())
+        return;
+
+    unique_bn_ptr bn{BN_new(), empty_bn_deleter()};
+    if(!bn)
+        throw big_int_error();
+    set_int64(bn.get(), small_);
+    value_ = std::move(bn);
+}
+
+const bignum_st* mvc::bint::big_value(const bint& b, bint& copy)
+{
+    if(!b.is_small())
+        return b.value_.get();
+
+    copy.small_ = b.small_;
+    copy.promote();
+    return copy.value_.get();
+}
+
 mvc::bint& mvc::bint::operator=(const bint& other)
 {
     bint temp{other};
@@ -168,6 +170,7 @@ void mvc::bint::swap(bint& other) noexcept
 {
     // assert(value_);
     using std::swap;
+    swap(small_, other.small_);
     swap(value_, other.value_);
 }
 
@@ -184,8 +187,31 @@ bool mvc::operator==(const bint& a, const bint& b)
 // Arithmetic operators
 mvc::bint& mvc::bint::operator+=(const bint& other)
 {
+    int64_t r;
+    if(is_small() && other.is_small() &&
+       !__builtin_add_overflow(small_, other.small_, &r))
+    {
+        small_ = r;
+        return *this;
+    }
+
+    // Avoid promoting small operands such as constants
+    if(!is_small() && other.is_small())
+    {
+        const uint64_t m{magnitude(other.small_)};
+        const auto s{other.small_ < 0 ? BN_sub_word(value_.get(), m)
+                                      : BN_add_word(value_.get(), m)};
+        // assert(s);
+        if(!s)
+            throw big_int_error();
+        return *this;
+    }
+
+    promote();
+    bint copy;
+    const bignum_st* const other_value{big_value(other, copy)};
     // assert(value_);
-    const auto s = BN_add(value_.get(), value_.get(), other.value_.get());
+    const auto s = BN_add(value_.get(), value_.get(), other_value);
     // assert(s);
     if(!s)
         throw big_int_error();
@@ -194,8 +220,31 @@ mvc::bint& mvc::bint::operator+=(const bint& other)
 
 mvc::bint& mvc::bint::operator-=(const bint& other)
 {
+    int64_t r;
+    if(is_small() && other.is_small() &&
+       !__builtin_sub_overflow(small_, other.small_, &r))
+    {
+        small_ = r;
+        return *this;
+    }
+
+    // Avoid promoting small operands such as constants
+    if(!is_small() && other.is_small())
+    {
+        const uint64_t m{magnitude(other.small_)};
+        const auto s{other.small_ < 0 ? BN_add_word(value_.get(), m)
+                                      : BN_sub_word(value_.get(), m)};
+        // assert(s);
+        if(!s)
+            throw big_int_error();
+        return *this;
+    }
+
+    promote();
+    bint copy;
+    const bignum_st* const other_value{big_value(other, copy)};
     // assert(value_);
-    const auto s = BN_sub(value_.get(), value_.get(), other.value_.get());
+    const auto s = BN_sub(value_.get(), value_.get(), other_value);
     // assert(s);
     if(!s)
         throw big_int_error();
@@ -219,10 +268,32 @@ namespace
 
 mvc::bint& mvc::bint::operator*=(const bint& other)
 {
+    int64_t r;
+    if(is_small() && other.is_small() &&
+       !__builtin_mul_overflow(small_, other.small_, &r))
+    {
+        small_ = r;
+        return *this;
+    }
+
+    if(!is_small() && other.is_small())
+    {
+        const auto s{BN_mul_word(value_.get(), magnitude(other.small_))};
+        // assert(s);
+        if(!s)
+            throw big_int_error();
+        if(other.small_ < 0)
+            negate();
+        return *this;
+    }
+
+    promote();
+    bint copy;
+    const bignum_st* const other_value{big_value(other, copy)};
     // assert(value_);
     unique_ctx_ptr ctx{make_unique_ctx_ptr()};
     const auto s{
-        BN_mul(value_.get(), value_.get(), other.value_.get(), ctx.get())};
+        BN_mul(value_.get(), value_.get(), other_value, ctx.get())};
     // assert(s);
     if(!s)
         throw big_int_error();
@@ -231,11 +302,23 @@ mvc::bint& mvc::bint::operator*=(const bint& other)
 
 mvc::bint& mvc::bint::operator/=(const bint& other)
 {
+    // Division by zero is left to BN_div, which reports it as an error.
+    // Truncation towards zero matches BN_div.
+    if(is_small() && other.is_small() && other.small_ != 0 &&
+       !(small_ == std::numeric_limits<int64_t>::min() && other.small_ == -1))
+    {
+        small_ /= other.small_;
+        return *this;
+    }
+
+    promote();
+    bint copy;
+    const bignum_st* const other_value{big_value(other, copy)};
     // assert(value_);
     bint rem;
     unique_ctx_ptr ctx{make_unique_ctx_ptr()};
     const auto s{BN_div(value_.get(), rem.value_.get(), value_.get(),
-                        other.value_.get(), ctx.get())};
+                        other_value, ctx.get())};
     // assert(s);
     if(!s)
         throw big_int_error();
@@ -244,11 +327,20 @@ mvc::bint& mvc::bint::operator/=(const bint& other)
 
 mvc::bint& mvc::bint::operator%=(const bint& other)
 {
+    // The remainder takes the sign of the dividend, as with BN_mod.
+    if(is_small() && other.is_small() && other.small_ != 0)
+    {
+        small_ = other.small_ == -1 ? 0 : small_ % other.small_;
+        return *this;
+    }
+
+    promote();
+    bint copy;
+    const bignum_st* const other_value{big_value(other, copy)};
     // assert(value_);
-    bint rem;
     unique_ctx_ptr ctx{make_unique_ctx_ptr()};
     const auto s{
-        BN_mod(value_.get(), value_.get(), other.value_.get(), ctx.get())};
+        BN_mod(value_.get(), value_.get(), other_value, ctx.get())};
     // assert(s);
     if(!s)
         throw big_int_error();
@@ -267,6 +359,8 @@ mvc::bint& mvc::bint::operator&=(const bint& other)
         return *this;
     }
 
+    promote();
+
     bool negate{};
     if((is_negative(*this)) && is_negative(other))
         negate = true;
@@ -305,6 +399,8 @@ mvc::bint& mvc::bint::operator|=(const bint& other)
     if(other.empty())
         return *this;
 
+    promote();
+
     bool negate{};
     if((is_negative(other) && !is_negative(*this)) ||
        (is_negative(*this) && !is_negative(other)))
@@ -341,6 +437,7 @@ mvc::bint& mvc::bint::operator<<=(const int n)
     if(n <= 0)
         return *this;
 
+    promote();
     const auto s{BN_lshift(value_.get(), value_.get(), n)};
     // assert(s);
     if(!s)
@@ -353,6 +450,7 @@ mvc::bint& mvc::bint::operator>>=(const int n)
     if(n <= 0)
         return *this;
 
+    promote();
     const auto s{BN_rshift(value_.get(), value_.get(), n)};
     // assert(s);
     if(!s)
@@ -369,6 +467,9 @@ mvc::bint mvc::bint::operator-() const
 
 uint8_t mvc::bint::lsb() const
 {
+    if(is_small())
+        return magnitude(small_) & 0xff;
+
     const auto buffer{to_bin()};
     if(buffer.empty())
         return 0;
@@ -379,12 +480,26 @@ uint8_t mvc::bint::lsb() const
 int mvc::bint::spaceship_operator(
     const bint& other) const // auto operator<=>(const bint&) in C++20
 {
-    // assert(value_);
+    if(is_small() && other.is_small())
+        return small_ < other.small_ ? -1 : (other.small_ < small_ ? 1 : 0);
+
+    if(!is_small() && other.is_small())
+        return compare(value_.get(), other.small_);
+    if(is_small() && !other.is_small())
+        return -compare(other.value_.get(), small_);
+
     return BN_cmp(value_.get(), other.value_.get());
 }
 
 void mvc::bint::negate()
 {
+    if(is_small() && small_ != std::numeric_limits<int64_t>::min())
+    {
+        small_ = -small_;
+        return;
+    }
+
+    promote();
     const bool neg = is_negative(*this);
     if(neg)
         BN_set_negative(value_.get(), 0); // set +ve
@@ -394,22 +509,36 @@ void mvc::bint::negate()
 
 void mvc::bint::mask_bits(const int n)
 {
+    promote();
     const auto s{BN_mask_bits(value_.get(), n)};
     // assert(s);
     if(!s)
         throw big_int_error();
 }
 
-int mvc::bint::size_bits() const { return BN_num_bits(value_.get()); }
+int mvc::bint::size_bits() const
+{
+    if(is_small())
+        return ::size_bits(magnitude(small_));
+
+    return BN_num_bits(value_.get());
+}
+
+int mvc::bint::size_bytes() const
+{
+    if(is_small())
+        return (::size_bits(magnitude(small_)) + 7) / 8;
 
-int mvc::bint::size_bytes() const { return BN_num_bytes(value_.get()); }
+    return BN_num_bytes(value_.get());
+}
 
 mvc::bint::buffer_type mvc::bint::to_bin() const
 {
-    // assert(value_);
+    bint copy;
+    const bignum_st* const value{big_value(*this, copy)};
 
     buffer_type buffer(size_bytes());
-    BN_bn2bin(value_.get(), buffer.data());
+    BN_bn2bin(value, buffer.data());
     // const auto n{BN_bn2bin(value_.get(), buffer.data())};
     // assert(buffer.size() == static_cast<buffer_type::size_type>(n));
 
@@ -433,8 +562,8 @@ namespace
 
 std::ostream& mvc::operator<<(std::ostream& os, const bint& n)
 {
-    if(n.value_ == nullptr)
-        return os;
+    if(n.is_small())
+        return os << n.small_;
 
     const auto s{to_str(n.value_.get())};
     os << s.get();
@@ -443,6 +572,9 @@ std::ostream& mvc::operator<<(std::ostream& os, const bint& n)
 
 bool mvc::is_negative(const bint& n)
 {
+    if(n.is_small())
+        return n.small_ < 0;
+
     const auto s{BN_is_negative(n.value_.get())};
     return s == 1;
 }
@@ -480,6 +612,15 @@ long mvc::to_long(const bint& n)
     // Linux/GCC (sizeof(long) == 8 bytes)
     // n <= numeric_limit<int64_t>::max() and n>=0
 
+    if(n.is_small())
+    {
+        // Values out of range give -1, as with ASN1_INTEGER_get
+        if(n.small_ < std::numeric_limits<long>::min() ||
+           n.small_ > std::numeric_limits<long>::max())
+            return -1;
+        return static_cast<long>(n.small_);
+    }
+
     const auto asn1{to_asn1(n.value_.get())};
     // assert(asn1);
     if(!asn1)
@@ -512,6 +653,22 @@ namespace
 
 std::vector<uint8_t> mvc::bint::serialize() const
 {
+    if(is_small())
+    {
+        // Little-endian magnitude with the sign in the top bit, the same
+        // encoding as the reversed BN_bn2mpi output below
+        vector<uint8_t> result;
+        for(uint64_t m{magnitude(small_)}; m; m >>= 8)
+            result.push_back(m & 0xff);
+        if(result.empty())
+            return result;
+        if(result.back() & 0x80)
+            result.push_back(small_ < 0 ? 0x80 : 0x00);
+        else if(small_ < 0)
+            result.back() |= 0x80;
+        return result;
+    }
+
     const auto len{BN_bn2mpi(value_.get(), nullptr)};
     // assert(len >= length_in_bytes);
     vector<unsigned char> result(len);
@@ -524,6 +681,24 @@ std::vector<uint8_t> mvc::bint::serialize() const
 mvc::bint mvc::bint::deserialize(mvc::span<const uint8_t> s)
 {
     const auto size{s.size()};
+
+    // Up to 8 bytes the magnitude is at most 63 bits. Encodings of zero
+    // other than the empty one are left to OpenSSL.
+    if(size <= sizeof(int64_t))
+    {
+        uint64_t m{};
+        for(size_t i{}; i < size; ++i)
+            m |= uint64_t{s[i]} << (8 * i);
+        const bool neg{size && (s[size - 1] & 0x80)};
+        if(neg)
+            m &= ~(uint64_t{0x80} << (8 * (size - 1)));
+        if(m || !size)
+        {
+            const int64_t i{static_cast<int64_t>(m)};
+            return bint{neg ? -i : i};
+        }
+    }
+
     vector<uint8_t> tmp(size + length_in_bytes);
     tmp[0] = (size >> 24) & 0xff;
     tmp[1] = (size >> 16) & 0xff;
@@ -531,6 +706,8 @@ mvc::bint mvc::bint::deserialize(mvc::span<const uint8_t> s)
     tmp[3] = (size >> 0) & 0xff;
     reverse_copy(begin(s), end(s), begin(tmp) + length_in_bytes);
     auto p{BN_mpi2bn(tmp.data(), tmp.size(), nullptr)};
+    if(!p)
+        throw big_int_error();
     bint b;
     b.value_.reset(p);
     return b;
@@ -541,6 +718,13 @@ mvc::bint mvc::bint::deserialize(mvc::span<const uint8_t> s)
 // 1. Used to minimise size of the unique_ptr through empty base class
 // optimization. See Effective Modern C++ Item 18
 
-// 2. An object that is not well formed (i.e. moved from) can only be destroyed
+// 2. Values that fit in an int64_t are held inline in small_ while value_ is
+// null, so that the arithmetic of typical script numbers does not allocate or
+// call OpenSSL. The result of an operation is promoted to a BIGNUM when it
+// would overflow int64_t or the operation has no inline implementation.
+// Operands passed by const reference are never promoted, a promoted copy is
+// used instead (see big_value).
+
+// 3. An object that is not well formed (i.e. moved from) can only be destroyed
 // or assigned to (on the lhs). See 'Elements of Programming' Stepanov,
 // Chapter 1.5
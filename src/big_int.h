@@ -90,6 +90,15 @@ namespace mvc
         };
         using unique_bn_ptr = std::unique_ptr<bignum_st, empty_bn_deleter>;
         static_assert(sizeof(unique_bn_ptr) == sizeof(bignum_st*));
+
+        // See Note 2.
+        bool is_small() const { return !value_; }
+        void promote();
+        // The BIGNUM of b, or of a promoted copy of b kept in copy if b is
+        // small. See Note 2.
+        static const bignum_st* big_value(const bint& b, bint& copy);
+
+        int64_t small_{0};
         unique_bn_ptr value_;
     };
     
@@ -213,6 +222,12 @@ namespace std
 // Notes
 // -----
 // 1. Used to minimise size of the unique_ptr through empty base class optimization. See Effective Modern C++ Item 18
+// 2. Values that fit in an int64_t are held inline in small_ while value_ is
+//    null, so that the arithmetic of typical script numbers does not allocate
+//    or call OpenSSL. The result of an operation is promoted to a BIGNUM when
+//    it would overflow int64_t or the operation has no inline
+//    implementation. Operands passed by const reference are never promoted,
+//    a promoted copy is used instead.
 
 
 
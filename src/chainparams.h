@@ -35,6 +35,9 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/** UTXO set hashes of snapshots (dumputxoset) by the block they were taken at. */
+typedef std::map<uint256, uint256> MapUtxoSnapshotHashes;
+
 struct ChainTxData {
     int64_t nTime;
     int64_t nTxCount;
@@ -95,6 +98,10 @@ public:
     const std::vector<SeedSpec6> &FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData &Checkpoints() const { return checkpointData; }
     const ChainTxData &TxData() const { return chainTxData; }
+    /** Snapshots that -loadutxosnapshot accepts without -utxosnapshothash */
+    const MapUtxoSnapshotHashes &UtxoSnapshotHashes() const {
+        return utxoSnapshotHashes;
+    }
     const DefaultBlockSizeParams &GetDefaultBlockSizeParams() const { return defaultBlockSizeParams; }
 
     bool TestBlockCandidateValidity() const { return fTestBlockCandidateValidity; }
@@ -125,6 +132,7 @@ protected:
     bool fCanDisbleBIP30Checks;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapUtxoSnapshotHashes utxoSnapshotHashes;
     DefaultBlockSizeParams defaultBlockSizeParams;
 };
 
@@ -129,6 +129,28 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, CoinWithScript *moveo
     return mCache.SpendCoin(outpoint);
 }
 
+void CCoinsViewCache::AddUtxoSetHashChange(const uint256 &from,
+                                           const uint256 &to,
+                                           const UtxoSetHash &change,
+                                           std::vector<std::shared_future<UtxoSetHash>> pending) {
+    assert(mThreadId == std::this_thread::get_id());
+    if (!mUtxoSetHashDelta.has_value()) {
+        mUtxoSetHashDelta =
+            UtxoSetHashDelta{from, to, change, std::move(pending)};
+        return;
+    }
+
+    if (mUtxoSetHashDelta->to != from) {
+        mUtxoSetHashDelta->broken = true;
+    }
+    mUtxoSetHashDelta->to = to;
+    mUtxoSetHashDelta->change += change;
+    mUtxoSetHashDelta->pending.insert(
+        mUtxoSetHashDelta->pending.end(),
+        std::make_move_iterator(pending.begin()),
+        std::make_move_iterator(pending.end()));
+}
+
 bool CCoinsViewCache::HaveCoin(const COutPoint &outpoint) const {
     assert(mThreadId == std::this_thread::get_id());
     auto coin = GetCoin(outpoint, 0);
@@ -348,6 +370,24 @@ void CoinsStore::Uncache(const std::vector<COutPoint>& vOutpoints)
     }
 }
 
+void CoinsStore::RemoveScript(const COutPoint& outpoint)
+{
+    CCoinsMap::iterator it = cacheCoins.find(outpoint);
+    assert(it != cacheCoins.end());
+
+    const CoinImpl& coin = it->second.GetCoinImpl();
+    cachedCoinsUsage -= it->second.DynamicMemoryUsage();
+    it->second =
+        CCoinsCacheEntry{
+            CoinImpl{
+                coin.GetTxOut().nValue,
+                coin.GetScriptSize(),
+                coin.GetHeight(),
+                coin.IsCoinBase()},
+            it->second.flags};
+    cachedCoinsUsage += it->second.DynamicMemoryUsage();
+}
+
 void CoinsStore::BatchWrite(CCoinsMap& mapCoins)
 {
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
@@ -11,8 +11,10 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "txhasher.h"
 #include "uint256.h"
+#include "utxo_set_hash.h"
 
 #include <cassert>
 #include <cstdint>
@@ -349,7 +351,24 @@ public:
     size_t DynamicMemoryUsage() const { return coin.DynamicMemoryUsage(); }
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+/**
+ * The nodes of a CCoinsMap are allocated from a pool that belongs to the map,
+ * which saves the per allocation overhead of malloc for every coin. The map
+ * stays node based since non-owning coins point into the entries of another
+ * map, so entries must not move when the map grows.
+ *
+ * The pool serves blocks of up to the size of a node plus a few pointers,
+ * which leaves room for the hash code and the link that the standard library
+ * keeps in a node. Larger bucket arrays are allocated with operator new.
+ */
+using CCoinsMapAllocator =
+    PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                  sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) +
+                      sizeof(void *) * 4,
+                  alignof(void *)>;
+
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher,
+                           std::equal_to<COutPoint>, CCoinsMapAllocator>
     CCoinsMap;
 
 /**
@@ -407,9 +426,11 @@ public:
 
     CCoinsMap MoveOutCoins()
     {
+        // Swap so that the pool of the coins leaves with them and the store
+        // starts over with an empty pool.
+        CCoinsMap map;
+        map.swap(cacheCoins);
         cachedCoinsUsage = 0;
-        auto map = std::move(cacheCoins);
-        cacheCoins.clear();
 
         return map;
     }
@@ -424,6 +445,10 @@ public:
     void Uncache(const std::vector<COutPoint>& vOutpoints);
     void BatchWrite(CCoinsMap& mapCoins);
 
+    //! Replace the coin at outpoint with the same coin without its script,
+    //! keeping the flags of the entry.
+    void RemoveScript(const COutPoint& outpoint);
+
     const CoinImpl& ReplaceWithCoinWithScript(const COutPoint& outpoint, CoinImpl&& newCoin)
     {
         auto it = cacheCoins.find(outpoint);
@@ -465,6 +490,10 @@ protected:
     mutable uint256 hashBlock;
     mutable CoinsStore mCache;
 
+    //! Change of the UTXO set hash by the blocks applied to this view, see
+    //! AddUtxoSetHashChange().
+    std::optional<UtxoSetHashDelta> mUtxoSetHashDelta;
+
 public:
     explicit CCoinsViewCache(const ICoinsView& view);
 
@@ -537,6 +566,21 @@ public:
      */
     bool SpendCoin(const COutPoint &outpoint, CoinWithScript *moveto = nullptr);
 
+    /**
+     * Record that applying a block changed the UTXO set of this view from the
+     * one at block from to the one at block to, and the UTXO set hash by
+     * change. Changes of consecutive blocks are combined into one delta that
+     * is handed to the CoinsDB on flush; a change that does not start where
+     * the previous one ended makes the delta unusable. The pending parts of
+     * the change may still be hashed in the background, the CoinsDB waits for
+     * them only when it needs the hash.
+     */
+    void AddUtxoSetHashChange(
+        const uint256& from,
+        const uint256& to,
+        const UtxoSetHash& change,
+        std::vector<std::shared_future<UtxoSetHash>> pending = {});
+
     /**
      * Amount of mvcs coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of
@@ -12,7 +12,12 @@
 #include "primitives/block.h"
 #include "uint256.h"
 
-uint256 ComputeMerkleRoot(const std::vector<uint256> &leaves,
+/**
+ * Compute the Merkle root of the given leaves. Each tree level is reduced with
+ * one batched SHA256D64 call, so the leaves are taken by value and used as
+ * scratch space.
+ */
+uint256 ComputeMerkleRoot(std::vector<uint256> leaves,
                           bool *mutated = nullptr);
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256> &leaves,
                                          uint32_t position);
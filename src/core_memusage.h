@@ -39,6 +39,15 @@ static inline size_t RecursiveDynamicUsage(const CTransaction &tx) {
     return mem;
 }
 
+/**
+ * Memory that CTransaction::GetPrecomputedTransactionData() attaches to a
+ * transaction. It has no scriptCode midstate cache, so its size is fixed.
+ */
+static inline size_t PrecomputedTransactionDataUsage() {
+    return memusage::MallocUsage(sizeof(PrecomputedTransactionData)) +
+           memusage::MallocUsage(sizeof(memusage::stl_shared_counter));
+}
+
 static inline size_t RecursiveDynamicUsage(const CMutableTransaction &tx) {
     size_t mem =
         memusage::DynamicUsage(tx.vin) + memusage::DynamicUsage(tx.vout);
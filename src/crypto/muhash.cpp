@@ -0,0 +1,189 @@
+// Copyright (c) 2017-2021 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/chacha20.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+using limb_t = Num3072::limb_t;
+using double_limb_t = Num3072::double_limb_t;
+constexpr int LIMBS = Num3072::LIMBS;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+//! 2^3072 - MAX_PRIME_DIFF is the prime modulus.
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+
+//! Add a to the number in limbs starting at limb i, propagating the carry.
+//! Returns the carry out of the top limb.
+limb_t AddTo(limb_t (&limbs)[LIMBS], int i, double_limb_t a) {
+    while (a != 0 && i < LIMBS) {
+        a += limbs[i];
+        limbs[i] = limb_t(a);
+        a >>= LIMB_SIZE;
+        ++i;
+    }
+    return limb_t(a);
+}
+
+} // namespace
+
+Num3072::Num3072() {
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+Num3072::Num3072(const uint8_t (&data)[BYTE_SIZE]) {
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            limbs[i] = ReadLE32(data + 4 * i);
+        } else {
+            limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+bool Num3072::IsOverflow() const {
+    if (limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) {
+        return false;
+    }
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != std::numeric_limits<limb_t>::max()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Num3072::FullReduce() {
+    // Subtracting the modulus is adding MAX_PRIME_DIFF and dropping 2^3072.
+    AddTo(limbs, 0, MAX_PRIME_DIFF);
+}
+
+void Num3072::Multiply(const Num3072 &a) {
+    // Schoolbook multiplication into 2 * LIMBS limbs.
+    limb_t tmp[2 * LIMBS] = {};
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            carry += double_limb_t(limbs[i]) * a.limbs[j] + tmp[i + j];
+            tmp[i + j] = limb_t(carry);
+            carry >>= LIMB_SIZE;
+        }
+        tmp[i + LIMBS] = limb_t(carry);
+    }
+
+    // hi * 2^3072 + lo is congruent to hi * MAX_PRIME_DIFF + lo.
+    double_limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        carry += double_limb_t(tmp[LIMBS + i]) * MAX_PRIME_DIFF + tmp[i];
+        limbs[i] = limb_t(carry);
+        carry >>= LIMB_SIZE;
+    }
+
+    // Fold the remaining carry the same way. It is small enough that a
+    // second overflow leaves the low limbs tiny, so a third fold cannot
+    // overflow again.
+    if (AddTo(limbs, 0, carry * MAX_PRIME_DIFF) != 0) {
+        const limb_t overflow = AddTo(limbs, 0, MAX_PRIME_DIFF);
+        assert(overflow == 0);
+    }
+
+    if (IsOverflow()) {
+        FullReduce();
+    }
+}
+
+Num3072 Num3072::GetInverse() const {
+    // Fermat's little theorem: a^-1 = a^(p - 2) with p - 2 =
+    // 2^3072 - 1103719. All its bits above the lowest 21 are set.
+    constexpr limb_t LOW_BITS = (limb_t(1) << 21) - (MAX_PRIME_DIFF + 2);
+    Num3072 result;
+    for (int bit = 3071; bit >= 0; --bit) {
+        result.Multiply(result);
+        if (bit >= 21 || ((LOW_BITS >> bit) & 1)) {
+            result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072 &a) {
+    if (IsOverflow()) {
+        FullReduce();
+    }
+    Num3072 inv = a;
+    if (inv.IsOverflow()) {
+        inv.FullReduce();
+    }
+    Multiply(inv.GetInverse());
+}
+
+void Num3072::ToBytes(uint8_t (&out)[BYTE_SIZE]) {
+    if (IsOverflow()) {
+        FullReduce();
+    }
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + 4 * i, limbs[i]);
+        } else {
+            WriteLE64(out + 8 * i, limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const uint8_t *data, size_t len) {
+    // Expand the SHA256 of the element to 384 bytes with ChaCha20.
+    uint8_t key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    uint8_t bytes[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(bytes, sizeof(bytes));
+    return Num3072(bytes);
+}
+
+MuHash3072::MuHash3072(const uint8_t *data, size_t len)
+    : numerator{ToNum3072(data, len)} {}
+
+MuHash3072 &MuHash3072::Insert(const uint8_t *data, size_t len) {
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072 &MuHash3072::Remove(const uint8_t *data, size_t len) {
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072 &MuHash3072::operator*=(const MuHash3072 &mul) {
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072 &MuHash3072::operator/=(const MuHash3072 &div) {
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+uint256 MuHash3072::Finalize() {
+    numerator.Divide(denominator);
+    denominator = Num3072();
+
+    uint8_t bytes[Num3072::BYTE_SIZE];
+    numerator.ToBytes(bytes);
+
+    uint256 out;
+    CSHA256().Write(bytes, sizeof(bytes)).Finalize(out.begin());
+    return out;
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2017-2021 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_CRYPTO_MUHASH_H
+#define MVC_CRYPTO_MUHASH_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/** A 3072-bit number modulo the prime 2^3072 - 1103717. */
+class Num3072 {
+public:
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    static constexpr size_t BYTE_SIZE = 384;
+
+    //! The number one.
+    Num3072();
+    //! The number with the given little endian representation.
+    explicit Num3072(const uint8_t (&data)[BYTE_SIZE]);
+
+    void Multiply(const Num3072 &a);
+    void Divide(const Num3072 &a);
+    //! The little endian representation of the fully reduced number.
+    void ToBytes(uint8_t (&out)[BYTE_SIZE]);
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        for (limb_t &limb : limbs) {
+            READWRITE(limb);
+        }
+    }
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+
+    limb_t limbs[LIMBS];
+};
+
+/**
+ * A hash of a set of byte strings that does not depend on the order in which
+ * they were added and that can be updated as elements are added and removed.
+ *
+ * Each element is hashed to a number modulo a 3072-bit prime, and the set is
+ * represented by the product of the numbers of its elements. Removing an
+ * element divides by its number; numerator and denominator are kept apart so
+ * that the expensive inversion is only done by Finalize().
+ *
+ * The product of two MuHash3072 is the hash of the union of their sets, and
+ * the quotient removes the elements of the divisor. This is the MuHash
+ * construction of Bellare and Micciancio, as used by Bitcoin Core for its
+ * coinstats index.
+ */
+class MuHash3072 {
+public:
+    //! The hash of the empty set.
+    MuHash3072() = default;
+
+    //! The hash of the set with the single element data.
+    MuHash3072(const uint8_t *data, size_t len);
+
+    MuHash3072 &Insert(const uint8_t *data, size_t len);
+    MuHash3072 &Remove(const uint8_t *data, size_t len);
+
+    MuHash3072 &operator*=(const MuHash3072 &mul);
+    MuHash3072 &operator/=(const MuHash3072 &div);
+
+    //! The 256-bit hash of the set. Reduces the internal state.
+    uint256 Finalize();
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(numerator);
+        READWRITE(denominator);
+    }
+
+private:
+    static Num3072 ToNum3072(const uint8_t *data, size_t len);
+
+    Num3072 numerator;
+    Num3072 denominator;
+};
+
+#endif // MVC_CRYPTO_MUHASH_H
@@ -18,6 +18,26 @@ void Transform(uint32_t *s, const unsigned char *chunk, size_t blocks);
 #endif
 #endif
 
+#if defined(ENABLE_SHANI)
+namespace sha256_shani {
+void Transform(uint32_t *s, const unsigned char *chunk, size_t blocks);
+}
+#endif
+
+#if defined(ENABLE_SSE41)
+namespace sha256d64_sse41 {
+void Transform_4way(unsigned char *out, const unsigned char *in);
+void TransformMulti_4way(uint32_t *s, const unsigned char *const *chunks);
+}
+#endif
+
+#if defined(ENABLE_AVX2)
+namespace sha256d64_avx2 {
+void Transform_8way(unsigned char *out, const unsigned char *in);
+void TransformMulti_8way(uint32_t *s, const unsigned char *const *chunks);
+}
+#endif
+
 // Internal implementation code.
 namespace {
 /// Internal SHA-256 implementation.
@@ -252,22 +272,268 @@ bool SelfTest(TransformType tr) {
     return true;
 }
 
+typedef void (*TransformD64Type)(unsigned char *, const unsigned char *);
+
+/**
+ * Double-SHA256 of a single 64-byte input built on top of a generic block
+ * transform.
+ */
+template <TransformType tr>
+void TransformD64Wrapper(unsigned char *out, const unsigned char *in) {
+    static const unsigned char padding1[64] = {
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0};
+    unsigned char buffer2[64] = {
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0};
+    uint32_t s[8];
+    sha256::Initialize(s);
+    tr(s, in, 1);
+    tr(s, padding1, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(buffer2 + 4 * i, s[i]);
+    }
+    sha256::Initialize(s);
+    tr(s, buffer2, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(out + 4 * i, s[i]);
+    }
+}
+
+/**
+ * Check a multi-way double-SHA256 implementation against the generic one on
+ * `ways` distinct inputs.
+ */
+bool SelfTestD64(TransformD64Type tr, size_t ways) {
+    unsigned char in[64 * 8];
+    unsigned char out[32 * 8];
+    unsigned char expected[32 * 8];
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = static_cast<unsigned char>(i * 37 + (i >> 6) * 11);
+    }
+    for (size_t i = 0; i < ways; ++i) {
+        TransformD64Wrapper<sha256::Transform>(expected + 32 * i, in + 64 * i);
+    }
+    tr(out, in);
+    return memcmp(out, expected, 32 * ways) == 0;
+}
+
+typedef void (*TransformMultiType)(uint32_t *, const unsigned char *const *);
+
+/**
+ * Check a multi-buffer block transform against the generic one, with every
+ * lane starting from a different state and processing a different block.
+ */
+bool SelfTestMulti(TransformMultiType tr, size_t ways) {
+    unsigned char in[64 * 8];
+    const unsigned char *chunks[8];
+    uint32_t states[8 * 8];
+    uint32_t expected[8][8];
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = static_cast<unsigned char>(i * 29 + (i >> 6) * 3);
+    }
+    for (size_t lane = 0; lane < ways; ++lane) {
+        chunks[lane] = in + 64 * lane;
+        sha256::Initialize(expected[lane]);
+        expected[lane][0] += lane;
+        for (size_t i = 0; i < 8; ++i) {
+            states[ways * i + lane] = expected[lane][i];
+        }
+        sha256::Transform(expected[lane], chunks[lane], 1);
+    }
+    tr(states, chunks);
+    for (size_t lane = 0; lane < ways; ++lane) {
+        for (size_t i = 0; i < 8; ++i) {
+            if (states[ways * i + lane] != expected[lane][i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 TransformType Transform = sha256::Transform;
+TransformD64Type TransformD64 = TransformD64Wrapper<sha256::Transform>;
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti_4way = nullptr;
+TransformMultiType TransformMulti_8way = nullptr;
+
+/**
+ * Hash independent messages through a WAYS-lane block transform. Every lane
+ * walks the full blocks of its message in place and then its padded tail;
+ * once a lane is done it is refilled with the next pending message. Lanes
+ * left without work hash a dummy block whose result is ignored.
+ */
+template <size_t WAYS>
+void SHA256MultiLanes(TransformMultiType tr, uint8_t *out,
+                      const uint8_t *const *in, const size_t *lens,
+                      size_t count) {
+    static const unsigned char idle[64] = {};
+    struct Lane {
+        size_t msg;
+        const uint8_t *data;
+        size_t fullBlocks;
+        size_t tailBlocks;
+        size_t tailDone;
+        unsigned char tail[128];
+    };
+    Lane lanes[WAYS];
+    const unsigned char *chunks[WAYS];
+    uint32_t s[8 * WAYS];
+    uint32_t init[8];
+    sha256::Initialize(init);
+
+    size_t next = 0;
+    size_t active = 0;
+    auto assign = [&](size_t l) {
+        Lane &lane = lanes[l];
+        if (next == count) {
+            lane.msg = count;
+            return;
+        }
+        lane.msg = next++;
+        const size_t len = lens[lane.msg];
+        const size_t rem = len % 64;
+        lane.data = in[lane.msg];
+        lane.fullBlocks = len / 64;
+        lane.tailBlocks = rem + 9 <= 64 ? 1 : 2;
+        lane.tailDone = 0;
+        memset(lane.tail, 0, sizeof(lane.tail));
+        if (rem) {
+            memcpy(lane.tail, lane.data + len - rem, rem);
+        }
+        lane.tail[rem] = 0x80;
+        WriteBE64(lane.tail + 64 * lane.tailBlocks - 8, uint64_t(len) << 3);
+        for (size_t i = 0; i < 8; ++i) {
+            s[WAYS * i + l] = init[i];
+        }
+        ++active;
+    };
+
+    for (size_t l = 0; l < WAYS; ++l) {
+        assign(l);
+    }
+    while (active) {
+        for (size_t l = 0; l < WAYS; ++l) {
+            const Lane &lane = lanes[l];
+            if (lane.msg == count) {
+                chunks[l] = idle;
+            } else if (lane.fullBlocks) {
+                chunks[l] = lane.data;
+            } else {
+                chunks[l] = lane.tail + 64 * lane.tailDone;
+            }
+        }
+        tr(s, chunks);
+        for (size_t l = 0; l < WAYS; ++l) {
+            Lane &lane = lanes[l];
+            if (lane.msg == count) {
+                continue;
+            }
+            if (lane.fullBlocks) {
+                --lane.fullBlocks;
+                lane.data += 64;
+                continue;
+            }
+            if (++lane.tailDone < lane.tailBlocks) {
+                continue;
+            }
+            for (size_t i = 0; i < 8; ++i) {
+                WriteBE32(out + 32 * lane.msg + 4 * i, s[WAYS * i + l]);
+            }
+            --active;
+            assign(l);
+        }
+    }
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+/** Whether the OS saves the AVX (YMM) register state on context switches. */
+bool AVXEnabled() {
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
 
 } // namespace
 
 std::string SHA256AutoDetect() {
+    std::string ret = "standard";
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_sse4 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    [[maybe_unused]] bool have_avx2 = false;
+    [[maybe_unused]] bool have_shani = false;
+    [[maybe_unused]] bool enabled_avx = false;
+
     uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        have_xsave = (ecx >> 27) & 1;
+        have_avx = (ecx >> 28) & 1;
+    }
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+        have_shani = (ebx >> 29) & 1;
+    }
+
+#if defined(ENABLE_SHANI)
+    if (have_shani && have_sse4) {
+        Transform = sha256_shani::Transform;
+        TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        ret = "shani(1way)";
+        // A single SHA-NI lane outruns the SIMD multi-way code paths.
+        have_sse4 = false;
+        have_avx2 = false;
+    }
+#endif
+
+    if (have_sse4) {
         Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
+        TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
+        ret = "sse4(1way)";
+#if defined(ENABLE_SSE41)
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti_4way = sha256d64_sse41::TransformMulti_4way;
+        ret += ",sse41(4way)";
+#endif
+    }
+
+#if defined(ENABLE_AVX2)
+    if (have_avx2 && enabled_avx) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti_8way = sha256d64_avx2::TransformMulti_8way;
+        ret += ",avx2(8way)";
     }
+#endif
 #endif
 
     assert(SelfTest(Transform));
-    return "standard";
+    assert(SelfTestD64(TransformD64, 1));
+    if (TransformD64_4way) {
+        assert(SelfTestD64(TransformD64_4way, 4));
+    }
+    if (TransformD64_8way) {
+        assert(SelfTestD64(TransformD64_8way, 8));
+    }
+    if (TransformMulti_4way) {
+        assert(SelfTestMulti(TransformMulti_4way, 4));
+    }
+    if (TransformMulti_8way) {
+        assert(SelfTestMulti(TransformMulti_8way, 8));
+    }
+    return ret;
 }
 
 ////// SHA-256
@@ -326,3 +592,43 @@ CSHA256 &CSHA256::Reset() {
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256D64(uint8_t *out, const uint8_t *in, size_t blocks) {
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
+void SHA256Multi(uint8_t *out, const uint8_t *const *in, const size_t *lens,
+                 size_t count) {
+    if (TransformMulti_8way && count >= 8) {
+        SHA256MultiLanes<8>(TransformMulti_8way, out, in, lens, count);
+        return;
+    }
+    if (TransformMulti_4way && count >= 4) {
+        SHA256MultiLanes<4>(TransformMulti_4way, out, in, lens, count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        CSHA256().Write(in[i], lens[i]).Finalize(out + 32 * i);
+    }
+}
@@ -31,4 +31,28 @@ public:
  */
 std::string SHA256AutoDetect();
 
+/**
+ * Compute multiple double-SHA256's of 64-byte blobs.
+ * output: pointer to a blocks*32 byte output buffer
+ * input:  pointer to a blocks*64 byte input buffer
+ * blocks: the number of hashes to compute.
+ *
+ * output may be the same buffer as input, which allows Merkle tree levels to
+ * be reduced in place. Uses the widest multi-way implementation selected by SHA256AutoDetect().
+ */
+void SHA256D64(uint8_t *output, const uint8_t *input, size_t blocks);
+
+/**
+ * Compute the single SHA256 of multiple independent messages.
+ * output:  pointer to a count*32 byte output buffer
+ * inputs:  pointers to the messages
+ * lengths: byte lengths of the messages
+ * count:   the number of messages.
+ *
+ * When a multi-way transform was selected by SHA256AutoDetect() the messages
+ * are hashed in parallel lanes, otherwise one after the other.
+ */
+void SHA256Multi(uint8_t *output, const uint8_t *const *inputs,
+                 const size_t *lengths, size_t count);
+
 #endif // MVC_CRYPTO_SHA256_H
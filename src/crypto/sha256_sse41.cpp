@@ -0,0 +1,266 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include "crypto/common.h"
+
+#include <cstdint>
+#include <immintrin.h>
+
+// Four independent SHA-256 computations, one per 32-bit lane of an SSE
+// register: double-SHA256 of 64-byte inputs, and single block transforms of
+// unrelated messages for multi-buffer hashing.
+namespace sha256d64_sse41 {
+namespace {
+
+const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t INIT[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul,
+                          0xa54ff53aul, 0x510e527ful, 0x9b05688cul,
+                          0x1f83d9abul, 0x5be0cd19ul};
+
+inline __m128i K(uint32_t x) {
+    return _mm_set1_epi32(x);
+}
+inline __m128i Add(__m128i x, __m128i y) {
+    return _mm_add_epi32(x, y);
+}
+inline __m128i Add(__m128i x, __m128i y, __m128i z) {
+    return Add(Add(x, y), z);
+}
+inline __m128i Add(__m128i x, __m128i y, __m128i z, __m128i w) {
+    return Add(Add(x, y), Add(z, w));
+}
+inline __m128i Xor(__m128i x, __m128i y) {
+    return _mm_xor_si128(x, y);
+}
+inline __m128i Xor(__m128i x, __m128i y, __m128i z) {
+    return Xor(Xor(x, y), z);
+}
+inline __m128i Or(__m128i x, __m128i y) {
+    return _mm_or_si128(x, y);
+}
+inline __m128i And(__m128i x, __m128i y) {
+    return _mm_and_si128(x, y);
+}
+inline __m128i ShR(__m128i x, int n) {
+    return _mm_srli_epi32(x, n);
+}
+inline __m128i ShL(__m128i x, int n) {
+    return _mm_slli_epi32(x, n);
+}
+
+inline __m128i Ch(__m128i x, __m128i y, __m128i z) {
+    return Xor(z, And(x, Xor(y, z)));
+}
+inline __m128i Maj(__m128i x, __m128i y, __m128i z) {
+    return Or(And(x, y), And(z, Or(x, y)));
+}
+inline __m128i Sigma0(__m128i x) {
+    return Xor(Or(ShR(x, 2), ShL(x, 30)), Or(ShR(x, 13), ShL(x, 19)),
+               Or(ShR(x, 22), ShL(x, 10)));
+}
+inline __m128i Sigma1(__m128i x) {
+    return Xor(Or(ShR(x, 6), ShL(x, 26)), Or(ShR(x, 11), ShL(x, 21)),
+               Or(ShR(x, 25), ShL(x, 7)));
+}
+inline __m128i sigma0(__m128i x) {
+    return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(x, 18), ShL(x, 14)),
+               ShR(x, 3));
+}
+inline __m128i sigma1(__m128i x) {
+    return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)),
+               ShR(x, 10));
+}
+
+/**
+ * Message schedule of a block whose contents do not depend on the input,
+ * with the round constants already added in. Used for the padding block of
+ * the first hash and for the padding words of the second hash.
+ */
+struct ConstSchedule {
+    uint32_t kw[64];
+
+    explicit ConstSchedule(const uint32_t (&block)[16]) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = block[i];
+        }
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = (w[i - 15] >> 7 | w[i - 15] << 25) ^
+                                (w[i - 15] >> 18 | w[i - 15] << 14) ^
+                                (w[i - 15] >> 3);
+            const uint32_t s1 = (w[i - 2] >> 17 | w[i - 2] << 15) ^
+                                (w[i - 2] >> 19 | w[i - 2] << 13) ^
+                                (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 64; ++i) {
+            kw[i] = K256[i] + w[i];
+        }
+    }
+};
+
+/** Padding block following a 64-byte message. */
+const uint32_t PAD64[16] = {0x80000000ul, 0, 0, 0, 0, 0, 0, 0,
+                            0,            0, 0, 0, 0, 0, 0, 0x200};
+
+/** One round of SHA-256 with k+w already summed. */
+inline __attribute__((always_inline)) void
+Round(__m128i a, __m128i b, __m128i c, __m128i &d, __m128i e, __m128i f,
+      __m128i g, __m128i &h, __m128i kw) {
+    __m128i t1 = Add(h, Sigma1(e), Ch(e, f, g), kw);
+    __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Run the 64 rounds over the state in s using message words w. */
+inline __attribute__((always_inline)) void Compress(__m128i *s, __m128i *w) {
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5],
+            g = s[6], h = s[7];
+    for (int i = 0; i < 64; i += 8) {
+        for (int j = 0; j < 8; ++j) {
+            const int r = i + j;
+            if (r >= 16) {
+                w[r & 15] = Add(w[r & 15], sigma1(w[(r - 2) & 15]),
+                                w[(r - 7) & 15], sigma0(w[(r - 15) & 15]));
+            }
+        }
+        Round(a, b, c, d, e, f, g, h, Add(K(K256[i + 0]), w[(i + 0) & 15]));
+        Round(h, a, b, c, d, e, f, g, Add(K(K256[i + 1]), w[(i + 1) & 15]));
+        Round(g, h, a, b, c, d, e, f, Add(K(K256[i + 2]), w[(i + 2) & 15]));
+        Round(f, g, h, a, b, c, d, e, Add(K(K256[i + 3]), w[(i + 3) & 15]));
+        Round(e, f, g, h, a, b, c, d, Add(K(K256[i + 4]), w[(i + 4) & 15]));
+        Round(d, e, f, g, h, a, b, c, Add(K(K256[i + 5]), w[(i + 5) & 15]));
+        Round(c, d, e, f, g, h, a, b, Add(K(K256[i + 6]), w[(i + 6) & 15]));
+        Round(b, c, d, e, f, g, h, a, Add(K(K256[i + 7]), w[(i + 7) & 15]));
+    }
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+/** Run the 64 rounds over the state in s using a constant schedule. */
+inline __attribute__((always_inline)) void
+CompressConst(__m128i *s, const ConstSchedule &sched) {
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5],
+            g = s[6], h = s[7];
+    for (int i = 0; i < 64; i += 8) {
+        Round(a, b, c, d, e, f, g, h, K(sched.kw[i + 0]));
+        Round(h, a, b, c, d, e, f, g, K(sched.kw[i + 1]));
+        Round(g, h, a, b, c, d, e, f, K(sched.kw[i + 2]));
+        Round(f, g, h, a, b, c, d, e, K(sched.kw[i + 3]));
+        Round(e, f, g, h, a, b, c, d, K(sched.kw[i + 4]));
+        Round(d, e, f, g, h, a, b, c, K(sched.kw[i + 5]));
+        Round(c, d, e, f, g, h, a, b, K(sched.kw[i + 6]));
+        Round(b, c, d, e, f, g, h, a, K(sched.kw[i + 7]));
+    }
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+/** Load big endian word number offset/4 of each of the 4 input blocks. */
+inline __m128i Read4(const unsigned char *chunk, int offset) {
+    return _mm_setr_epi32(
+        ReadBE32(chunk + 0 + offset), ReadBE32(chunk + 64 + offset),
+        ReadBE32(chunk + 128 + offset), ReadBE32(chunk + 192 + offset));
+}
+
+/** Store each lane of v as word number offset/4 of the 4 output hashes. */
+inline void Write4(unsigned char *out, int offset, __m128i v) {
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128((__m128i *)lanes, v);
+    for (int i = 0; i < 4; ++i) {
+        WriteBE32(out + 32 * i + offset, lanes[i]);
+    }
+}
+
+/** Load big endian word number offset/4 of 4 unrelated blocks. */
+inline __m128i ReadLanes(const unsigned char *const *chunks, int offset) {
+    return _mm_setr_epi32(
+        ReadBE32(chunks[0] + offset), ReadBE32(chunks[1] + offset),
+        ReadBE32(chunks[2] + offset), ReadBE32(chunks[3] + offset));
+}
+
+} // namespace
+
+void Transform_4way(unsigned char *out, const unsigned char *in) {
+    static const ConstSchedule pad64(PAD64);
+
+    // Transform 1: the 64-byte message itself.
+    __m128i s[8], w[16];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = K(INIT[i]);
+    }
+    for (int i = 0; i < 16; ++i) {
+        w[i] = Read4(in, 4 * i);
+    }
+    Compress(s, w);
+
+    // Transform 2: its padding.
+    CompressConst(s, pad64);
+
+    // Transform 3: hash the 32-byte result and its padding again.
+    for (int i = 0; i < 8; ++i) {
+        w[i] = s[i];
+        s[i] = K(INIT[i]);
+    }
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; ++i) {
+        w[i] = K(0);
+    }
+    w[15] = K(0x100);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; ++i) {
+        Write4(out, 4 * i, s[i]);
+    }
+}
+
+/**
+ * Run one block transform on each of 4 independent states. s holds the
+ * states word-major: word i of lane j is at s[4 * i + j].
+ */
+void TransformMulti_4way(uint32_t *s, const unsigned char *const *chunks) {
+    __m128i st[8], w[16];
+    for (int i = 0; i < 8; ++i) {
+        st[i] = _mm_loadu_si128((const __m128i *)(s + 4 * i));
+    }
+    for (int i = 0; i < 16; ++i) {
+        w[i] = ReadLanes(chunks, 4 * i);
+    }
+    Compress(st, w);
+    for (int i = 0; i < 8; ++i) {
+        _mm_storeu_si128((__m128i *)(s + 4 * i), st[i]);
+    }
+}
+
+} // namespace sha256d64_sse41
+
+#endif // ENABLE_SSE41
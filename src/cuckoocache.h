@@ -455,6 +455,22 @@ public:
         }
         return false;
     }
+
+    /**
+     * for_each calls f with each element that has been inserted and not
+     * erased since.
+     *
+     * Threadsafe with concurrent contains but not with insert.
+     *
+     * @param f callable taking a const Element&
+     */
+    template <typename F> void for_each(F f) const {
+        for (uint32_t i = 0; i < size; ++i) {
+            if (!collection_flags.bit_is_set(i)) {
+                f(table[i]);
+            }
+        }
+    }
 };
 } // namespace CuckooCache
 
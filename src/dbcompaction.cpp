@@ -0,0 +1,82 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "dbcompaction.h"
+#include "dbwrapper.h"
+#include "util.h"
+#include "utiltime.h"
+
+std::unique_ptr<CDBCompactionController> g_dbCompactionController;
+
+CDBCompactionController::CDBCompactionController(int64_t idleMicros)
+    : mIdleMicros{idleMicros} {}
+
+void CDBCompactionController::AddRange(const std::string &name,
+                                       const CDBWrapper &db, char prefix) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    // A pass start before any write makes the first pass run once the
+    // database becomes idle.
+    mRanges.push_back(Range{{name, 0, 0, 0, 0}, &db, prefix, -1});
+}
+
+void CDBCompactionController::CompactNextSlice() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    const int64_t now = GetTimeMicros();
+    for (size_t n = 0; n < mRanges.size(); ++n) {
+        const size_t index = (mNextRange + n) % mRanges.size();
+        Range &range = mRanges[index];
+        const int64_t lastWrite = range.db->GetLastWriteTime();
+        if (now - lastWrite < mIdleMicros) {
+            continue;
+        }
+        if (range.stats.nextSlice == 0) {
+            if (range.passStartTime >= lastWrite) {
+                // Not written to since the last pass.
+                continue;
+            }
+            range.passStartTime = now;
+        }
+        mNextRange = (index + 1) % mRanges.size();
+
+        const size_t slice = range.stats.nextSlice;
+        const CDBWrapper &db = *range.db;
+        const char prefix = range.prefix;
+        // Unlocked so that GetStats() does not wait for the compaction. Only
+        // the scheduler thread compacts, so the slice of the range is not
+        // changed meanwhile.
+        lock.unlock();
+
+        const int64_t start = GetTimeMicros();
+        if (slice + 1 < DB_COMPACT_SLICES) {
+            db.CompactRange(std::make_pair(prefix, uint8_t(slice)),
+                            std::make_pair(prefix, uint8_t(slice + 1)));
+        } else {
+            db.CompactRange(std::make_pair(prefix, uint8_t(slice)),
+                            std::make_pair(char(prefix + 1), uint8_t(0)));
+        }
+        const int64_t micros = std::max<int64_t>(GetTimeMicros() - start, 0);
+
+        lock.lock();
+        DBCompactionRangeStats &stats = mRanges[index].stats;
+        ++stats.slices;
+        stats.micros += micros;
+        stats.nextSlice = (slice + 1) % DB_COMPACT_SLICES;
+        if (stats.nextSlice == 0) {
+            ++stats.passes;
+            LogPrint(BCLog::LEVELDB, "Compacted all slices of %s\n",
+                     stats.name);
+        }
+        return;
+    }
+}
+
+std::vector<DBCompactionRangeStats> CDBCompactionController::GetStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<DBCompactionRangeStats> stats;
+    for (const Range &range : mRanges) {
+        stats.push_back(range.stats);
+    }
+    return stats;
+}
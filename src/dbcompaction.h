@@ -0,0 +1,85 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_DBCOMPACTION_H
+#define MVC_DBCOMPACTION_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CDBWrapper;
+
+/** Default for -dbcompactidle, in milliseconds. */
+static const int64_t DEFAULT_DB_COMPACT_IDLE = 2000;
+/** How often the compaction controller looks for idle databases. */
+static const int64_t DB_COMPACT_INTERVAL_MILLIS = 1000;
+/** Number of slices a key range is compacted in. */
+static const size_t DB_COMPACT_SLICES = 256;
+
+/** Counters of one key range of the compaction controller. */
+struct DBCompactionRangeStats {
+    std::string name;
+    //! Number of slices compacted and the time it took, in microseconds.
+    uint64_t slices;
+    uint64_t micros;
+    //! Number of times all slices of the range were compacted.
+    uint64_t passes;
+    //! Slice that is compacted next.
+    size_t nextSlice;
+};
+
+/**
+ * Compacts key ranges of LevelDB databases one slice at a time while the
+ * databases are not written to, so that data is moved out of the upper
+ * levels between blocks rather than by LevelDB's own compactions that slow
+ * down the next large write.
+ *
+ * A range is made of the keys that start with a prefix byte. As the byte
+ * after the prefix is the start of a hash for all ranges compacted, slicing
+ * by that byte splits a range into slices of about the same size.
+ */
+class CDBCompactionController {
+public:
+    //! Compact only databases that were not written in the last idleMicros.
+    explicit CDBCompactionController(int64_t idleMicros);
+
+    //! Add the keys of db that start with prefix. db must outlive the
+    //! controller.
+    void AddRange(const std::string &name, const CDBWrapper &db, char prefix);
+
+    /**
+     * Compact the next slice of the next range whose database is idle. A
+     * range is compacted again after all its slices were, once its database
+     * was written to since its last pass began. Called periodically from the
+     * scheduler.
+     */
+    void CompactNextSlice();
+
+    std::vector<DBCompactionRangeStats> GetStats() const;
+
+private:
+    struct Range {
+        DBCompactionRangeStats stats;
+        const CDBWrapper *db;
+        char prefix;
+        //! GetTimeMicros() when the current or last pass began.
+        int64_t passStartTime;
+    };
+
+    const int64_t mIdleMicros;
+
+    mutable std::mutex mMutex;
+    std::vector<Range> mRanges;
+    //! Range after the last one compacted.
+    size_t mNextRange{0};
+};
+
+/** Compaction controller of the chainstate and block index databases, or
+ * nullptr if -dbcompactidle is 0. */
+extern std::unique_ptr<CDBCompactionController> g_dbCompactionController;
+
+#endif // MVC_DBCOMPACTION_H
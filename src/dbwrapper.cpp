@@ -13,6 +13,8 @@
 #include <leveldb/filter_policy.h>
 #include <memenv.h>
 
+#include <sstream>
+
 class CMVCLevelDBLogger : public leveldb::Logger {
 public:
     // This code is adapted from posix_logger.h, which is why it is using
@@ -71,6 +73,13 @@ public:
     }
 };
 
+// Values of LevelDB's internal configuration (leveldb/db/dbformat.h and
+// version_set.cc) that are not exposed through its API.
+static const int LEVELDB_NUM_LEVELS = 7;
+static const size_t LEVELDB_L0_COMPACTION_TRIGGER = 4;
+static const size_t LEVELDB_L0_SLOWDOWN_WRITES_TRIGGER = 8;
+static const uint64_t LEVELDB_MAX_BYTES_FOR_LEVEL_1 = 10 * 1048576;
+
 static leveldb::Options GetOptions(size_t nCacheSize, size_t nMaxFiles) {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
@@ -164,12 +173,97 @@ CDBWrapper::~CDBWrapper() {
 }
 
 bool CDBWrapper::WriteBatch(CDBBatch &batch, bool fSync) {
+    const bool stalled =
+        GetLevelFileCount(0) >= LEVELDB_L0_SLOWDOWN_WRITES_TRIGGER;
+    const int64_t start = GetTimeMicros();
     leveldb::Status status =
         pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    const int64_t end = GetTimeMicros();
+
+    const uint64_t micros = std::max<int64_t>(end - start, 0);
+    ++nWrites;
+    nWriteMicros += micros;
+    for (uint64_t old = nMaxWriteMicros; micros > old;) {
+        nMaxWriteMicros.compare_exchange_weak(old, micros);
+    }
+    if (stalled) {
+        ++nStalledWrites;
+        nStalledWriteMicros += micros;
+    }
+    size_t bucket = 0;
+    for (uint64_t rest = micros; rest != 0; rest >>= 1) {
+        ++bucket;
+    }
+    ++writeLatencyCounts[std::min(bucket, WRITE_LATENCY_BUCKETS - 1)];
+    nLastWriteTime = end;
+
     dbwrapper_private::HandleError(status);
     return true;
 }
 
+size_t CDBWrapper::GetLevelFileCount(int level) const {
+    std::string value;
+    if (!pdb->GetProperty("leveldb.num-files-at-level" + std::to_string(level),
+                          &value)) {
+        return 0;
+    }
+    return std::strtoull(value.c_str(), nullptr, 10);
+}
+
+CDBWrapperStats CDBWrapper::GetStats() const {
+    CDBWrapperStats stats;
+
+    // The table files are listed level by level as
+    //   --- level 1 ---
+    //    17:123['a' .. 'd']
+    // with the file number and its size in bytes.
+    stats.levels.resize(LEVELDB_NUM_LEVELS, {0, 0});
+    std::string sstables;
+    if (pdb->GetProperty("leveldb.sstables", &sstables)) {
+        std::istringstream lines(sstables);
+        std::string line;
+        int level = -1;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 10, "--- level ") == 0) {
+                level = std::atoi(line.c_str() + 10);
+            } else if (level >= 0 && level < LEVELDB_NUM_LEVELS &&
+                       line.size() > 1 && line[0] == ' ') {
+                const size_t colon = line.find(':');
+                if (colon != std::string::npos) {
+                    ++stats.levels[level].first;
+                    stats.levels[level].second +=
+                        std::strtoull(line.c_str() + colon + 1, nullptr, 10);
+                }
+            }
+        }
+    }
+
+    stats.pendingCompactionBytes = 0;
+    if (stats.levels[0].first >= LEVELDB_L0_COMPACTION_TRIGGER) {
+        stats.pendingCompactionBytes += stats.levels[0].second;
+    }
+    uint64_t maxBytes = LEVELDB_MAX_BYTES_FOR_LEVEL_1;
+    // The last level has no size limit.
+    for (int level = 1; level < LEVELDB_NUM_LEVELS - 1; ++level) {
+        if (stats.levels[level].second > maxBytes) {
+            stats.pendingCompactionBytes +=
+                stats.levels[level].second - maxBytes;
+        }
+        maxBytes *= 10;
+    }
+
+    stats.writes = nWrites;
+    stats.writeMicros = nWriteMicros;
+    stats.maxWriteMicros = nMaxWriteMicros;
+    stats.stalledWrites = nStalledWrites;
+    stats.stalledWriteMicros = nStalledWriteMicros;
+    for (const auto &count : writeLatencyCounts) {
+        stats.writeLatencyCounts.push_back(count);
+    }
+
+    return stats;
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy past
@@ -16,6 +16,9 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <string_view>
 #include <memory>
 
@@ -29,6 +32,29 @@ public:
 
 class CDBWrapper;
 
+/** Statistics of the LevelDB database of a CDBWrapper. */
+struct CDBWrapperStats {
+    //! Number of table files and their total size in bytes, for each level.
+    std::vector<std::pair<size_t, uint64_t>> levels;
+    //! Estimated number of bytes LevelDB still has to compact to bring level
+    //! 0 below its compaction trigger and the other levels below their size
+    //! limits.
+    uint64_t pendingCompactionBytes;
+    //! Number of batches written and their total time in microseconds.
+    uint64_t writes;
+    uint64_t writeMicros;
+    //! Longest time a batch took to write, in microseconds.
+    uint64_t maxWriteMicros;
+    //! Number of batches written while level 0 had so many files that
+    //! LevelDB delays or stops writes, and their total time in microseconds.
+    uint64_t stalledWrites;
+    uint64_t stalledWriteMicros;
+    //! writeLatencyCounts[i] is the number of batches that took less than
+    //! 2^i microseconds to write but not less than 2^(i-1). The last entry
+    //! also counts the slower ones.
+    std::vector<uint64_t> writeLatencyCounts;
+};
+
 /**
  * These should be considered an implementation detail of the specific database.
  */
@@ -252,6 +278,8 @@ public:
 };
 
 class CDBIterator {
+    friend class CDBWrapper;
+
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
@@ -361,6 +389,24 @@ private:
 
     std::vector<uint8_t> CreateObfuscateKey() const;
 
+    //! Number of buckets of the write latency histogram, the last one holds
+    //! writes of about 4 seconds or more.
+    static constexpr size_t WRITE_LATENCY_BUCKETS = 24;
+
+    //! Counters of the batches written, see CDBWrapperStats.
+    std::atomic<uint64_t> nWrites{0};
+    std::atomic<uint64_t> nWriteMicros{0};
+    std::atomic<uint64_t> nMaxWriteMicros{0};
+    std::atomic<uint64_t> nStalledWrites{0};
+    std::atomic<uint64_t> nStalledWriteMicros{0};
+    std::array<std::atomic<uint64_t>, WRITE_LATENCY_BUCKETS> writeLatencyCounts{};
+
+    //! GetTimeMicros() at the end of the last write, 0 before the first.
+    std::atomic<int64_t> nLastWriteTime{0};
+
+    //! Number of table files at level, or 0 if LevelDB does not know it.
+    size_t GetLevelFileCount(int level) const;
+
 public:
     struct MaxFiles {
         const size_t maxFiles;
@@ -431,6 +477,56 @@ public:
         return true;
     }
 
+    /**
+     * Look up the values of several keys with one iterator instead of one
+     * Get() per key. The keys are visited in database order, so lookups of
+     * neighbouring keys share their table and block reads, and a key that is
+     * the entry following the previous one is reached without a new seek.
+     *
+     * Calls found(i, iterator) for every keys[i] that exists, with iterator
+     * positioned at it so that the value can be read with GetValue().
+     */
+    template <typename K, typename Callable>
+    void ReadMany(const std::vector<K>& keys, Callable&& found) const
+    {
+        std::vector<std::pair<std::string, size_t>> sortedKeys;
+        sortedKeys.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+            ssKey << keys[i];
+            sortedKeys.emplace_back(std::string(ssKey.begin(), ssKey.end()), i);
+        }
+        // std::string compares bytes as unsigned like LevelDB's default
+        // comparator.
+        std::sort(sortedKeys.begin(), sortedKeys.end());
+
+        CDBIterator it(*this, pdb->NewIterator(readoptions));
+        leveldb::Iterator& iter = *it.piter;
+        bool positioned = false;
+        for (const auto& [key, index] : sortedKeys) {
+            const leveldb::Slice slKey(key);
+            if (positioned && iter.Valid() && iter.key().compare(slKey) < 0) {
+                iter.Next();
+            }
+            // The iterator is at the first entry not before the previous key,
+            // so if it is past this key, this key does not exist either.
+            if (!positioned || (iter.Valid() && iter.key().compare(slKey) < 0)) {
+                iter.Seek(slKey);
+                positioned = true;
+            }
+            if (iter.Valid() && iter.key().compare(slKey) == 0) {
+                found(index, it);
+            }
+        }
+
+        const leveldb::Status status = iter.status();
+        if (!status.ok()) {
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            dbwrapper_private::HandleError(status);
+        }
+    }
+
     template <typename K, typename V>
     bool Write(const K &key, const V &value, bool fSync = false) {
         CDBBatch batch(*this);
@@ -462,6 +558,14 @@ public:
 
     bool WriteBatch(CDBBatch &batch, bool fSync = false);
 
+    //! GetTimeMicros() at the end of the last write, 0 if nothing was
+    //! written since the database was opened.
+    int64_t GetLastWriteTime() const { return nLastWriteTime; }
+
+    //! Return the file layout of the database and the counters of the
+    //! batches written to it.
+    CDBWrapperStats GetStats() const;
+
     // not available for LevelDB; provide for compatibility with BDB
     bool Flush() { return true; }
 
@@ -13,6 +13,7 @@
 #include "uint256.h"
 #include "version.h"
 
+#include <algorithm>
 #include <vector>
 
 typedef uint256 ChainCode;
@@ -236,6 +237,47 @@ uint256 SerializeSingleHash_OpNoCSize(const T &obj, int nType = SER_GETHASH,
 }
 
 
+/**
+ * Collects byte strings and computes the single SHA256 of each of them with
+ * one SHA256Multi() call, so that the multi-buffer transforms can hash
+ * several of them in parallel lanes.
+ */
+class CMultiSingleHasher {
+private:
+    std::vector<const uint8_t *> data;
+    std::vector<size_t> sizes;
+    std::vector<uint256> hashes;
+
+public:
+    explicit CMultiSingleHasher(size_t reserve) {
+        data.reserve(reserve);
+        sizes.reserve(reserve);
+        hashes.reserve(reserve);
+    }
+
+    template <unsigned int N>
+    CMultiSingleHasher &Add(const prevector<N, uint8_t> &vch) {
+        data.push_back(vch.data());
+        sizes.push_back(vch.size());
+        return *this;
+    }
+
+    void Clear() {
+        data.clear();
+        sizes.clear();
+    }
+
+    /** Hashes of everything added since the last Clear(), in order. */
+    const std::vector<uint256> &Finalize() {
+        static_assert(sizeof(uint256) == CSHA256::OUTPUT_SIZE,
+                      "uint256 must be a plain 32 byte array");
+        hashes.resize(data.size());
+        SHA256Multi(hashes.empty() ? nullptr : hashes.front().begin(),
+                    data.data(), sizes.data(), data.size());
+        return hashes;
+    }
+};
+
 template <typename T>
 uint256 TxSerializeHash(const T &obj, int nType = SER_GETHASH,
                       int nVersion = PROTOCOL_VERSION) {
@@ -247,20 +289,32 @@ uint256 TxSerializeHash(const T &obj, int nType = SER_GETHASH,
         ser_writedata32(ss_root, obj.vin.size() );
         ser_writedata32(ss_root, obj.vout.size() );
 
+        // Script hashes are the single SHA256 of the raw script bytes, the
+        // same as SerializeSingleHash_OpNoCSize(script), computed in batches.
+        CMultiSingleHasher scripts(std::max(obj.vin.size(), obj.vout.size()));
+
         CHashWriter ss_in(nType, nVersion);
         CHashWriter ss_in_unlock(nType, nVersion);
         for (const CTxIn &iin : obj.vin) {
             ss_in << iin.prevout;
             ss_in << iin.nSequence;
-            ss_in_unlock << SerializeSingleHash_OpNoCSize( iin.scriptSig, SER_GETHASH, 0 );
+            scripts.Add(iin.scriptSig);
+        }
+        for (const uint256 &hash : scripts.Finalize()) {
+            ss_in_unlock << hash;
         }
         ss_root << ss_in.GetSingleHash();
         ss_root << ss_in_unlock.GetSingleHash();
 
-        CHashWriter ss_out(nType, nVersion);
+        scripts.Clear();
         for (const CTxOut &iout : obj.vout) {
-            ss_out << iout.nValue;
-            ss_out << SerializeSingleHash_OpNoCSize( iout.scriptPubKey, SER_GETHASH, 0);
+            scripts.Add(iout.scriptPubKey);
+        }
+        const std::vector<uint256> &outHashes = scripts.Finalize();
+        CHashWriter ss_out(nType, nVersion);
+        for (size_t i = 0; i < obj.vout.size(); ++i) {
+            ss_out << obj.vout[i].nValue;
+            ss_out << outHashes[i];
         }
         ss_root << ss_out.GetSingleHash();
         return ss_root.GetHash();
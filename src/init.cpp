@@ -19,6 +19,7 @@
 #include "config.h"
 #include "consensus/validation.h"
 #include "consensus/consensus.h"
+#include "dbcompaction.h"
 #include "double_spend/dsattempt_handler.h"
 #include "fs.h"
 #include "httprpc.h"
@@ -36,7 +37,9 @@
 #include "rpc/webhook_client.h"
 #include "rpc/webhook_client_defaults.h"
 #include "scheduler.h"
+#include "script/compiled_script.h"
 #include "script/script.h"
+#include "script/script_profiler.h"
 #include "script/scriptcache.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
@@ -49,6 +52,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "utxo_snapshot.h"
 #include "validation.h"
 #include "validationinterface.h"
 #include "vmtouch.h"
@@ -135,6 +139,7 @@ enum BindFlags {
 
 std::shared_ptr<task::CCancellationSource> shutdownSource(task::CCancellationSource::Make());
 std::atomic<bool> fDumpMempoolLater(false);
+std::atomic<bool> fDumpScriptCachesLater(false);
 
 void StartShutdown() {
     shutdownSource->Cancel();
@@ -195,22 +200,30 @@ void Shutdown() {
     // must be called after g_connman shutdown as conman threads could still be
     // using it before that
     ShutdownScriptCheckQueues();
+    ShutdownCoinsPrefetchPool();
 
     UnregisterNodeSignals(GetNodeSignals());
     if (fDumpMempoolLater &&
         gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         mempool.DumpMempool();
     }
+    if (fDumpScriptCachesLater) {
+        DumpScriptCaches(GlobalConfig::GetConfig());
+    }
 
     {
         LOCK(cs_main);
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
         }
+        g_dbCompactionController.reset();
         pcoinsTip.reset();
         delete pblocktree;
         pblocktree = nullptr;
     }
+    // After the last flush, which waits for the UTXO set hash changes that
+    // are still being hashed on the pool.
+    ShutdownUtxoSetHashPool();
 #ifdef ENABLE_WALLET
     for (CWalletRef pwallet : vpwallets) {
         pwallet->Flush(true);
@@ -351,6 +364,19 @@ std::string HelpMessage(HelpMessageMode mode, const Config& config) {
         strprintf(
             _("Set database cache size in megabytes (%d to %d, default: %d). The value may be given in megabytes or with unit (B, KiB, MiB, GiB)."),
             nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt(
+        "-asynccoinsflush",
+        strprintf(
+            _("Write the coins database cache to disk in the background while blocks are validated. "
+              "Memory use may then temporarily reach about twice -dbcache (default: %d)"),
+            DEFAULT_ASYNC_COINS_FLUSH));
+    strUsage += HelpMessageOpt(
+        "-dbcompactidle=<n>",
+        strprintf(
+            _("Compact the chainstate and block index databases a slice at a time when they were "
+              "not written for <n> milliseconds and no block is being validated, 0 to disable "
+              "(default: %d)"),
+            DEFAULT_DB_COMPACT_IDLE));
 
     if (showDebug) {
         strUsage += HelpMessageOpt(
@@ -368,6 +394,18 @@ std::string HelpMessage(HelpMessageMode mode, const Config& config) {
     strUsage += HelpMessageOpt(
         "-loadblock=<file>",
         _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt(
+        "-loadutxosnapshot=<file>",
+        _("Rebuild the chain state from a UTXO snapshot written by "
+          "dumputxoset instead of connecting the blocks up to the block of "
+          "the snapshot, which must already be in the block index with its "
+          "transactions. The chain state is replaced unless its best block "
+          "is the block of the snapshot or descends from it"));
+    strUsage += HelpMessageOpt(
+        "-utxosnapshothash=<hex>",
+        _("UTXO set hash (the muhash of gettxoutsetinfo at the block of the "
+          "snapshot) that the snapshot given by -loadutxosnapshot must have. "
+          "Required unless the hash of the snapshot is built in"));
 
     strUsage += HelpMessageOpt("-maxmempool=<n>",
                    strprintf(_("Keep the resident size of the transaction memory pool below <n> megabytes "
@@ -460,12 +498,33 @@ std::string HelpMessage(HelpMessageMode mode, const Config& config) {
                        strprintf(_("Whether to save the mempool on shutdown "
                                    "and load on restart (default: %u)"),
                                  DEFAULT_PERSIST_MEMPOOL));
+    strUsage +=
+        HelpMessageOpt("-persistscriptcache",
+                       strprintf(_("Whether to save the signature and script "
+                                   "execution caches on shutdown and load "
+                                   "them on restart (default: %u)"),
+                                 DEFAULT_PERSIST_SCRIPT_CACHE));
     strUsage += HelpMessageOpt(
         "-threadsperblock=<n>",
         strprintf(_("Set the number of script verification threads used when "
                     "validating single block (0 to %d, 0 = auto, default: %d)"),
                   MAX_SCRIPTCHECK_THREADS,
                   DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt(
+        "-utxoprefetchthreads=<n>",
+        strprintf(_("Set the number of threads that load the coins spent by a "
+                    "block from the database before it is connected (0 to %d, "
+                    "0 = disabled, default: %d)"),
+                  MAX_UTXO_PREFETCH_THREADS,
+                  DEFAULT_UTXO_PREFETCH_THREADS));
+    strUsage += HelpMessageOpt(
+        "-utxosethashthreads=<n>",
+        strprintf(_("Set the number of threads that update the UTXO set hash "
+                    "reported by gettxoutsetinfo as blocks are connected and "
+                    "disconnected (0 to %d, 0 = hash not maintained, "
+                    "default: %d)"),
+                  MAX_UTXO_SET_HASH_THREADS,
+                  DEFAULT_UTXO_SET_HASH_THREADS));
     strUsage +=
         HelpMessageOpt(
             "-scriptvalidatormaxbatchsize=<n>",
@@ -902,6 +961,18 @@ std::string HelpMessage(HelpMessageMode mode, const Config& config) {
             "-maxinvalidsigcachesize=<n>",
             strprintf("Limit size of invalid signature cache to <n> MiB (default: %u). The value may be given in megabytes or with unit (B, KiB, MiB, GiB).",
                       DEFAULT_INVALID_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt(
+            "-maxpubkeycachesize=<n>",
+            strprintf("Limit size of parsed public key cache to <n> MiB (default: %u). The value may be given in megabytes or with unit (B, KiB, MiB, GiB).",
+                      DEFAULT_MAX_PUBKEY_CACHE_SIZE));
+        strUsage += HelpMessageOpt(
+            "-maxscriptprogramcachesize=<n>",
+            strprintf("Limit size of the cache of decoded output scripts to <n> MiB, 0 to disable (default: %u). The value may be given in megabytes or with unit (B, KiB, MiB, GiB).",
+                      DEFAULT_MAX_SCRIPT_PROGRAM_CACHE_SIZE));
+        strUsage += HelpMessageOpt(
+            "-scriptprofiler",
+            strprintf("Collect per-opcode execution statistics of the scripts evaluated during validation, grouped by output script template, see getscriptprofile (default: %d)",
+                      DEFAULT_SCRIPT_PROFILER));
         strUsage += HelpMessageOpt(
             "-maxscriptcachesize=<n>",
             strprintf("Limit size of script cache to <n> MiB (default: %u). The value may be given in megabytes or with unit (B, KiB, MiB, GiB).",
@@ -1955,6 +2026,8 @@ bool AppInitParameterInteraction(ConfigInit &config) {
                                         chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled =
         gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fAsyncCoinsFlush =
+        gArgs.GetBoolArg("-asynccoinsflush", DEFAULT_ASYNC_COINS_FLUSH);
 
     hashAssumeValid = uint256S(
         gArgs.GetArg("-assumevalid",
@@ -2992,11 +3065,39 @@ bool AppInitMain(ConfigInit &config, boost::thread_group &threadGroup,
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    if (gArgs.GetBoolArg("-persistscriptcache", DEFAULT_PERSIST_SCRIPT_CACHE)) {
+        LoadScriptCaches(config);
+        fDumpScriptCachesLater = true;
+    }
+    InitScriptProfileMetrics();
+    EnableScriptProfiler(gArgs.GetBoolArg("-scriptprofiler", DEFAULT_SCRIPT_PROFILER));
 
     LogPrintf("Using %u threads for script verification\n",
               config.GetPerBlockScriptValidatorThreadsCount());
     InitScriptCheckQueues(config, threadGroup);
 
+    const int64_t utxoPrefetchThreads =
+        gArgs.GetArg("-utxoprefetchthreads", DEFAULT_UTXO_PREFETCH_THREADS);
+    if (utxoPrefetchThreads < 0 ||
+        utxoPrefetchThreads > MAX_UTXO_PREFETCH_THREADS) {
+        return InitError(strprintf(
+            _("-utxoprefetchthreads must be between 0 and %d"),
+            MAX_UTXO_PREFETCH_THREADS));
+    }
+    LogPrintf("Using %u threads for coins prefetching\n", utxoPrefetchThreads);
+    InitCoinsPrefetchPool(utxoPrefetchThreads);
+
+    const int64_t utxoSetHashThreads =
+        gArgs.GetArg("-utxosethashthreads", DEFAULT_UTXO_SET_HASH_THREADS);
+    if (utxoSetHashThreads < 0 ||
+        utxoSetHashThreads > MAX_UTXO_SET_HASH_THREADS) {
+        return InitError(strprintf(
+            _("-utxosethashthreads must be between 0 and %d"),
+            MAX_UTXO_SET_HASH_THREADS));
+    }
+    LogPrintf("Using %u threads for the UTXO set hash\n", utxoSetHashThreads);
+    InitUtxoSetHashPool(utxoSetHashThreads);
+
     // Late configuration for globaly constructed objects
     mempool.SuspendSanityCheck();
     mempool.getNonFinalPool().loadConfig();
@@ -3204,6 +3305,23 @@ bool AppInitMain(ConfigInit &config, boost::thread_group &threadGroup,
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
 
+    const std::string utxoSnapshot = gArgs.GetArg("-loadutxosnapshot", "");
+    std::optional<uint256> utxoSnapshotHash;
+    if (!utxoSnapshot.empty()) {
+        if (fReindex || fReindexChainState) {
+            return InitError(_("-loadutxosnapshot can not be used together "
+                               "with -reindex or -reindex-chainstate"));
+        }
+        if (gArgs.IsArgSet("-utxosnapshothash")) {
+            const std::string hex = gArgs.GetArg("-utxosnapshothash", "");
+            if (hex.size() != 64 || !IsHex(hex)) {
+                return InitError(
+                    strprintf(_("Invalid -utxosnapshothash '%s'"), hex));
+            }
+            utxoSnapshotHash = uint256S(hex);
+        }
+    }
+
     // cache size calculations
     int64_t nTotalCache = gArgs.GetArgAsBytes("-dbcache", nDefaultDbCache, ONE_MEBIBYTE);
     // total cache cannot be less than nMinDbCache
@@ -3274,9 +3392,18 @@ bool AppInitMain(ConfigInit &config, boost::thread_group &threadGroup,
                     if (fPruneMode) {
                         CleanupBlockRevFiles();
                     }
+                } else if (!utxoSnapshot.empty()) {
+                    // Checked below, a chain state that is not usable is
+                    // replaced by the snapshot.
                 } else if (pcoinsTip->IsOldDBFormat()) {
                     strLoadError = _("Refusing to start, older database format detected");
                     break;
+                } else if (pcoinsTip->IsSnapshotLoadIncomplete()) {
+                    strLoadError = _("Loading of a UTXO snapshot did not "
+                                     "complete, load it again with "
+                                     "-loadutxosnapshot or rebuild the "
+                                     "database using -reindex-chainstate");
+                    break;
                 }
                 if (shutdownToken.IsCanceled()) break;
 
@@ -3321,6 +3448,65 @@ bool AppInitMain(ConfigInit &config, boost::thread_group &threadGroup,
                     break;
                 }
 
+                // Set if the chain state is replaced by the snapshot.
+                std::optional<fs::path> utxoSnapshotPath;
+                if (!utxoSnapshot.empty()) {
+                    const fs::path snapshotPath =
+                        fs::absolute(utxoSnapshot, GetDataDir());
+                    const std::optional<uint256> snapshotBlock =
+                        ReadUtxoSnapshotBlock(config, snapshotPath);
+                    if (!snapshotBlock.has_value()) {
+                        return InitError(strprintf(
+                            _("Unable to load UTXO snapshot %s, see the log"),
+                            utxoSnapshot));
+                    }
+
+                    // Keep a chain state that was loaded from the snapshot
+                    // on an earlier start, or was connected past it since.
+                    const CBlockIndex* snapshotIndex =
+                        mapBlockIndex.Get(*snapshotBlock);
+                    const CBlockIndex* bestIndex =
+                        mapBlockIndex.Get(CoinsDBView{ *pcoinsTip }.GetBestBlock());
+                    if (snapshotIndex && bestIndex &&
+                        !pcoinsTip->IsOldDBFormat() &&
+                        !pcoinsTip->IsSnapshotLoadIncomplete() &&
+                        bestIndex->GetAncestor(snapshotIndex->GetHeight()) ==
+                            snapshotIndex) {
+                        LogPrintf("Chain state at block %s already contains "
+                                  "UTXO snapshot %s, not loading it\n",
+                                  bestIndex->GetBlockHash().ToString(),
+                                  utxoSnapshot);
+                    } else {
+                        utxoSnapshotPath = snapshotPath;
+                    }
+                }
+
+                if (utxoSnapshotPath.has_value()) {
+                    pcoinsTip.reset();
+                    pcoinsTip =
+                        std::make_unique<CoinsDB>(
+                            config.GetMaxCoinsProviderCacheSize(),
+                            nCoinDBCache,
+                            CDBWrapper::MaxFiles{config.GetMaxCoinsDbOpenFiles()},
+                            false,
+                            true);
+
+                    uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+                    if (!LoadUtxoSnapshot(
+                            config,
+                            *utxoSnapshotPath,
+                            utxoSnapshotHash,
+                            *pcoinsTip,
+                            shutdownToken)) {
+                        if (shutdownToken.IsCanceled()) {
+                            break;
+                        }
+                        return InitError(strprintf(
+                            _("Unable to load UTXO snapshot %s, see the log"),
+                            utxoSnapshot));
+                    }
+                }
+
                 if (!ReplayBlocks(config, *pcoinsTip)) {
                     strLoadError =
                         _("Unable to replay blocks. You will need to rebuild "
@@ -3542,6 +3728,31 @@ bool AppInitMain(ConfigInit &config, boost::thread_group &threadGroup,
     assert(!rpc::client::g_pWebhookClient);
     rpc::client::g_pWebhookClient = std::make_unique<rpc::client::WebhookClient>(config);
 
+    // Compact the databases between blocks
+    const int64_t dbCompactIdle =
+        gArgs.GetArg("-dbcompactidle", DEFAULT_DB_COMPACT_IDLE);
+    if (dbCompactIdle < 0) {
+        return InitError(_("-dbcompactidle must not be negative"));
+    }
+    if (dbCompactIdle > 0) {
+        assert(!g_dbCompactionController);
+        g_dbCompactionController =
+            std::make_unique<CDBCompactionController>(dbCompactIdle * 1000);
+        {
+            LOCK(cs_main);
+            pcoinsTip->AddCompactionRanges(*g_dbCompactionController);
+            pblocktree->AddCompactionRanges(*g_dbCompactionController, fTxIndex);
+        }
+        scheduler.scheduleEvery(
+            [] {
+                if (!IsInitialBlockDownload() &&
+                    blockValidationStatus.getCurrentlyValidatingBlocks().empty()) {
+                    g_dbCompactionController->CompactNextSlice();
+                }
+            },
+            DB_COMPACT_INTERVAL_MILLIS);
+    }
+
     // Step 12: finished
 
     SetRPCWarmupFinished();
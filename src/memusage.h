@@ -7,6 +7,7 @@
 
 #include "indirectmap.h"
 #include "prevector.h"
+#include "support/allocators/pool.h"
 
 #include <cstdlib>
 
@@ -180,6 +181,24 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z> &m) {
                m.size() +
            MallocUsage(sizeof(void *) * m.bucket_count());
 }
+
+/**
+ * The nodes of a map with a PoolAllocator are accounted by the chunks of its
+ * pool, which include the nodes that were erased and wait for reuse. Bucket
+ * arrays come from the pool as long as they fit into a block.
+ */
+template <typename X, typename Y, typename Z, typename E,
+          size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(
+    const std::unordered_map<
+        X, Y, Z, E,
+        PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES,
+                      ALIGN_BYTES>> &m) {
+    const size_t bucketBytes = sizeof(void *) * m.bucket_count();
+    return DynamicUsage(m.get_allocator().GetResource()) +
+           m.get_allocator().GetResource()->DynamicMemoryUsage() +
+           (bucketBytes > MAX_BLOCK_SIZE_BYTES ? MallocUsage(bucketBytes) : 0);
+}
 } // namespace memusage
 
 #endif // MVC_MEMUSAGE_H
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "merkletree.h"
+#include "crypto/sha256.h"
 #include "task_helpers.h"
 #include "blockstreams.h"
 
@@ -47,15 +48,48 @@ std::future<CMerkleTree> CMerkleTree::CreateBatchTask(typename std::vector<eleme
     auto calculateSubTree = [batchBeginIter, batchEndIter]()
     {
         CMerkleTree subTree(batchEndIter - batchBeginIter);
-        for (auto it = batchBeginIter; it != batchEndIter; ++it)
-        {
-            subTree.AddTransactionId(*it);
-        }
+        subTree.CalculateSubTree<elementType>(batchBeginIter, batchEndIter);
         return subTree;
     };
     return (make_task(threadPool, calculateSubTree));
 }
 
+template <typename elementType>
+void CMerkleTree::CalculateSubTree(typename std::vector<elementType>::const_iterator batchBeginIter,
+    typename std::vector<elementType>::const_iterator batchEndIter)
+{
+    // Levels are reserved for all leaves, if known, so that merging subtrees doesn't reallocate
+    const size_t numberOfBatchLeaves = static_cast<size_t>(std::distance(batchBeginIter, batchEndIter));
+    const size_t numberOfReservedLeaves = std::max(numberOfLeaves, numberOfBatchLeaves);
+    std::vector<uint256> leaves;
+    leaves.reserve(numberOfReservedLeaves);
+    for (auto it = batchBeginIter; it != batchEndIter; ++it)
+    {
+        leaves.push_back(GetTransactionId(*it));
+    }
+    merkleTreeLevelsWithNodeHashes.push_back(std::move(leaves));
+
+    /* Each upper level holds parents of all complete sibling pairs from the level below.
+       Odd node at the end of a level stays without a parent, exactly as with AddNodeAtLevel,
+       so that the tree can still be merged or completed by GetMerkleRoot.
+     */
+    while (merkleTreeLevelsWithNodeHashes.back().size() > 1)
+    {
+        const std::vector<uint256>& currentLevel = merkleTreeLevelsWithNodeHashes.back();
+        const size_t numberOfPairs = currentLevel.size() / 2;
+        for (size_t i = 0; i < numberOfPairs; ++i)
+        {
+            mutated |= (currentLevel[2 * i] == currentLevel[2 * i + 1]);
+        }
+        // uint256 is a plain 32 byte blob, so a level is a contiguous buffer of 64 byte sibling pairs
+        std::vector<uint256> upperLevel;
+        upperLevel.reserve(numberOfReservedLeaves >> merkleTreeLevelsWithNodeHashes.size());
+        upperLevel.resize(numberOfPairs);
+        SHA256D64(upperLevel.front().begin(), currentLevel.front().begin(), numberOfPairs);
+        merkleTreeLevelsWithNodeHashes.push_back(std::move(upperLevel));
+    }
+}
+
 template <typename elementType>
 void CMerkleTree::CalculateMerkleTree(const std::vector<elementType>& vTransactions, CThreadPool<CQueueAdaptor>* pThreadPool)
 {
@@ -107,10 +141,7 @@ void CMerkleTree::CalculateMerkleTree(const std::vector<elementType>& vTransacti
     batchBeginIter = vTransactions.cbegin();
     batchEndIter = batchBeginIter;
     std::advance(batchEndIter, intBatchSize);
-    for (auto it = batchBeginIter; it != batchEndIter; ++it)
-    {
-        AddTransactionId(*it);
-    }
+    CalculateSubTree<elementType>(batchBeginIter, batchEndIter);
 
     // Tasks must be ordered to make sure Merkle Tree is merged properly with other subtrees
     for (auto &f : futures)
@@ -144,6 +175,7 @@ void CMerkleTree::AddNodeAtLevel(const uint256& hash, size_t level)
              */
             uint256 leftNode = merkleTreeLevelsWithNodeHashes[currentLevel].back();
             uint256 rightNode = currentNode;
+            mutated |= (leftNode == rightNode);
 
             CHash256()
                 .Write(leftNode.begin(), 32)
@@ -197,6 +229,8 @@ bool CMerkleTree::MergeSubTree(const CMerkleTree& subTree)
     //Merge only if current height is same or greater than subtree we want to merge with
     if (currentTreeHeight >= subTreeHeight)
     {
+        mutated |= subTree.mutated;
+
         // Add subtree's root node. This will also calculate nodes in upper levels if needed.
         size_t currentLevel = subTreeHeight - 1;
         AddNodeAtLevel(subTree.merkleTreeLevelsWithNodeHashes[currentLevel].back(), currentLevel);
@@ -59,6 +59,13 @@ static constexpr uint64_t DEFAULT_PREFERRED_MERKLETREE_FILE_SIZE{ 32 * ONE_MEBIB
  */
 static constexpr uint64_t MIN_DISK_SPACE_FOR_MERKLETREE_FILES{ 288 / 2 * ONE_MEBIBYTE + DEFAULT_PREFERRED_MERKLETREE_FILE_SIZE };
 
+/**
+ * Blocks with at least this many transactions have their Merkle root checked by calculating
+ * the whole Merkle Tree in parallel, which is then kept in the Merkle Tree memory cache.
+ * Two batches of 4096 leaves are the smallest tree that is split across threads.
+ */
+static constexpr size_t MIN_TRANSACTIONS_FOR_PARALLEL_MERKLE_TREE{ 2 * 0x1000 };
+
 /** The default maximum size of a Merkle Tree memory cache */
 static constexpr uint64_t DEFAULT_MAX_MERKLETREE_MEMORY_CACHE_SIZE{ 32 * ONE_MEBIBYTE }; // 32 MiB
 
@@ -75,6 +82,12 @@ private:
      * Height of a block from which this Merkle Tree was stored. Used in (de)serialization when merkle tree is written to or read from a data file.
      */
     int32_t blockHeight{ 0 };
+    /**
+     * Set when two identical sibling nodes were hashed together while building the tree.
+     * This is the same duplicated subtree condition (CVE-2012-2459) that BlockMerkleRoot
+     * reports through its mutated parameter. Not serialized.
+     */
+    bool mutated{ false };
 
     /* Deleted copy constructor and assignment operator.
      * We want to avoid copy and assignment for performance reasons.
@@ -104,6 +117,18 @@ private:
     template <typename elementType>
     void CalculateMerkleTree(const std::vector<elementType>& vTransactions, CThreadPool<CQueueAdaptor>* pThreadPool = nullptr);
 
+    /**
+     * Builds the tree of an empty CMerkleTree from transactions in range [batchBeginIter, batchEndIter)
+     * level by level. All sibling pairs of a level are hashed with a single batched SHA256D64 call.
+     * The resulting levels are the same as if every transaction was added with AddTransactionId.
+     */
+    template <typename elementType>
+    void CalculateSubTree(typename std::vector<elementType>::const_iterator batchBeginIter,
+        typename std::vector<elementType>::const_iterator batchEndIter);
+
+    static uint256 GetTransactionId(const CTransactionRef& transactionRef) { return transactionRef->GetId(); }
+    static uint256 GetTransactionId(const uint256& transactionId) { return transactionId; }
+
     /**
      * Adds a transaction id into a Merkle Tree as its new leaf.
      * Function is used to incrementally construct a Merkle Tree. This is useful when
@@ -196,6 +221,12 @@ public:
      */
     uint256 GetMerkleRoot() const;
 
+    /**
+     * Returns true if a duplicated subtree was found while building the tree. Such a tree
+     * must be rejected in the same way as BlockMerkleRoot reporting a mutation.
+     */
+    bool IsMutated() const { return mutated; };
+
     /*
      * Returns size of Merkle Tree in bytes by calculating number of all hashes stored
      * multiplied by 32 bytes (uint256).
@@ -563,6 +563,11 @@ CMerkleTreeRef CMerkleTreeFactory::GetMerkleTree(const Config& config, CBlockInd
     return merkleTreeRef;
 }
 
+std::unique_ptr<CMerkleTree> CMerkleTreeFactory::CalculateMerkleTree(const CBlock& block, int32_t blockHeight)
+{
+    return std::make_unique<CMerkleTree>(block.vtx, block.GetHash(), blockHeight, merkleTreeThreadPool.get());
+}
+
 void CMerkleTreeFactory::Insert(const uint256& blockHash, CMerkleTreeRef merkleTree, const Config& config)
 {
     LOCK(cs_merkleTreeFactory);
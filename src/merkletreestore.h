@@ -209,7 +209,15 @@ public:
      * Returns null if block could not be read from disk to create a Merkle Tree.
      */
     CMerkleTreeRef GetMerkleTree(const Config& config, CBlockIndex& blockIndex, const int32_t currentChainHeight);
-private:
+
+    /**
+     * Calculates Merkle Tree of a block that is being validated, splitting its leaves across
+     * the Merkle Tree thread pool. Used by CheckBlock on big blocks so that the same pass gives
+     * the Merkle root to check and the tree for the cache (see Insert). The result is not
+     * cached by this function because the block is not known to be valid yet.
+     */
+    std::unique_ptr<CMerkleTree> CalculateMerkleTree(const CBlock& block, int32_t blockHeight);
+
     /**
      * Inserts merkleTree into a cached map with key blockHash.
      * By default cache size is limited to 32 MiB and can be configured with
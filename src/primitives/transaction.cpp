@@ -75,6 +75,110 @@ CTransaction::CTransaction(const CMutableTransaction &tx)
 CTransaction::CTransaction(CMutableTransaction &&tx)
     : nVersion(tx.nVersion), vin(std::move(tx.vin)), vout(std::move(tx.vout)),
       nLockTime(tx.nLockTime), hash(ComputeHash()) {}
+CTransaction::CTransaction(CDeserializedTransaction &&deserialized)
+    : nVersion(deserialized.tx.nVersion),
+      vin(std::move(deserialized.tx.vin)),
+      vout(std::move(deserialized.tx.vout)),
+      nLockTime(deserialized.tx.nLockTime), hash(deserialized.hash) {}
+
+const PrecomputedTransactionData &
+CTransaction::GetPrecomputedTransactionData() const {
+    std::shared_ptr<const PrecomputedTransactionData> data =
+        precomputedData.Load();
+    if (!data) {
+        // Threads racing here compute the same hashes, only one is kept.
+        data = precomputedData.Publish(
+            std::make_shared<const PrecomputedTransactionData>(
+                PrecomputedTransactionData::ComputeHashes(*this)));
+    }
+    // Once published the data lives as long as this transaction.
+    return *data;
+}
+
+namespace {
+/** Serialization stream that feeds a CSHA256, see CHashWriter. */
+class CSHA256Writer {
+private:
+    CSHA256 &sha;
+
+public:
+    explicit CSHA256Writer(CSHA256 &shaIn) : sha(shaIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char *pch, size_t size) {
+        sha.Write((const uint8_t *)pch, size);
+    }
+
+    template <typename T> CSHA256Writer &operator<<(const T &obj) {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
+uint256 SingleFinalize(CSHA256 &sha) {
+    uint256 result;
+    sha.Finalize(result.begin());
+    return result;
+}
+} // namespace
+
+CTxIdBuilder::CTxIdBuilder(int32_t nVersion) : legacy(nVersion < 10) {
+    if (legacy) {
+        // nVersion has been read before the builder existed.
+        CSHA256Writer(raw) << nVersion;
+    }
+}
+
+void CTxIdBuilder::AddInputs(const CTxIn *vin, size_t count) {
+    CSHA256Writer in(inputs);
+    CSHA256Writer unlock(unlockScripts);
+    CMultiSingleHasher scripts(count);
+    for (size_t i = 0; i < count; ++i) {
+        in << vin[i].prevout;
+        in << vin[i].nSequence;
+        scripts.Add(vin[i].scriptSig);
+    }
+    for (const uint256 &hash : scripts.Finalize()) {
+        unlock << hash;
+    }
+}
+
+void CTxIdBuilder::AddOutputs(const CTxOut *vout, size_t count) {
+    CSHA256Writer out(outputs);
+    CMultiSingleHasher scripts(count);
+    for (size_t i = 0; i < count; ++i) {
+        scripts.Add(vout[i].scriptPubKey);
+    }
+    const std::vector<uint256> &hashes = scripts.Finalize();
+    for (size_t i = 0; i < count; ++i) {
+        out << vout[i].nValue;
+        out << hashes[i];
+    }
+}
+
+uint256 CTxIdBuilder::Finalize(const CMutableTransaction &tx) {
+    uint256 result;
+    if (legacy) {
+        // Same as the double SHA256 of SerializeHash(tx).
+        uint8_t buf[CSHA256::OUTPUT_SIZE];
+        raw.Finalize(buf);
+        CSHA256().Write(buf, sizeof(buf)).Finalize(result.begin());
+        return result;
+    }
+
+    // Same layout as the version 10 branch of TxSerializeHash().
+    CHashWriter root(SER_GETHASH, 0);
+    root << tx.nVersion;
+    root << tx.nLockTime;
+    ser_writedata32(root, tx.vin.size());
+    ser_writedata32(root, tx.vout.size());
+    root << SingleFinalize(inputs);
+    root << SingleFinalize(unlockScripts);
+    root << SingleFinalize(outputs);
+    return root.GetHash();
+}
 
 Amount CTransaction::GetValueOut() const {
     Amount nValueOut(0);
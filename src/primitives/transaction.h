@@ -8,9 +8,14 @@
 #define MVC_PRIMITIVES_TRANSACTION_H
 
 #include "amount.h"
+#include "crypto/sha256.h"
 #include "script/script.h"
 #include "serialize.h"
 #include "uint256.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <optional>
 
 struct TxId;
@@ -222,6 +227,10 @@ public:
 };
 
 class CMutableTransaction;
+struct CDeserializedTransaction;
+
+template <typename Stream>
+CDeserializedTransaction UnserializeTransactionWithId(Stream &s);
 
 /**
  * Basic transaction serialization format:
@@ -251,6 +260,8 @@ inline void SerializeTransaction(const TxType &tx, Stream &s) {
     s << tx.nLockTime;
 }
 
+struct PrecomputedTransactionData;
+
 /**
  * The basic transaction that is broadcasted on the network and contained in
  * blocks. A transaction can contain multiple inputs and outputs.
@@ -277,11 +288,49 @@ public:
     const uint32_t nLockTime;
 
 private:
+    /**
+     * Pointer to data computed on first use that is then published to all
+     * threads. Copies of the holder load the pointer atomically as well.
+     */
+    class LazyPrecomputedData {
+    public:
+        LazyPrecomputedData() = default;
+        LazyPrecomputedData(const LazyPrecomputedData &other)
+            : data(std::atomic_load(&other.data)) {}
+        LazyPrecomputedData &operator=(const LazyPrecomputedData &) = delete;
+
+        std::shared_ptr<const PrecomputedTransactionData> Load() const {
+            return std::atomic_load(&data);
+        }
+
+        /**
+         * Publish value unless another thread was first. Returns the
+         * published value.
+         */
+        std::shared_ptr<const PrecomputedTransactionData>
+        Publish(std::shared_ptr<const PrecomputedTransactionData> value) const {
+            std::shared_ptr<const PrecomputedTransactionData> expected;
+            if (std::atomic_compare_exchange_strong(&data, &expected, value)) {
+                return value;
+            }
+            return expected;
+        }
+
+    private:
+        mutable std::shared_ptr<const PrecomputedTransactionData> data;
+    };
+
     /** Memory only. */
     const uint256 hash;
 
+    /** Memory only, see GetPrecomputedTransactionData(). */
+    LazyPrecomputedData precomputedData;
+
     uint256 ComputeHash() const;
 
+    /** Take over a transaction whose id was computed while reading it. */
+    explicit CTransaction(CDeserializedTransaction &&deserialized);
+
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
     CTransaction();
@@ -297,17 +346,26 @@ public:
     /**
      * This deserializing constructor is provided instead of an Unserialize
      * method. Unserialize is not possible, since it would require overwriting
-     * const fields.
+     * const fields. The id is computed in the same pass over the data.
      */
     template <typename Stream>
     CTransaction(deserialize_type, Stream &s)
-        : CTransaction(CMutableTransaction(deserialize, s)) {}
+        : CTransaction(UnserializeTransactionWithId(s)) {}
 
     bool IsNull() const { return vin.empty() && vout.empty(); }
 
     const TxId GetId() const { return TxId(hash); }
     const TxHash GetHash() const { return TxHash(hash); }
 
+    /**
+     * Get hashPrevouts, hashSequence and hashOutputs of this transaction. They
+     * are computed once, on first use, and then follow the shared transaction
+     * from mempool acceptance into block validation and reorg resubmission.
+     * The returned data has no scriptCode midstate cache, that one is created
+     * for each validation by PrecomputedTransactionData(const CTransaction&).
+     */
+    const PrecomputedTransactionData &GetPrecomputedTransactionData() const;
+
     // Return sum of txouts.
     Amount GetValueOut() const;
     // GetValueIn() is a method on CCoinsViewCache, because
@@ -376,6 +434,142 @@ public:
     }
 };
 
+/**
+ * Computes the id of a transaction from its fields while it is being
+ * deserialized, so the transaction does not have to be walked a second time
+ * by TxSerializeHash() once it has been read.
+ *
+ * Legacy transactions (nVersion < 10) hash the serialized bytes as they are
+ * read. Version 10 transactions instead feed the input, unlock script and
+ * output component hashes as batches of inputs and outputs are read.
+ */
+class CTxIdBuilder {
+public:
+    explicit CTxIdBuilder(int32_t nVersion);
+
+    bool IsLegacy() const { return legacy; }
+
+    /** Serialized bytes following nVersion, legacy transactions only. */
+    void Write(const char *pch, size_t size) {
+        raw.Write((const uint8_t *)pch, size);
+    }
+
+    /** Version 10 transactions only. */
+    void AddInputs(const CTxIn *vin, size_t count);
+    void AddOutputs(const CTxOut *vout, size_t count);
+
+    uint256 Finalize(const CMutableTransaction &tx);
+
+private:
+    bool legacy;
+    CSHA256 raw;
+    CSHA256 inputs;
+    CSHA256 unlockScripts;
+    CSHA256 outputs;
+};
+
+/**
+ * Reads data from an underlying stream while feeding it to a CTxIdBuilder,
+ * in the same spirit as CHashVerifier.
+ */
+template <typename Source> class CTxIdHashingReader {
+private:
+    Source &source;
+    CTxIdBuilder &builder;
+
+public:
+    CTxIdHashingReader(Source &sourceIn, CTxIdBuilder &builderIn)
+        : source(sourceIn), builder(builderIn) {}
+
+    int GetType() const { return source.GetType(); }
+    int GetVersion() const { return source.GetVersion(); }
+
+    void read(char *pch, size_t nSize) {
+        source.read(pch, nSize);
+        builder.Write(pch, nSize);
+    }
+
+    template <typename T> CTxIdHashingReader<Source> &operator>>(T &obj) {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
+/**
+ * Number of consecutive inputs or outputs whose scripts are hashed together
+ * while they are still in cache.
+ */
+static constexpr size_t TXID_HASH_BATCH_SIZE = 64;
+
+/**
+ * Unserialize a vector of inputs or outputs exactly like Unserialize() of a
+ * std::vector does, including its bounded allocation growth, and hand every
+ * batch of freshly read elements to addBatch before the vector can be
+ * reallocated.
+ */
+template <typename Stream, typename T, typename AddBatch>
+void UnserializeTxElements(Stream &s, std::vector<T> &v, AddBatch addBatch) {
+    v.clear();
+    size_t nSize = ReadCompactSize(s);
+    size_t i = 0;
+    size_t nMid = 0;
+    size_t chunkSize = STARTING_CHUNK_SIZE;
+    while (nMid < nSize) {
+        nMid += std::min(nSize, size_t(1 + (chunkSize - 1) / sizeof(T)));
+        chunkSize *= CHUNK_GROWTH_RATE;
+        if (nMid > nSize) {
+            nMid = nSize;
+        }
+        v.resize(nMid);
+        size_t batchStart = i;
+        for (; i < nMid; i++) {
+            Unserialize(s, v[i]);
+            if (i + 1 - batchStart == TXID_HASH_BATCH_SIZE || i + 1 == nMid) {
+                addBatch(&v[batchStart], i + 1 - batchStart);
+                batchStart = i + 1;
+            }
+        }
+    }
+}
+
+/** A freshly deserialized transaction together with its id. */
+struct CDeserializedTransaction {
+    CMutableTransaction tx;
+    uint256 hash;
+};
+
+/**
+ * Deserialize a transaction and compute its id in the same pass.
+ */
+template <typename Stream>
+CDeserializedTransaction UnserializeTransactionWithId(Stream &s) {
+    CDeserializedTransaction result;
+    CMutableTransaction &tx = result.tx;
+    s >> tx.nVersion;
+    tx.vin.clear();
+    tx.vout.clear();
+    CTxIdBuilder builder(tx.nVersion);
+    if (builder.IsLegacy()) {
+        CTxIdHashingReader<Stream> reader(s, builder);
+        reader >> tx.vin;
+        reader >> tx.vout;
+        reader >> tx.nLockTime;
+    } else {
+        UnserializeTxElements(s, tx.vin,
+                              [&builder](const CTxIn *vin, size_t count) {
+                                  builder.AddInputs(vin, count);
+                              });
+        UnserializeTxElements(s, tx.vout,
+                              [&builder](const CTxOut *vout, size_t count) {
+                                  builder.AddOutputs(vout, count);
+                              });
+        s >> tx.nLockTime;
+    }
+    result.hash = builder.Finalize(tx);
+    return result;
+}
+
 using CTransactionRef = std::shared_ptr<const CTransaction>;
 using CWeakTransactionRef = std::weak_ptr<const CTransaction>;
 static inline CTransactionRef MakeTransactionRef() {
@@ -386,15 +580,75 @@ static inline CTransactionRef MakeTransactionRef(Tx &&txIn) {
     return std::make_shared<const CTransaction>(std::forward<Tx>(txIn));
 }
 
+class CHashWriter;
+
+/**
+ * Per input cache of the FORKID signature hash midstate taken after the
+ * constant prefix of the preimage: nVersion, hashPrevouts, hashSequence, the
+ * signed prevout and scriptCode. Contracts using the OP_PUSH_TX pattern run
+ * several checksigs against the same large scriptCode, and with a cached
+ * midstate only the short tail of the preimage is hashed again.
+ *
+ * Only scriptCodes of at least MIN_SCRIPT_CODE_SIZE bytes are cached. The
+ * scriptCode is stored next to its midstate and compared on lookup, which is
+ * much cheaper than hashing it. The cache is safe to use from multiple
+ * threads.
+ */
+class CSigHashMidstateCache {
+public:
+    static constexpr size_t MIN_SCRIPT_CODE_SIZE = 1024;
+
+    /**
+     * The prefix of an input differs depending on whether the sighash type
+     * blanks hashSequence (SINGLE and NONE) or both hashPrevouts and
+     * hashSequence (ANYONECANPAY).
+     */
+    enum class PrefixType : size_t { ALL = 0, NO_SEQUENCE, NO_PREVOUTS };
+    static constexpr size_t NUM_PREFIX_TYPES = 3;
+
+    explicit CSigHashMidstateCache(size_t numberOfInputs);
+
+    /**
+     * Returns the midstate stored for the given input, prefix type and
+     * scriptCode or nullptr if there is none.
+     */
+    std::shared_ptr<const CHashWriter> Get(size_t nIn, PrefixType prefixType,
+                                           const CScript &scriptCode) const;
+
+    /** Stores midstate, replacing a previous one for the same prefix. */
+    void Insert(size_t nIn, PrefixType prefixType, const CScript &scriptCode,
+                const CHashWriter &midstate);
+
+private:
+    struct Entry;
+
+    mutable std::mutex mtx;
+    std::vector<std::array<std::shared_ptr<const Entry>, NUM_PREFIX_TYPES>>
+        entries;
+};
+
 /** Precompute sighash midstate to avoid quadratic hashing */
 struct PrecomputedTransactionData {
     uint256 hashPrevouts, hashSequence, hashOutputs;
 
+    /**
+     * Midstates of large scriptCodes. Shared by copies, which all describe the
+     * same transaction.
+     */
+    std::shared_ptr<CSigHashMidstateCache> scriptCodeMidstates;
+
     PrecomputedTransactionData() = default;
     PrecomputedTransactionData(const PrecomputedTransactionData&) = default;
     PrecomputedTransactionData& operator=(const PrecomputedTransactionData&) = default;
 
+    /**
+     * Take the hashes that tx computes once in its lifetime and add a new
+     * scriptCode midstate cache.
+     */
     PrecomputedTransactionData(const CTransaction &tx);
+
+    /** Compute the hashes of tx, without a scriptCode midstate cache. */
+    static PrecomputedTransactionData ComputeHashes(const CTransaction &tx);
 };
 
 // Test for double-spend notification enabled output on a transaction
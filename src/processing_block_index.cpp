@@ -6,6 +6,7 @@
 #include "processing_block_index.h"
 
 #include "config.h"
+#include "validation.h"
 
 DisconnectResult ProcessingBlockIndex::ApplyBlockUndo(const CBlockUndo &blockUndo,
                                 const CBlock &block,
@@ -74,6 +75,20 @@ DisconnectResult ProcessingBlockIndex::ApplyBlockUndo(const CBlockUndo &blockUnd
     // Move best block pointer to previous block.
     view.SetBestBlock(block.hashPrevBlock);
 
+    // Without a clean disconnect the change of the coins is not known and the
+    // UTXO set hash is dropped once the view is flushed.
+    if (fClean && IsUtxoSetHashEnabled())
+    {
+        UtxoSetHash change;
+        change -=
+            GetBlockUtxoSetHashChange(
+                block,
+                blockUndo,
+                mIndex.GetHeight(),
+                GlobalConfig::GetConfig().GetGenesisActivationHeight());
+        view.AddUtxoSetHashChange(block.GetHash(), block.hashPrevBlock, change);
+    }
+
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
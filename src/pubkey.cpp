@@ -172,16 +172,34 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context *ctx,
     return 1;
 }
 
-bool CPubKey::Verify(const uint256 &hash,
-                     const std::vector<uint8_t> &vchSig) const {
+bool CPubKey::Parse(Parsed &parsed) const {
+    static_assert(sizeof(Parsed) == sizeof(secp256k1_pubkey),
+                  "CPubKey::Parsed must match secp256k1_pubkey");
     if (!IsValid()) return false;
     secp256k1_pubkey pubkey;
-    secp256k1_ecdsa_signature sig;
     if(!secp256k1_ec_pubkey_parse(
            secp256k1_context_verify.get(), &pubkey, &(*this)[0], size()))
     {
         return false;
     }
+    memcpy(parsed.data, pubkey.data, sizeof(parsed.data));
+    return true;
+}
+
+bool CPubKey::Verify(const uint256 &hash,
+                     const std::vector<uint8_t> &vchSig) const {
+    Parsed pubkey;
+    if (!Parse(pubkey)) {
+        return false;
+    }
+    return VerifyParsed(pubkey, hash, vchSig);
+}
+
+bool CPubKey::VerifyParsed(const Parsed &parsed, const uint256 &hash,
+                           const std::vector<uint8_t> &vchSig) {
+    secp256k1_pubkey pubkey;
+    memcpy(pubkey.data, parsed.data, sizeof(pubkey.data));
+    secp256k1_ecdsa_signature sig;
     if (vchSig.size() == 0) {
         return false;
     }
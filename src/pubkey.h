@@ -132,12 +132,34 @@ public:
     //! Check whether this is a compressed public key.
     bool IsCompressed() const { return size() == 33; }
 
+    /**
+     * A public key as parsed by libsecp256k1, which includes decompressing
+     * compressed keys. Same layout as secp256k1_pubkey, which is kept out of
+     * this header.
+     */
+    struct Parsed {
+        uint8_t data[64];
+    };
+
+    /**
+     * Parse this public key for VerifyParsed().
+     * Returns false if this public key is not fully valid.
+     */
+    bool Parse(Parsed &parsed) const;
+
     /**
      * Verify a DER signature (~72 bytes).
      * If this public key is not fully valid, the return value will be false.
      */
     bool Verify(const uint256 &hash, const std::vector<uint8_t> &vchSig) const;
 
+    /**
+     * Verify a DER signature against a public key that was already parsed
+     * with Parse(). Gives the same result as Verify() on that public key.
+     */
+    static bool VerifyParsed(const Parsed &pubkey, const uint256 &hash,
+                             const std::vector<uint8_t> &vchSig);
+
     /**
      * Check whether a signature is normalized (lower-S).
      */
@@ -608,17 +608,14 @@ static bool rest_getutxos(Config &config, HTTPRequest *req,
     else
     {
         CoinsDBView view{ *pcoinsTip };
-        std::size_t idx = 0;
+        auto coins = view.GetCoinsWithScript( vOutPoints );
 
-        for(const auto& out : vOutPoints)
+        for(std::size_t idx = 0; idx < coins.size(); ++idx)
         {
-            if (auto coin = view.GetCoinWithScript( out );
-                coin.has_value() && !coin->IsSpent())
+            if (coins[idx].has_value() && !coins[idx]->IsSpent())
             {
-                handleUnspentCoin( std::move( coin.value() ), idx );
+                handleUnspentCoin( std::move( coins[idx].value() ), idx );
             }
-
-            ++idx;
         }
     }
 
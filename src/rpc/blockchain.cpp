@@ -30,6 +30,7 @@
 #include "txn_validator.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxo_snapshot.h"
 #include "validation.h"
 #include "init.h"
 #include "invalid_txn_publisher.h"
@@ -1626,47 +1627,178 @@ UniValue pruneblockchain(const Config &config, const JSONRPCRequest &request) {
 }
 
 UniValue gettxoutsetinfo(const Config &config, const JSONRPCRequest &request) {
-    if (request.fHelp || request.params.size() != 0) {
+    if (request.fHelp || request.params.size() > 1) {
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"  (string, optional, default=\"hash_serialized\") "
+            "Which UTXO set hash to return:\n"
+            "   \"hash_serialized\"  The hash of the serialized UTXO set. Note "
+            "this call may take some time.\n"
+            "   \"muhash\"           The MuHash3072 of the UTXO set, which is "
+            "updated with every block and returned\n"
+            "                      immediately. If it is not known yet, e.g. "
+            "after upgrading or while\n"
+            "                      -utxosethashthreads=0, it is computed from "
+            "all coins first.\n"
+            "   \"verify\"           Compute the MuHash3072 from all coins and "
+            "compare it with the updated one,\n"
+            "                      which is replaced if it does not match.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, "
+            "only with hash_serialized\n"
             "  \"txouts\": n,            (numeric) The number of output "
             "transactions\n"
             "  \"bogosize\": n,          (numeric) A database-independent "
             "metric for UTXO set size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, "
+            "only with hash_serialized\n"
+            "  \"muhash\": \"hash\",   (string) The MuHash3072 of the UTXO "
+            "set, with muhash and verify\n"
+            "  \"verified\": true|false,   (boolean) Whether the updated hash "
+            "matched the computed one,\n"
+            "                          only with verify and if the updated hash "
+            "was known\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the "
             "chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") +
+            HelpExampleCli("gettxoutsetinfo", "\"muhash\"") +
             HelpExampleRpc("gettxoutsetinfo", ""));
     }
 
+    const std::string hashType =
+        request.params[0].isNull() ? "hash_serialized"
+                                   : request.params[0].get_str();
+
     UniValue ret(UniValue::VOBJ);
 
-    CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(*pcoinsTip, stats)) {
-        ret.push_back(Pair("height", int64_t(stats.nHeight)));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", int64_t(stats.nTransactions)));
-        ret.push_back(Pair("txouts", int64_t(stats.nTransactionOutputs)));
-        ret.push_back(Pair("bogosize", int64_t(stats.nBogoSize)));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("disk_size", stats.nDiskSize));
-        ret.push_back(
-            Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    if (hashType == "hash_serialized") {
+        CCoinsStats stats;
+        FlushStateToDisk();
+        if (GetUTXOStats(*pcoinsTip, stats)) {
+            ret.push_back(Pair("height", int64_t(stats.nHeight)));
+            ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+            ret.push_back(Pair("transactions", int64_t(stats.nTransactions)));
+            ret.push_back(Pair("txouts", int64_t(stats.nTransactionOutputs)));
+            ret.push_back(Pair("bogosize", int64_t(stats.nBogoSize)));
+            ret.push_back(
+                Pair("hash_serialized", stats.hashSerialized.GetHex()));
+            ret.push_back(Pair("disk_size", stats.nDiskSize));
+            ret.push_back(
+                Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        } else {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        return ret;
+    }
+
+    if (hashType != "muhash" && hashType != "verify") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Unknown hash_type " + hashType);
     }
+
+    auto utxoSetHash = pcoinsTip->GetUtxoSetHash();
+    std::optional<bool> verified;
+    if (hashType == "verify" || !utxoSetHash.has_value()) {
+        auto scanned = ScanUtxoSetHash(GetShutdownToken());
+        if (!scanned.has_value()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+
+        if (hashType == "verify") {
+            utxoSetHash = pcoinsTip->GetUtxoSetHash();
+            if (utxoSetHash.has_value()) {
+                if (utxoSetHash->first != scanned->first) {
+                    throw JSONRPCError(RPC_MISC_ERROR,
+                                       "Best block changed while computing "
+                                       "the UTXO set hash, try again");
+                }
+                verified = utxoSetHash->second.GetHash() ==
+                           scanned->second.GetHash();
+            }
+        }
+        if (!verified.value_or(false)) {
+            pcoinsTip->SetUtxoSetHash(scanned->first, scanned->second);
+        }
+        utxoSetHash = std::move(scanned);
+    }
+
+    const uint256 &bestBlock = utxoSetHash->first;
+    const UtxoSetHash &hash = utxoSetHash->second;
+    const CBlockIndex *pindex = mapBlockIndex.Get(bestBlock);
+    ret.push_back(Pair("height", int64_t(pindex ? pindex->GetHeight() : -1)));
+    ret.push_back(Pair("bestblock", bestBlock.GetHex()));
+    ret.push_back(Pair("txouts", hash.GetTxOutCount()));
+    ret.push_back(Pair("bogosize", hash.GetBogoSize()));
+    ret.push_back(Pair("muhash", hash.GetHash().GetHex()));
+    if (verified.has_value()) {
+        ret.push_back(Pair("verified", verified.value()));
+    }
+    ret.push_back(Pair("disk_size", uint64_t(pcoinsTip->EstimateSize())));
+    ret.push_back(Pair("total_amount", ValueFromAmount(hash.GetTotalAmount())));
+    return ret;
+}
+
+UniValue dumputxoset(const Config &config, const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumputxoset \"path\"\n"
+            "\nWrites the UTXO set at the current best block to a snapshot "
+            "file that another\n"
+            "node with the same blocks can load with -loadutxosnapshot.\n"
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) The file to write, relative "
+            "paths are relative\n"
+            "              to the data directory. It must not exist yet.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,      (numeric) The number of coins "
+            "written\n"
+            "  \"base_hash\": \"hex\",    (string) The block at which the "
+            "snapshot was taken\n"
+            "  \"base_height\": n,        (numeric) The height of that "
+            "block\n"
+            "  \"path\": \"path\",        (string) The absolute path of "
+            "the snapshot\n"
+            "  \"muhash\": \"hash\",      (string) The UTXO set hash of "
+            "the snapshot, to be given\n"
+            "                           as -utxosnapshothash when loading "
+            "it\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumputxoset", "\"utxo.dat\"") +
+            HelpExampleRpc("dumputxoset", "\"utxo.dat\""));
+    }
+
+    const fs::path path =
+        fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           path.string() + " already exists");
+    }
+
+    std::optional<UtxoSnapshotInfo> info =
+        DumpUtxoSnapshot(config, path, GetShutdownToken());
+    if (!info.has_value()) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "Unable to write UTXO snapshot, see the log");
+    }
+
+    const CBlockIndex *pindex = mapBlockIndex.Get(info->block);
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", info->utxoSetHash.GetTxOutCount()));
+    ret.push_back(Pair("base_hash", info->block.GetHex()));
+    ret.push_back(
+        Pair("base_height", int64_t(pindex ? pindex->GetHeight() : -1)));
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("muhash", info->utxoSetHash.GetHash().GetHex()));
     return ret;
 }
 
@@ -2696,18 +2828,22 @@ UniValue getblockstats_impl(const Config &config,
                                    "-txindex enabled");
             }
 
-            Amount tx_total_in = Amount();
+            std::vector<TxId> txids_in;
+            txids_in.reserve(tx->vin.size());
             for (const CTxIn &in : tx->vin) {
-                CTransactionRef tx_in;
-                uint256 hashBlock;
-                bool isGenesisEnabled;
-                if (!GetTransaction(config, in.prevout.GetTxId(), tx_in, true, hashBlock, isGenesisEnabled)) {
-                    throw JSONRPCError(RPC_INTERNAL_ERROR,
-                                       std::string("Unexpected internal error "
-                                                   "(tx index seems corrupt)"));
-                }
+                txids_in.push_back(in.prevout.GetTxId());
+            }
+            std::vector<CTransactionRef> txs_in;
+            if (!GetTransactions(config, txids_in, txs_in)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR,
+                                   std::string("Unexpected internal error "
+                                               "(tx index seems corrupt)"));
+            }
 
-                CTxOut prevoutput = tx_in->vout[in.prevout.GetN()];
+            Amount tx_total_in = Amount();
+            for (size_t i = 0; i < tx->vin.size(); ++i) {
+                const CTxIn &in = tx->vin[i];
+                CTxOut prevoutput = txs_in[i]->vout[in.prevout.GetN()];
 
                 tx_total_in += prevoutput.nValue;
                 utxo_size_inc -= GetSerializeSize(prevoutput, SER_NETWORK,
@@ -3002,7 +3138,8 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "getrawmempool",          getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "getrawnonfinalmempool",  getrawnonfinalmempool,  true,  {} },
     { "blockchain",         "gettxout",               gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {"hash_type"} },
+    { "blockchain",         "dumputxoset",            dumputxoset,            true,  {"path"} },
     { "blockchain",         "pruneblockchain",        pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            verifychain,            true,  {"checklevel","nblocks"} },
     { "blockchain",         "preciousblock",          preciousblock,          true,  {"blockhash"} },
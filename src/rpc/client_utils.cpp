@@ -125,6 +125,8 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"verifyscript", 0, "scripts"},
     {"verifyscript", 1, "stopOnFirstInvalid"},
     {"verifyscript", 2, "totalTimeout"},
+    {"getscriptprofile", 0, "count"},
+    {"getscriptprofile", 1, "reset"},
     // Echo with conversion (For testing only)
     {"echojson", 0, "arg0"},
     {"echojson", 1, "arg1"},
@@ -9,6 +9,7 @@
 #include "block_index_store.h"
 #include "clientversion.h"
 #include "config.h"
+#include "dbcompaction.h"
 #include "dstencode.h"
 #include "init.h"
 #include "net/net.h"
@@ -16,6 +17,10 @@
 #include "policy/policy.h"
 #include "rpc/blockchain.h"
 #include "rpc/server.h"
+#include "script/compiled_script.h"
+#include "script/script_profiler.h"
+#include "script/scriptcache.h"
+#include "script/sigcache.h"
 #include "timedata.h"
 #include "txdb.h"
 #include "util.h"
@@ -30,6 +35,7 @@
 
 #include "vmtouch.h"
 #include <univalue.h>
+#include <algorithm>
 #include <cstdint>
 
 /**
@@ -1069,6 +1075,419 @@ static UniValue getmemoryinfo(const Config &config,
     return obj;
 }
 
+static UniValue ShardedCacheInfo(const std::vector<CacheShardStats> &stats) {
+    uint64_t capacity = 0, hits = 0, misses = 0, inserts = 0;
+    UniValue shards(UniValue::VARR);
+    for (const CacheShardStats &shard : stats) {
+        capacity += shard.capacity;
+        hits += shard.hits;
+        misses += shard.misses;
+        inserts += shard.inserts;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("maxentries", uint64_t(shard.capacity)));
+        obj.push_back(Pair("hits", shard.hits));
+        obj.push_back(Pair("misses", shard.misses));
+        obj.push_back(Pair("inserts", shard.inserts));
+        shards.push_back(obj);
+    }
+    const uint64_t lookups = hits + misses;
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("maxentries", capacity));
+    obj.push_back(Pair("hits", hits));
+    obj.push_back(Pair("misses", misses));
+    obj.push_back(Pair("inserts", inserts));
+    obj.push_back(Pair("hitrate", lookups ? double(hits) / lookups : 0.0));
+    obj.push_back(Pair("shards", shards));
+    return obj;
+}
+
+static UniValue CoinsCacheInfo(const CoinsDB &coinsDB) {
+    uint64_t coins = 0, compactScripts = 0, locks = 0, contended = 0,
+             waitMicros = 0;
+    UniValue stripes(UniValue::VARR);
+    for (const CoinsCacheStripeStats &stripe : coinsDB.GetCacheStripeStats()) {
+        coins += stripe.coins;
+        compactScripts += stripe.compactScripts;
+        locks += stripe.locks;
+        contended += stripe.contended;
+        waitMicros += stripe.waitMicros;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("coins", uint64_t(stripe.coins)));
+        obj.push_back(
+            Pair("compactscripts", uint64_t(stripe.compactScripts)));
+        obj.push_back(Pair("locks", stripe.locks));
+        obj.push_back(Pair("contended", stripe.contended));
+        obj.push_back(Pair("waittime", stripe.waitMicros / 1000.0));
+        stripes.push_back(obj);
+    }
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("coins", coins));
+    obj.push_back(Pair("compactscripts", compactScripts));
+    obj.push_back(
+        Pair("scriptbodies", uint64_t(coinsDB.GetScriptBodyCount())));
+    obj.push_back(Pair("usage", uint64_t(coinsDB.DynamicMemoryUsage())));
+    obj.push_back(Pair("locks", locks));
+    obj.push_back(Pair("contended", contended));
+    obj.push_back(Pair("contendedrate", locks ? double(contended) / locks : 0.0));
+    obj.push_back(Pair("waittime", waitMicros / 1000.0));
+    obj.push_back(Pair("stripes", stripes));
+    return obj;
+}
+
+static UniValue getcacheinfo(const Config &config,
+                             const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getcacheinfo\n"
+            "Returns an object containing usage statistics of the script "
+            "validation caches and the coins cache.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"pubkeycache\": {        (json object) Cache of parsed public "
+            "keys\n"
+            "    \"entries\": xxxxx,     (numeric) Number of cached keys\n"
+            "    \"maxentries\": xxxxx,  (numeric) Maximum number of cached "
+            "keys\n"
+            "    \"hits\": xxxxx,        (numeric) Number of lookups that found "
+            "the key\n"
+            "    \"misses\": xxxxx,      (numeric) Number of lookups that had "
+            "to parse the key\n"
+            "    \"hitrate\": x.xxx      (numeric) hits / (hits + misses)\n"
+            "  },\n"
+            "  \"scriptprogramcache\": { (json object) Cache of decoded "
+            "output scripts\n"
+            "    \"entries\": xxxxx,     (numeric) Number of cached scripts\n"
+            "    \"usage\": xxxxx,       (numeric) Memory used in bytes\n"
+            "    \"maxusage\": xxxxx,    (numeric) Memory limit in bytes\n"
+            "    \"hits\": xxxxx,        (numeric) Number of lookups that found "
+            "the script\n"
+            "    \"misses\": xxxxx,      (numeric) Number of lookups that had "
+            "to decode the script\n"
+            "    \"hitrate\": x.xxx      (numeric) hits / (hits + misses)\n"
+            "  },\n"
+            "  \"signaturecache\": {     (json object) Cache of valid "
+            "signatures\n"
+            "    \"maxentries\": xxxxx,  (numeric) Maximum number of cached "
+            "signatures\n"
+            "    \"hits\": xxxxx,        (numeric) Number of lookups that found "
+            "the signature\n"
+            "    \"misses\": xxxxx,      (numeric) Number of lookups that did "
+            "not find the signature\n"
+            "    \"inserts\": xxxxx,     (numeric) Number of added signatures\n"
+            "    \"hitrate\": x.xxx,     (numeric) hits / (hits + misses)\n"
+            "    \"shards\": [           (json array) The same counters for "
+            "each independently locked part of the cache\n"
+            "      {\n"
+            "        \"maxentries\": xxxxx,\n"
+            "        \"hits\": xxxxx,\n"
+            "        \"misses\": xxxxx,\n"
+            "        \"inserts\": xxxxx\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  },\n"
+            "  \"invalidsignaturecache\": { (json object) Cache of invalid "
+            "signatures, as signaturecache\n"
+            "  },\n"
+            "  \"scriptcache\": {        (json object) Cache of transactions "
+            "whose scripts were verified, as signaturecache\n"
+            "  },\n"
+            "  \"coinscache\": {         (json object) Cache of the coins "
+            "database\n"
+            "    \"coins\": xxxxx,       (numeric) Number of cached coins\n"
+            "    \"compactscripts\": xxxxx, (numeric) Number of those whose "
+            "script shares its body with other scripts\n"
+            "    \"scriptbodies\": xxxxx, (numeric) Number of shared script "
+            "bodies\n"
+            "    \"usage\": xxxxx,       (numeric) Memory used in bytes\n"
+            "    \"locks\": xxxxx,       (numeric) Number of times a lock of "
+            "the cache was taken\n"
+            "    \"contended\": xxxxx,   (numeric) Number of those that had "
+            "to wait for another thread\n"
+            "    \"contendedrate\": x.xxx, (numeric) contended / locks\n"
+            "    \"waittime\": x.xxx,    (numeric) Time spent waiting for the "
+            "locks in milliseconds\n"
+            "    \"stripes\": [          (json array) The same counters for "
+            "each independently locked part of the cache\n"
+            "      {\n"
+            "        \"coins\": xxxxx,\n"
+            "        \"compactscripts\": xxxxx,\n"
+            "        \"locks\": xxxxx,\n"
+            "        \"contended\": xxxxx,\n"
+            "        \"waittime\": x.xxx\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getcacheinfo", "") +
+            HelpExampleRpc("getcacheinfo", ""));
+    }
+
+    const PubKeyCacheStats pubKeyStats = GetPubKeyCacheStats();
+    const uint64_t pubKeyLookups = pubKeyStats.hits + pubKeyStats.misses;
+    UniValue pubKeyCache(UniValue::VOBJ);
+    pubKeyCache.push_back(Pair("entries", uint64_t(pubKeyStats.entries)));
+    pubKeyCache.push_back(Pair("maxentries", uint64_t(pubKeyStats.maxEntries)));
+    pubKeyCache.push_back(Pair("hits", pubKeyStats.hits));
+    pubKeyCache.push_back(Pair("misses", pubKeyStats.misses));
+    pubKeyCache.push_back(Pair("hitrate", pubKeyLookups ? double(pubKeyStats.hits) / pubKeyLookups : 0.0));
+
+    const ScriptProgramCacheStats programStats = GetScriptProgramCacheStats();
+    const uint64_t programLookups = programStats.hits + programStats.misses;
+    UniValue programCache(UniValue::VOBJ);
+    programCache.push_back(Pair("entries", uint64_t(programStats.entries)));
+    programCache.push_back(Pair("usage", uint64_t(programStats.usage)));
+    programCache.push_back(Pair("maxusage", uint64_t(programStats.maxUsage)));
+    programCache.push_back(Pair("hits", programStats.hits));
+    programCache.push_back(Pair("misses", programStats.misses));
+    programCache.push_back(Pair("hitrate", programLookups ? double(programStats.hits) / programLookups : 0.0));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("pubkeycache", pubKeyCache));
+    obj.push_back(Pair("scriptprogramcache", programCache));
+    obj.push_back(Pair("signaturecache",
+                       ShardedCacheInfo(GetSignatureCacheStats())));
+    obj.push_back(Pair("invalidsignaturecache",
+                       ShardedCacheInfo(GetInvalidSignatureCacheStats())));
+    obj.push_back(Pair("scriptcache", ShardedCacheInfo(GetScriptCacheStats())));
+
+    LOCK(cs_main);
+    if (pcoinsTip) {
+        obj.push_back(Pair("coinscache", CoinsCacheInfo(*pcoinsTip)));
+    }
+    return obj;
+}
+
+static UniValue DBInfo(const CDBWrapperStats &stats) {
+    UniValue levels(UniValue::VARR);
+    for (size_t level = 0; level < stats.levels.size(); ++level) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("level", uint64_t(level)));
+        obj.push_back(Pair("files", uint64_t(stats.levels[level].first)));
+        obj.push_back(Pair("size", stats.levels[level].second));
+        levels.push_back(obj);
+    }
+    UniValue latency(UniValue::VARR);
+    for (size_t i = 0; i < stats.writeLatencyCounts.size(); ++i) {
+        if (stats.writeLatencyCounts[i]) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("below", (uint64_t(1) << i) / 1000.0));
+            obj.push_back(Pair("count", stats.writeLatencyCounts[i]));
+            latency.push_back(obj);
+        }
+    }
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("levels", levels));
+    obj.push_back(Pair("pendingcompaction", stats.pendingCompactionBytes));
+    obj.push_back(Pair("writes", stats.writes));
+    obj.push_back(Pair("writetime", stats.writeMicros / 1000.0));
+    obj.push_back(Pair("maxwritetime", stats.maxWriteMicros / 1000.0));
+    obj.push_back(Pair("stalledwrites", stats.stalledWrites));
+    obj.push_back(Pair("stalledwritetime", stats.stalledWriteMicros / 1000.0));
+    obj.push_back(Pair("writelatency", latency));
+    return obj;
+}
+
+static UniValue getdbinfo(const Config &config,
+                          const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getdbinfo\n"
+            "Returns an object containing the state of the LevelDB "
+            "databases of the chainstate and the block index, the latency "
+            "of the writes to them and the progress of -dbcompactidle.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"chainstate\": {         (json object) The coins database\n"
+            "    \"levels\": [           (json array) The table files of "
+            "each level\n"
+            "      {\n"
+            "        \"level\": n,       (numeric) The level\n"
+            "        \"files\": xxxxx,   (numeric) Number of files\n"
+            "        \"size\": xxxxx     (numeric) Their size in bytes\n"
+            "      }, ...\n"
+            "    ],\n"
+            "    \"pendingcompaction\": xxxxx, (numeric) Estimated number of "
+            "bytes LevelDB has to compact to bring all levels within their "
+            "limits\n"
+            "    \"writes\": xxxxx,      (numeric) Number of batches written "
+            "since startup\n"
+            "    \"writetime\": x.xxx,   (numeric) Time spent writing them in "
+            "milliseconds\n"
+            "    \"maxwritetime\": x.xxx, (numeric) Longest time a batch took "
+            "in milliseconds\n"
+            "    \"stalledwrites\": xxxxx, (numeric) Number of batches written "
+            "while level 0 had so many files that LevelDB delays or stops "
+            "writes\n"
+            "    \"stalledwritetime\": x.xxx, (numeric) Time spent writing "
+            "those in milliseconds\n"
+            "    \"writelatency\": [     (json array) Histogram of the write "
+            "times, empty buckets are left out\n"
+            "      {\n"
+            "        \"below\": x.xxx,   (numeric) The batches took less than "
+            "this many milliseconds and at least half of it, the last bucket "
+            "also counts slower ones\n"
+            "        \"count\": xxxxx    (numeric) Number of batches\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  },\n"
+            "  \"blockindex\": {         (json object) The block index "
+            "database, as chainstate\n"
+            "  },\n"
+            "  \"compaction\": [         (json array) The key ranges compacted "
+            "while the databases are idle, if -dbcompactidle is not 0\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",     (string) The key range\n"
+            "      \"slices\": xxxxx,    (numeric) Number of slices compacted\n"
+            "      \"time\": x.xxx,      (numeric) Time spent compacting them "
+            "in milliseconds\n"
+            "      \"passes\": xxxxx,    (numeric) Number of times all slices "
+            "were compacted\n"
+            "      \"nextslice\": n      (numeric) The slice compacted next, "
+            "out of " + std::to_string(DB_COMPACT_SLICES) + "\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getdbinfo", "") +
+            HelpExampleRpc("getdbinfo", ""));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        if (pcoinsTip) {
+            obj.push_back(Pair("chainstate", DBInfo(pcoinsTip->GetDBStats())));
+        }
+        if (pblocktree) {
+            obj.push_back(Pair("blockindex", DBInfo(pblocktree->GetStats())));
+        }
+    }
+
+    if (g_dbCompactionController) {
+        UniValue ranges(UniValue::VARR);
+        for (const DBCompactionRangeStats &stats :
+             g_dbCompactionController->GetStats()) {
+            UniValue range(UniValue::VOBJ);
+            range.push_back(Pair("name", stats.name));
+            range.push_back(Pair("slices", stats.slices));
+            range.push_back(Pair("time", stats.micros / 1000.0));
+            range.push_back(Pair("passes", stats.passes));
+            range.push_back(Pair("nextslice", uint64_t(stats.nextSlice)));
+            ranges.push_back(range);
+        }
+        obj.push_back(Pair("compaction", ranges));
+    }
+    return obj;
+}
+
+static UniValue getscriptprofile(const Config &config,
+                                 const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() > 2) {
+        throw std::runtime_error(
+            "getscriptprofile ( count reset )\n"
+            "Returns the execution statistics collected by -scriptprofiler "
+            "for the output script templates whose spending took the most "
+            "time. The template of a script is its sequence of opcodes and "
+            "push sizes, so outputs of the same contract share one.\n"
+            "\nArguments:\n"
+            "1. count    (numeric, optional, default=10) Number of templates "
+            "to return\n"
+            "2. reset    (boolean, optional, default=false) Clear the "
+            "statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,    (boolean) Whether statistics are "
+            "being collected\n"
+            "  \"templates\": [\n"
+            "    {\n"
+            "      \"template\": \"hash\",     (string) Template hash, all "
+            "zero for templates over the tracking limit\n"
+            "      \"example\": \"hex\",       (string) First output script "
+            "seen with the template\n"
+            "      \"verifications\": n,     (numeric) Number of inputs "
+            "verified\n"
+            "      \"time\": x.xxx,          (numeric) Time spent verifying "
+            "them in milliseconds\n"
+            "      \"opcodes\": [            (json array) Executed opcodes, "
+            "most expensive first\n"
+            "        {\n"
+            "          \"opcode\": \"name\",   (string) Opcode, or number of "
+            "bytes for direct pushes\n"
+            "          \"count\": n,         (numeric) Times executed\n"
+            "          \"bytes\": n,         (numeric) Push data or top stack "
+            "element bytes processed\n"
+            "          \"time\": x.xxx       (numeric) Time in milliseconds\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getscriptprofile", "") +
+            HelpExampleCli("getscriptprofile", "5 true") +
+            HelpExampleRpc("getscriptprofile", "5, true"));
+    }
+
+    size_t count = 10;
+    if (!request.params[0].isNull()) {
+        const int64_t n = request.params[0].get_int64();
+        if (n < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+        }
+        count = static_cast<size_t>(n);
+    }
+    const bool reset = !request.params[1].isNull() && request.params[1].get_bool();
+
+    std::vector<ScriptTemplateProfile> profiles = GetScriptProfiles();
+    if (reset) {
+        ResetScriptProfiles();
+    }
+
+    UniValue templates(UniValue::VARR);
+    for (size_t i = 0; i < profiles.size() && i < count; ++i) {
+        const ScriptTemplateProfile &profile = profiles[i];
+
+        std::vector<size_t> order;
+        for (size_t op = 0; op < profile.opcodes.size(); ++op) {
+            if (profile.opcodes[op].count) {
+                order.push_back(op);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&profile](size_t a, size_t b) {
+            return profile.opcodes[a].nanoseconds > profile.opcodes[b].nanoseconds;
+        });
+
+        UniValue opcodes(UniValue::VARR);
+        for (const size_t op : order) {
+            const OpcodeProfile &stats = profile.opcodes[op];
+            UniValue entry(UniValue::VOBJ);
+            if (op > OP_0 && op < OP_PUSHDATA1) {
+                entry.push_back(Pair("opcode", strprintf("PUSH%u", op)));
+            } else {
+                entry.push_back(Pair("opcode", GetOpName(static_cast<opcodetype>(op))));
+            }
+            entry.push_back(Pair("count", stats.count));
+            entry.push_back(Pair("bytes", stats.bytes));
+            entry.push_back(Pair("time", stats.nanoseconds / 1e6));
+            opcodes.push_back(entry);
+        }
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("template", profile.templateHash.GetHex()));
+        obj.push_back(Pair("example", HexStr(profile.example.begin(), profile.example.end())));
+        obj.push_back(Pair("verifications", profile.verifications));
+        obj.push_back(Pair("time", profile.nanoseconds / 1e6));
+        obj.push_back(Pair("opcodes", opcodes));
+        templates.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("enabled", IsScriptProfilerEnabled()));
+    result.push_back(Pair("templates", templates));
+    return result;
+}
+
 static UniValue echo(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp) {
         throw std::runtime_error(
@@ -1165,6 +1584,9 @@ static const CRPCCommand commands[] = {
     //  ------------------- ------------------------  ----------------------  ----------
     { "control",            "getinfo",                getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          getmemoryinfo,          true,  {} },
+    { "control",            "getcacheinfo",           getcacheinfo,           true,  {} },
+    { "control",            "getdbinfo",              getdbinfo,              true,  {} },
+    { "control",            "getscriptprofile",       getscriptprofile,       true,  {"count","reset"} },
     { "control",            "activezmqnotifications", activezmqnotifications, true,  {} },
     { "util",               "validateaddress",        validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         createmultisig,         true,  {"nrequired","keys"} },
@@ -0,0 +1,92 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/compact_script.h"
+
+#include "hash.h"
+#include "memusage.h"
+
+CScript CompactScript::Expand() const {
+    CScript script;
+    script.reserve(GetScriptSize());
+    script.insert(script.end(), mBody->begin(), mBody->end());
+    script.insert(script.end(), mData.begin(), mData.end());
+    return script;
+}
+
+size_t CompactScript::DynamicMemoryUsage() const {
+    return memusage::DynamicUsage(mData);
+}
+
+std::optional<CompactScript> ScriptBodyPool::Compact(const CScript &script) {
+    if (script.size() < MIN_BODY_SIZE) {
+        return {};
+    }
+
+    // Find the end of the last OP_RETURN. A push that runs past the end of
+    // the script ends the search, the rest is treated as data.
+    CScript::const_iterator bodyEnd = script.end();
+    CScript::const_iterator pc = script.begin();
+    opcodetype opcode;
+    while (pc < script.end()) {
+        if (!script.GetOp(pc, opcode)) {
+            break;
+        }
+        if (opcode == OP_RETURN) {
+            bodyEnd = pc;
+        }
+    }
+    if (size_t(bodyEnd - script.begin()) < MIN_BODY_SIZE) {
+        return {};
+    }
+
+    const uint256 hash = Hash(script.begin(), bodyEnd);
+    std::shared_ptr<const CScript> body;
+    {
+        std::lock_guard lock{mMtx};
+        auto it = mBodies.find(hash);
+        if (it == mBodies.end()) {
+            if (mSeenBodies.erase(hash) == 0) {
+                if (mSeenBodies.size() >= MAX_SEEN_BODIES) {
+                    mSeenBodies.clear();
+                }
+                mSeenBodies.insert(hash);
+                UpdateUsage();
+                return {};
+            }
+            auto newBody = std::make_shared<const CScript>(script.begin(),
+                                                           bodyEnd);
+            mBodiesUsage += memusage::DynamicUsage(newBody) +
+                            memusage::DynamicUsage(*newBody);
+            it = mBodies.emplace(hash, std::move(newBody)).first;
+            UpdateUsage();
+        }
+        body = it->second;
+    }
+    return CompactScript{std::move(body), CScript(bodyEnd, script.end())};
+}
+
+void ScriptBodyPool::Prune() {
+    std::lock_guard lock{mMtx};
+    for (auto it = mBodies.begin(); it != mBodies.end();) {
+        if (it->second.use_count() == 1) {
+            mBodiesUsage -= memusage::DynamicUsage(it->second) +
+                            memusage::DynamicUsage(*it->second);
+            it = mBodies.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    UpdateUsage();
+}
+
+size_t ScriptBodyPool::Size() const {
+    std::lock_guard lock{mMtx};
+    return mBodies.size();
+}
+
+void ScriptBodyPool::UpdateUsage() {
+    mUsage.store(memusage::DynamicUsage(mBodies) +
+                 memusage::DynamicUsage(mSeenBodies) + mBodiesUsage);
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_SCRIPT_COMPACT_SCRIPT_H
+#define MVC_SCRIPT_COMPACT_SCRIPT_H
+
+#include "block_hasher.h"
+#include "script/script.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * A script stored as a body that is shared with other scripts and the data
+ * that follows it.
+ *
+ * Outputs of the same contract carry the same code and differ only in a small
+ * data area after the last OP_RETURN, so the body is kept once in a
+ * ScriptBodyPool and each coin keeps only its data.
+ */
+class CompactScript {
+public:
+    CompactScript(std::shared_ptr<const CScript> body, CScript data)
+        : mBody{std::move(body)}, mData{std::move(data)} {}
+
+    //! The full script, the body followed by the data.
+    CScript Expand() const;
+
+    size_t GetScriptSize() const { return mBody->size() + mData.size(); }
+
+    //! Memory used by this script besides the shared body.
+    size_t DynamicMemoryUsage() const;
+
+private:
+    std::shared_ptr<const CScript> mBody;
+    CScript mData;
+};
+
+/**
+ * Interns the bodies of large scripts so that the scripts that share a body
+ * keep one copy of it.
+ *
+ * A body is only added to the pool once a second script with it is seen, as
+ * a compact script costs more memory than the plain script if its body is
+ * not shared. Until then only the hash of the body is remembered.
+ *
+ * Thread safe. A body stays in the pool until Prune() is called after the
+ * last CompactScript that refers to it was destroyed.
+ */
+class ScriptBodyPool {
+public:
+    //! Scripts whose body is smaller are not worth sharing.
+    static constexpr size_t MIN_BODY_SIZE = 256;
+    //! Number of hashes of bodies seen once that are remembered at most.
+    static constexpr size_t MAX_SEEN_BODIES = 65536;
+
+    /**
+     * Split script into the body up to and including its last OP_RETURN, or
+     * the whole script if it has none, and the data after it. The body is
+     * added to the pool if it is not in there yet but was seen before.
+     *
+     * Returns nothing if the body is smaller than MIN_BODY_SIZE or was not
+     * seen before, the script is then best kept as it is.
+     */
+    std::optional<CompactScript> Compact(const CScript &script);
+
+    //! Drop the bodies that no CompactScript refers to anymore.
+    void Prune();
+
+    //! Number of bodies in the pool.
+    size_t Size() const;
+
+    //! Memory used by the bodies and the pool.
+    size_t DynamicMemoryUsage() const { return mUsage.load(); }
+
+private:
+    void UpdateUsage();
+
+    mutable std::mutex mMtx;
+    //! Bodies by their hash.
+    std::unordered_map<uint256, std::shared_ptr<const CScript>, BlockHasher>
+        mBodies;
+    //! Hashes of the bodies seen once that are not in mBodies. Cleared when
+    //! it reaches MAX_SEEN_BODIES.
+    std::unordered_set<uint256, BlockHasher> mSeenBodies;
+    //! Memory used by the bodies themselves, guarded by mMtx.
+    size_t mBodiesUsage{0};
+    std::atomic<size_t> mUsage{0};
+};
+
+#endif // MVC_SCRIPT_COMPACT_SCRIPT_H
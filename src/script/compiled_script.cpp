@@ -0,0 +1,254 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/compiled_script.h"
+#include "hash.h"
+#include "memusage.h"
+
+#include <atomic>
+#include <iterator>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+/** Size of the opcode and length prefix in front of push data. */
+uint32_t PushHeaderSize(opcodetype opcode) {
+    switch (opcode) {
+        case OP_PUSHDATA1:
+            return 2;
+        case OP_PUSHDATA2:
+            return 3;
+        case OP_PUSHDATA4:
+            return 5;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Whether stepping through this instruction while its branch is not executed
+ * can fail before genesis. This mirrors the checks that EvalScript() performs
+ * on every instruction regardless of whether it is executed.
+ */
+bool IsBranchHazardBeforeGenesis(const CCompiledScript::Instruction &ins) {
+    return ins.operandSize > MAX_SCRIPT_ELEMENT_SIZE_BEFORE_GENESIS ||
+           ins.opcode == OP_2MUL || ins.opcode == OP_2DIV ||
+           ins.opcode == OP_VERIF || ins.opcode == OP_VERNOTIF;
+}
+
+} // namespace
+
+CCompiledScript::CCompiledScript(const CScript &scriptIn) : script(scriptIn) {
+    struct OpenIf {
+        //! Index of the OP_IF, OP_NOTIF or OP_ELSE waiting for its jump.
+        size_t pending;
+        size_t numElses;
+    };
+    std::vector<OpenIf> openIfs;
+    // Instructions that make a skipped branch unsafe after genesis: a second
+    // OP_ELSE in a nested conditional.
+    std::vector<bool> hazardAfterGenesis;
+
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        const uint32_t begin = pc - script.begin();
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode)) {
+            instructions.push_back(
+                {OP_INVALIDOPCODE, DECODE_ERROR, begin, 0, begin, NO_JUMP, 0});
+            hazardAfterGenesis.push_back(false);
+            break;
+        }
+        const uint32_t end = pc - script.begin();
+
+        Instruction ins{opcode, 0, end, 0, end, NO_JUMP, 0};
+        if (opcode <= OP_PUSHDATA4) {
+            ins.operandOffset = begin + PushHeaderSize(opcode);
+            ins.operandSize = end - ins.operandOffset;
+        }
+
+        bool hazard = false;
+        const size_t index = instructions.size();
+        if (opcode == OP_IF || opcode == OP_NOTIF) {
+            openIfs.push_back({index, 0});
+        } else if (opcode == OP_ELSE && !openIfs.empty()) {
+            OpenIf &open = openIfs.back();
+            instructions[open.pending].jump = index;
+            open.pending = index;
+            hazard = ++open.numElses > 1;
+        } else if (opcode == OP_ENDIF && !openIfs.empty()) {
+            instructions[openIfs.back().pending].jump = index;
+            openIfs.pop_back();
+        }
+
+        instructions.push_back(ins);
+        hazardAfterGenesis.push_back(hazard);
+    }
+
+    // Prefix sums over the instructions, so the cost and safety of skipping
+    // any branch can be looked up in constant time.
+    const size_t n = instructions.size();
+    std::vector<uint32_t> opCount(n + 1, 0);
+    std::vector<uint32_t> hazardsBefore(n + 1, 0);
+    std::vector<uint32_t> hazardsAfter(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const Instruction &ins = instructions[i];
+        opCount[i + 1] = opCount[i] + (ins.opcode > OP_16 ? 1 : 0);
+        hazardsBefore[i + 1] =
+            hazardsBefore[i] + (IsBranchHazardBeforeGenesis(ins) ? 1 : 0);
+        hazardsAfter[i + 1] = hazardsAfter[i] + (hazardAfterGenesis[i] ? 1 : 0);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        Instruction &ins = instructions[i];
+        if (ins.jump == NO_JUMP) {
+            continue;
+        }
+        // The branch consists of the instructions strictly between this one
+        // and the one it jumps to.
+        const size_t first = i + 1;
+        const size_t last = ins.jump;
+        ins.skipOpCount = opCount[last] - opCount[first];
+        if (hazardsBefore[last] == hazardsBefore[first]) {
+            ins.flags |= SKIP_BEFORE_GENESIS;
+        }
+        if (hazardsAfter[last] == hazardsAfter[first]) {
+            ins.flags |= SKIP_AFTER_GENESIS;
+        }
+    }
+}
+
+size_t CCompiledScript::DynamicMemoryUsage() const {
+    return memusage::DynamicUsage(script) +
+           memusage::MallocUsage(instructions.capacity() *
+                                 sizeof(Instruction));
+}
+
+namespace {
+
+/**
+ * Least recently used cache of compiled scripts. Scripts are looked up by a
+ * salted SipHash of their bytes and compared in full on a hit.
+ */
+class CScriptProgramCache {
+private:
+    using Program = std::shared_ptr<const CCompiledScript>;
+    using LruList = std::list<std::pair<uint64_t, Program>>;
+
+    std::mutex mtx;
+    LruList lru;
+    std::unordered_map<uint64_t, LruList::iterator> map;
+    size_t usage{0};
+    uint64_t k0{0};
+    uint64_t k1{0};
+    std::atomic<size_t> maxUsage{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    static size_t EntryUsage(const CCompiledScript &program) {
+        return program.DynamicMemoryUsage() +
+               memusage::MallocUsage(sizeof(CCompiledScript)) +
+               memusage::MallocUsage(sizeof(LruList::value_type) +
+                                     2 * sizeof(void *)) +
+               memusage::MallocUsage(sizeof(std::pair<const uint64_t,
+                                                      LruList::iterator>) +
+                                     sizeof(void *)) +
+               sizeof(void *);
+    }
+
+    static bool Matches(const CCompiledScript &program, const CScript &script) {
+        const CScript &cached = program.GetScript();
+        return cached.size() == script.size() &&
+               std::memcmp(cached.data(), script.data(), script.size()) == 0;
+    }
+
+    void EraseLocked(LruList::iterator it) {
+        usage -= EntryUsage(*it->second);
+        map.erase(it->first);
+        lru.erase(it);
+    }
+
+public:
+    void Configure(size_t maxUsageIn, uint64_t k0In, uint64_t k1In) {
+        std::lock_guard<std::mutex> lock(mtx);
+        k0 = k0In;
+        k1 = k1In;
+        maxUsage = maxUsageIn;
+        lru.clear();
+        map.clear();
+        usage = 0;
+    }
+
+    Program Get(const CScript &script) {
+        const size_t limit = maxUsage;
+        if (!limit || script.size() < MIN_COMPILED_SCRIPT_SIZE ||
+            script.size() >= CCompiledScript::NO_JUMP) {
+            return nullptr;
+        }
+
+        // The key is only changed by Configure() during initialization.
+        const uint64_t key =
+            CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+        Program program;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = map.find(key);
+            if (it != map.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                program = it->second->second;
+            }
+        }
+        if (program && Matches(*program, script)) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return program;
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+
+        program = std::make_shared<const CCompiledScript>(script);
+        const size_t entryUsage = EntryUsage(*program);
+        if (entryUsage > limit) {
+            return program;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = map.find(key);
+        if (it != map.end()) {
+            // Either inserted by another thread in the meantime or a
+            // different script with the same hash, which is replaced.
+            EraseLocked(it->second);
+        }
+        while (usage + entryUsage > limit && !lru.empty()) {
+            EraseLocked(std::prev(lru.end()));
+        }
+        lru.emplace_front(key, program);
+        map.emplace(key, lru.begin());
+        usage += entryUsage;
+        return program;
+    }
+
+    ScriptProgramCacheStats GetStats() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return {map.size(), usage, maxUsage.load(), hits.load(),
+                misses.load()};
+    }
+};
+
+CScriptProgramCache scriptProgramCache;
+
+} // namespace
+
+void InitScriptProgramCache(size_t maxUsage, uint64_t k0, uint64_t k1) {
+    scriptProgramCache.Configure(maxUsage, k0, k1);
+}
+
+std::shared_ptr<const CCompiledScript> GetCompiledScript(const CScript &script) {
+    return scriptProgramCache.Get(script);
+}
+
+ScriptProgramCacheStats GetScriptProgramCacheStats() {
+    return scriptProgramCache.GetStats();
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_SCRIPT_COMPILED_SCRIPT_H
+#define MVC_SCRIPT_COMPILED_SCRIPT_H
+
+#include "script/script.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+/** Scripts shorter than this are interpreted directly and never cached. */
+static const size_t MIN_COMPILED_SCRIPT_SIZE = 256;
+/** Default for -maxscriptprogramcachesize, in MiB. */
+static const int64_t DEFAULT_MAX_SCRIPT_PROGRAM_CACHE_SIZE = 32;
+
+/**
+ * A script decoded once into an array of instructions.
+ *
+ * Each instruction holds its opcode, the location of its push data and the
+ * offset of the instruction that follows it, so executing the script does
+ * not need to decode it again. OP_IF, OP_NOTIF and OP_ELSE also know the
+ * matching OP_ELSE or OP_ENDIF on the same nesting level. The interpreter
+ * uses that to jump over a branch that is not executed, but only when
+ * stepping through the branch could not have failed, so results are the same
+ * as with CScript::GetOp().
+ */
+class CCompiledScript {
+public:
+    static constexpr uint32_t NO_JUMP = std::numeric_limits<uint32_t>::max();
+
+    enum Flags : uint8_t {
+        //! The script cannot be decoded at this instruction.
+        DECODE_ERROR = 1 << 0,
+        //! The branch up to jump can be skipped before genesis.
+        SKIP_BEFORE_GENESIS = 1 << 1,
+        //! The branch up to jump can be skipped after genesis.
+        SKIP_AFTER_GENESIS = 1 << 2,
+    };
+
+    struct Instruction {
+        opcodetype opcode;
+        uint8_t flags;
+        //! Offset and size of the push data in the script.
+        uint32_t operandOffset;
+        uint32_t operandSize;
+        //! Offset of the next instruction in the script.
+        uint32_t end;
+        //! Index of the matching OP_ELSE or OP_ENDIF, or NO_JUMP.
+        uint32_t jump;
+        //! Opcodes counted towards the limit between this and jump.
+        uint32_t skipOpCount;
+    };
+
+    explicit CCompiledScript(const CScript &scriptIn);
+
+    const CScript &GetScript() const { return script; }
+    const std::vector<Instruction> &GetInstructions() const {
+        return instructions;
+    }
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    const CScript script;
+    std::vector<Instruction> instructions;
+};
+
+struct ScriptProgramCacheStats {
+    size_t entries;
+    size_t usage;
+    size_t maxUsage;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+ * Set the memory limit of the compiled script cache, in bytes, and the key
+ * of the hash used to look scripts up. A limit of 0 disables the cache,
+ * which is the default.
+ */
+void InitScriptProgramCache(size_t maxUsage, uint64_t k0, uint64_t k1);
+
+/**
+ * Return the compiled form of script, compiling and caching it if it is not
+ * cached yet. Returns nullptr if the cache is disabled or the script is too
+ * small to be worth caching.
+ */
+std::shared_ptr<const CCompiledScript> GetCompiledScript(const CScript &script);
+
+ScriptProgramCacheStats GetScriptProgramCacheStats();
+
+#endif // MVC_SCRIPT_COMPILED_SCRIPT_H
@@ -11,8 +11,10 @@
 #include "crypto/sha256.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
+#include "script/compiled_script.h"
 #include "script/script.h"
 #include "script/script_num.h"
+#include "script/script_profiler.h"
 #include "taskcancellation.h"
 #include "uint256.h"
 #include "consensus/consensus.h"
@@ -362,12 +364,145 @@ inline bool IsValidMaxOpsPerScript(uint64_t nOpCount,
     return (nOpCount <= config.GetMaxOpsPerScript(isGenesisEnabled, consensus));
 }
 
-std::optional<bool> EvalScript(
+namespace {
+
+/** Reads the instructions of a script with CScript::GetOp(). */
+class CScriptDecoder {
+private:
+    const CScript &script;
+    CScript::const_iterator pc;
+
+public:
+    static constexpr bool CAN_SKIP_BRANCHES = false;
+
+    explicit CScriptDecoder(const CScript &scriptIn)
+        : script(scriptIn), pc(scriptIn.begin()) {}
+
+    const CScript &GetScript() const { return script; }
+    bool AtEnd() const { return pc >= script.end(); }
+    /** Position just after the last instruction read. */
+    CScript::const_iterator GetPosition() const { return pc; }
+
+    bool Next(opcodetype &opcode, valtype &vchPushValue) {
+        return script.GetOp(pc, opcode, vchPushValue);
+    }
+
+    bool SkipBranch(uint64_t &, uint64_t, bool) { return false; }
+};
+
+/** Reads the instructions of a script from its compiled form. */
+class CCompiledScriptDecoder {
+private:
+    const CScript &script;
+    const std::vector<CCompiledScript::Instruction> &instructions;
+    size_t next{0};
+
+public:
+    static constexpr bool CAN_SKIP_BRANCHES = true;
+
+    explicit CCompiledScriptDecoder(const CCompiledScript &program)
+        : script(program.GetScript()),
+          instructions(program.GetInstructions()) {}
+
+    const CScript &GetScript() const { return script; }
+    bool AtEnd() const { return next >= instructions.size(); }
+    /** Position just after the last instruction read. */
+    CScript::const_iterator GetPosition() const {
+        return script.begin() + instructions[next - 1].end;
+    }
+
+    bool Next(opcodetype &opcode, valtype &vchPushValue) {
+        const CCompiledScript::Instruction &ins = instructions[next++];
+        if (ins.flags & CCompiledScript::DECODE_ERROR) {
+            opcode = OP_INVALIDOPCODE;
+            vchPushValue.clear();
+            return false;
+        }
+        opcode = ins.opcode;
+        const uint8_t *operand = script.data() + ins.operandOffset;
+        vchPushValue.assign(operand, operand + ins.operandSize);
+        return true;
+    }
+
+    /**
+     * Called after the last instruction read (OP_IF, OP_NOTIF or OP_ELSE)
+     * disabled execution. Moves to the matching OP_ELSE or OP_ENDIF if the
+     * instructions in between could not have failed and would not have
+     * exceeded the opcode limit, counting them as if they had been read.
+     */
+    bool SkipBranch(uint64_t &nOpCount, uint64_t maxOpCount,
+                    bool utxo_after_genesis) {
+        const CCompiledScript::Instruction &ins = instructions[next - 1];
+        const uint8_t safe = utxo_after_genesis
+                                 ? CCompiledScript::SKIP_AFTER_GENESIS
+                                 : CCompiledScript::SKIP_BEFORE_GENESIS;
+        if (ins.jump == CCompiledScript::NO_JUMP || !(ins.flags & safe) ||
+            nOpCount + ins.skipOpCount > maxOpCount) {
+            return false;
+        }
+        nOpCount += ins.skipOpCount;
+        next = ins.jump;
+        return true;
+    }
+};
+
+/** Profiler used while the script profiler is disabled, which does nothing. */
+struct CNullOpcodeProfiler {
+    void Next(opcodetype, bool, const valtype &, const LimitedStack &) {}
+};
+
+/** Adds the executed instructions to the statistics of a CScriptProfileScope. */
+class COpcodeProfiler {
+private:
+    using clock = std::chrono::steady_clock;
+
+    OpcodeProfiles &opcodes;
+    OpcodeProfile *running{nullptr};
+    clock::time_point start;
+
+    void Stop(clock::time_point now) {
+        if (running) {
+            running->nanoseconds +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+                    .count();
+            running = nullptr;
+        }
+    }
+
+public:
+    explicit COpcodeProfiler(OpcodeProfiles &opcodesIn) : opcodes(opcodesIn) {}
+    ~COpcodeProfiler() { Stop(clock::now()); }
+
+    /**
+     * Called before each instruction is executed; the time until the next
+     * call is attributed to it.
+     */
+    void Next(opcodetype opcode, bool executed, const valtype &vchPushValue,
+              const LimitedStack &stack) {
+        const clock::time_point now = clock::now();
+        Stop(now);
+        if (!executed) {
+            return;
+        }
+        running = &opcodes[opcode];
+        ++running->count;
+        if (opcode <= OP_PUSHDATA4) {
+            running->bytes += vchPushValue.size();
+        } else if (opcode > OP_16 && !stack.empty()) {
+            running->bytes += stack.back().size();
+        }
+        start = now;
+    }
+};
+
+template <typename Decoder, typename Profiler>
+std::optional<bool> EvalInstructions(
+    Decoder& decoder,
+    Profiler& profiler,
     const CScriptConfig& config,
     bool consensus,
     const task::CCancellationToken& token,
     LimitedStack& stack,
-    const CScript& script,
     uint32_t flags,
     const BaseSignatureChecker& checker,
     LimitedStack& altstack,
@@ -381,7 +516,7 @@ std::optional<bool> EvalScript(
     static const valtype vchFalse(0);
     static const valtype vchTrue(1, 1);
 
-    CScript::const_iterator pc = script.begin();
+    const CScript& script = decoder.GetScript();
     CScript::const_iterator pend = script.end();
     CScript::const_iterator pbegincodehash = script.begin();
     opcodetype opcode;
@@ -404,7 +539,7 @@ std::optional<bool> EvalScript(
     bool nonTopLevelReturnAfterGenesis = false;
     
     try {
-        while (pc < pend) {
+        while (!decoder.AtEnd()) {
             if (token.IsCanceled())
             {
                 return {};
@@ -413,10 +548,10 @@ std::optional<bool> EvalScript(
             //
             // Read instruction
             //
-            if (!script.GetOp(pc, opcode, vchPushValue)) {
+            if (!decoder.Next(opcode, vchPushValue)) {
                 return set_error(serror, SCRIPT_ERR_BAD_OPCODE);
             }
-            ipc = pc - script.begin();
+            ipc = decoder.GetPosition() - script.begin();
 
             if (!utxo_after_genesis && (vchPushValue.size() > MAX_SCRIPT_ELEMENT_SIZE_BEFORE_GENESIS))
             {
@@ -425,6 +560,7 @@ std::optional<bool> EvalScript(
 
             // Do not execute instructions if Genesis OP_RETURN was found in executed branches.
             bool fExec = !count(vfExec.begin(), vfExec.end(), false) && (!nonTopLevelReturnAfterGenesis || opcode == OP_RETURN);
+            profiler.Next(opcode, fExec || (OP_IF <= opcode && opcode <= OP_ENDIF), vchPushValue, stack);
 
             //
             // Check opcode limits.
@@ -713,10 +849,8 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch1 = stack.stacktop(-2);
-                        LimitedVector vch2 = stack.stacktop(-1);
-                        stack.push_back(vch1);
-                        stack.push_back(vch2);
+                        stack.push_back(stack.stacktop(-2));
+                        stack.push_back(stack.stacktop(-2));
                     } break;
 
                     case OP_3DUP: {
@@ -725,12 +859,9 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch1 = stack.stacktop(-3);
-                        LimitedVector vch2 = stack.stacktop(-2);
-                        LimitedVector vch3 = stack.stacktop(-1);
-                        stack.push_back(vch1);
-                        stack.push_back(vch2);
-                        stack.push_back(vch3);
+                        stack.push_back(stack.stacktop(-3));
+                        stack.push_back(stack.stacktop(-3));
+                        stack.push_back(stack.stacktop(-3));
                     } break;
 
                     case OP_2OVER: {
@@ -739,10 +870,8 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch1 = stack.stacktop(-4);
-                        LimitedVector vch2 = stack.stacktop(-3);
-                        stack.push_back(vch1);
-                        stack.push_back(vch2);
+                        stack.push_back(stack.stacktop(-4));
+                        stack.push_back(stack.stacktop(-4));
                     } break;
 
                     case OP_2ROT: {
@@ -751,11 +880,8 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch1 = stack.stacktop(-6);
-                        LimitedVector vch2 = stack.stacktop(-5);
-                        stack.erase(- 6, - 4);
-                        stack.push_back(vch1);
-                        stack.push_back(vch2);
+                        stack.moveToTop(-6);
+                        stack.moveToTop(-6);
                     } break;
 
                     case OP_2SWAP: {
@@ -774,9 +900,8 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch = stack.stacktop(-1);
-                        if (CastToBool(vch.GetElement())) {
-                            stack.push_back(vch);
+                        if (CastToBool(stack.stacktop(-1).GetElement())) {
+                            stack.push_back(stack.stacktop(-1));
                         }
                     } break;
 
@@ -801,8 +926,7 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch = stack.stacktop(-1);
-                        stack.push_back(vch);
+                        stack.push_back(stack.stacktop(-1));
                     } break;
 
                     case OP_NIP: {
@@ -820,8 +944,7 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch = stack.stacktop(-2);
-                        stack.push_back(vch);
+                        stack.push_back(stack.stacktop(-2));
                     } break;
 
                     case OP_PICK:
@@ -845,12 +968,11 @@ std::optional<bool> EvalScript(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
                         const auto n{sn.to_size_t_limited()};
-                        LimitedVector vch = stack.stacktop(-n - 1);
-
                         if (opcode == OP_ROLL) {
-                            stack.erase(- n - 1);
+                            stack.moveToTop(-n - 1);
+                        } else {
+                            stack.push_back(stack.stacktop(-n - 1));
                         }
-                        stack.push_back(vch);
                     } break;
 
                     case OP_ROT: {
@@ -880,8 +1002,7 @@ std::optional<bool> EvalScript(
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        LimitedVector vch = stack.stacktop(-1);
-                        stack.insert(-2, vch);
+                        stack.insert(-2, stack.stacktop(-1));
                     } break;
 
                     case OP_SIZE: {
@@ -990,7 +1111,7 @@ std::optional<bool> EvalScript(
                                          : CScriptNum{INT32_MAX};
                             } while(n > 0);
                         }
-                        stack.push_back(values);
+                        stack.push_back(std::move(values));
                     }
                     break;
 
@@ -1031,7 +1152,7 @@ std::optional<bool> EvalScript(
                                          : CScriptNum{INT32_MAX};
                             } while(n > 0);
                         }
-                        stack.push_back(values);
+                        stack.push_back(std::move(values));
                     }
                     break;
 
@@ -1306,12 +1427,12 @@ std::optional<bool> EvalScript(
                                 .Finalize(vchHash.data());
                         }
                         stack.pop_back();
-                        stack.push_back(vchHash);
+                        stack.push_back(std::move(vchHash));
                     } break;
 
                     case OP_CODESEPARATOR: {
                         // Hash starts after the code separator
-                        pbegincodehash = pc;
+                        pbegincodehash = decoder.GetPosition();
                     } break;
 
                     case OP_CHECKSIG:
@@ -1519,12 +1640,8 @@ std::optional<bool> EvalScript(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
 
-                        LimitedVector &vch1 = stack.stacktop(-2);
-                        // We make copy of last element on stack (vch2) so we can pop the last
-                        // element before appending it to the previous element.
-                        // If appending would be first, we could exceed stack size in the process
-                        // even though OP_CAT actually reduces total stack size.
-                        LimitedVector vch2 = stack.stacktop(-1);
+                        const LimitedVector &vch1 = stack.stacktop(-2);
+                        const LimitedVector &vch2 = stack.stacktop(-1);
 
                         if (!utxo_after_genesis &&
                             (vch1.size() + vch2.size() > MAX_SCRIPT_ELEMENT_SIZE_BEFORE_GENESIS))
@@ -1532,8 +1649,9 @@ std::optional<bool> EvalScript(
                             return set_error(serror, SCRIPT_ERR_PUSH_SIZE);
                         }
 
-                        stack.pop_back();
-                        vch1.append(vch2);
+                        // Appends in place without copying vch2 first. The
+                        // combined stack size only shrinks.
+                        stack.catTop();
                     } break;
 
                     case OP_SPLIT: {
@@ -1556,17 +1674,9 @@ std::optional<bool> EvalScript(
 
                         const auto position{n.to_size_t_limited()};
 
-                        // Prepare the results in their own buffer as `data`
-                        // will be invalidated.
-                        valtype n1(data.begin(), data.begin() + position);
-                        valtype n2(data.begin() + position, data.end());
-
-                        stack.pop_back();
+                        // Split `data` in place, copying only its smaller part.
                         stack.pop_back();
-
-                        // Replace existing stack values by the new values.
-                        stack.push_back(n1);
-                        stack.push_back(n2);
+                        stack.splitTop(position);
                     } break;
 
                     //
@@ -1655,6 +1765,16 @@ std::optional<bool> EvalScript(
             {
                 return set_error(serror, SCRIPT_ERR_STACK_SIZE);
             }
+
+            // Jump over a branch that is not executed
+            if constexpr (Decoder::CAN_SKIP_BRANCHES) {
+                if ((opcode == OP_IF || opcode == OP_NOTIF || opcode == OP_ELSE) &&
+                    count(vfExec.begin(), vfExec.end(), false)) {
+                    decoder.SkipBranch(nOpCount,
+                                       config.GetMaxOpsPerScript(utxo_after_genesis, consensus),
+                                       utxo_after_genesis);
+                }
+            }
         }
     }
     catch(scriptnum_overflow_error& err)
@@ -1685,6 +1805,55 @@ std::optional<bool> EvalScript(
     return set_success(serror);
 }
 
+/**
+ * Evaluate the instructions, collecting opcode statistics if the script
+ * profiler is enabled and a CScriptProfileScope is active on this thread.
+ */
+template <typename Decoder>
+std::optional<bool> EvalInstructions(
+    Decoder& decoder,
+    const CScriptConfig& config,
+    bool consensus,
+    const task::CCancellationToken& token,
+    LimitedStack& stack,
+    uint32_t flags,
+    const BaseSignatureChecker& checker,
+    LimitedStack& altstack,
+    long& ipc,
+    std::vector<bool>& vfExec,
+    std::vector<bool>& vfElse,
+    ScriptError* serror)
+{
+    if (IsScriptProfilerEnabled()) {
+        if (OpcodeProfiles* opcodes = CScriptProfileScope::GetCurrent()) {
+            COpcodeProfiler profiler(*opcodes);
+            return EvalInstructions(decoder, profiler, config, consensus, token, stack, flags, checker, altstack, ipc, vfExec, vfElse, serror);
+        }
+    }
+    CNullOpcodeProfiler profiler;
+    return EvalInstructions(decoder, profiler, config, consensus, token, stack, flags, checker, altstack, ipc, vfExec, vfElse, serror);
+}
+
+} // namespace
+
+std::optional<bool> EvalScript(
+    const CScriptConfig& config,
+    bool consensus,
+    const task::CCancellationToken& token,
+    LimitedStack& stack,
+    const CScript& script,
+    uint32_t flags,
+    const BaseSignatureChecker& checker,
+    LimitedStack& altstack,
+    long& ipc,
+    std::vector<bool>& vfExec,
+    std::vector<bool>& vfElse,
+    ScriptError* serror)
+{
+    CScriptDecoder decoder(script);
+    return EvalInstructions(decoder, config, consensus, token, stack, flags, checker, altstack, ipc, vfExec, vfElse, serror);
+}
+
 std::optional<bool> EvalScript(
     const CScriptConfig& config,
     bool consensus,
@@ -1701,6 +1870,50 @@ std::optional<bool> EvalScript(
     return EvalScript(config, consensus, token, stack, script, flags, checker, altstack, ipc, vfExec, vfElse, serror);
 }
 
+std::optional<bool> EvalScript(
+    const CScriptConfig& config,
+    bool consensus,
+    const task::CCancellationToken& token,
+    LimitedStack& stack,
+    const CCompiledScript& program,
+    uint32_t flags,
+    const BaseSignatureChecker& checker,
+    ScriptError* serror)
+{
+    LimitedStack altstack {stack.makeChildStack()};
+    long ipc{0};
+    std::vector<bool> vfExec, vfElse;
+    CCompiledScriptDecoder decoder(program);
+    return EvalInstructions(decoder, config, consensus, token, stack, flags, checker, altstack, ipc, vfExec, vfElse, serror);
+}
+
+namespace {
+
+/**
+ * Evaluate a script that is likely to be executed again, such as the script
+ * of an output, from the compiled script cache if it is enabled.
+ */
+std::optional<bool> EvalCachedScript(
+    const CScriptConfig& config,
+    bool consensus,
+    const task::CCancellationToken& token,
+    LimitedStack& stack,
+    const CScript& script,
+    uint32_t flags,
+    const BaseSignatureChecker& checker,
+    ScriptError* serror)
+{
+    const bool utxo_after_genesis{(flags & SCRIPT_UTXO_AFTER_GENESIS) != 0};
+    if (script.size() <= config.GetMaxScriptSize(utxo_after_genesis, consensus)) {
+        if (auto program = GetCompiledScript(script)) {
+            return EvalScript(config, consensus, token, stack, *program, flags, checker, serror);
+        }
+    }
+    return EvalScript(config, consensus, token, stack, script, flags, checker, serror);
+}
+
+} // namespace
+
 namespace {
 
 /**
@@ -1840,13 +2053,81 @@ uint256 GetOutputsHash(const CTransaction &txTo) {
     return ss.GetHash();
 }
 
+/**
+ * Hash the part of the FORKID signature hash preimage that does not depend on
+ * the amount, outputs or sighash type of a signature.
+ */
+CHashWriter SignatureHashPrefix(const CScript &scriptCode,
+                                const CTransaction &txTo, unsigned int nIn,
+                                const uint256 &hashPrevouts,
+                                const uint256 &hashSequence) {
+    CHashWriter ss(SER_GETHASH, 0);
+    // Version
+    ss << txTo.nVersion;
+    // Input prevouts/nSequence (none/all, depending on flags)
+    ss << hashPrevouts;
+    ss << hashSequence;
+    // The input being signed (replacing the scriptSig with scriptCode +
+    // amount). The prevout may already be contained in hashPrevout, and the
+    // nSequence may already be contain in hashSequence.
+    ss << txTo.vin[nIn].prevout;
+    ss << scriptCode;
+    return ss;
+}
+
 } // namespace
 
+struct CSigHashMidstateCache::Entry {
+    CScript scriptCode;
+    CHashWriter midstate;
+};
+
+CSigHashMidstateCache::CSigHashMidstateCache(size_t numberOfInputs)
+    : entries(numberOfInputs) {}
+
+std::shared_ptr<const CHashWriter>
+CSigHashMidstateCache::Get(size_t nIn, PrefixType prefixType,
+                           const CScript &scriptCode) const {
+    std::shared_ptr<const Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (nIn < entries.size()) {
+            entry = entries[nIn][static_cast<size_t>(prefixType)];
+        }
+    }
+    // Compare outside of the lock, other inputs may be checked in parallel.
+    if (!entry || entry->scriptCode.size() != scriptCode.size() ||
+        memcmp(entry->scriptCode.data(), scriptCode.data(),
+               scriptCode.size()) != 0) {
+        return nullptr;
+    }
+    return std::shared_ptr<const CHashWriter>(entry, &entry->midstate);
+}
+
+void CSigHashMidstateCache::Insert(size_t nIn, PrefixType prefixType,
+                                   const CScript &scriptCode,
+                                   const CHashWriter &midstate) {
+    auto entry = std::make_shared<const Entry>(Entry{scriptCode, midstate});
+    std::lock_guard<std::mutex> lock(mtx);
+    if (nIn < entries.size()) {
+        entries[nIn][static_cast<size_t>(prefixType)] = std::move(entry);
+    }
+}
+
 PrecomputedTransactionData::PrecomputedTransactionData(
-    const CTransaction &txTo) {
-    hashPrevouts = GetPrevoutHash(txTo);
-    hashSequence = GetSequenceHash(txTo);
-    hashOutputs = GetOutputsHash(txTo);
+    const CTransaction &txTo)
+    : PrecomputedTransactionData(txTo.GetPrecomputedTransactionData()) {
+    scriptCodeMidstates =
+        std::make_shared<CSigHashMidstateCache>(txTo.vin.size());
+}
+
+PrecomputedTransactionData
+PrecomputedTransactionData::ComputeHashes(const CTransaction &txTo) {
+    PrecomputedTransactionData txdata;
+    txdata.hashPrevouts = GetPrevoutHash(txTo);
+    txdata.hashSequence = GetSequenceHash(txTo);
+    txdata.hashOutputs = GetOutputsHash(txTo);
+    return txdata;
 }
 
 uint256 SignatureHash(const CScript &scriptCode, const CTransaction &txTo,
@@ -1878,17 +2159,33 @@ uint256 SignatureHash(const CScript &scriptCode, const CTransaction &txTo,
             hashOutputs = ss.GetHash();
         }
 
-        CHashWriter ss(SER_GETHASH, 0);
-        // Version
-        ss << txTo.nVersion;
-        // Input prevouts/nSequence (none/all, depending on flags)
-        ss << hashPrevouts;
-        ss << hashSequence;
-        // The input being signed (replacing the scriptSig with scriptCode +
-        // amount). The prevout may already be contained in hashPrevout, and the
-        // nSequence may already be contain in hashSequence.
-        ss << txTo.vin[nIn].prevout;
-        ss << scriptCode;
+        // Everything up to and including scriptCode is the same for all
+        // signatures of this input with the same prefix type, so the midstate
+        // of a large scriptCode is reused.
+        CSigHashMidstateCache *midstates =
+            (cache && scriptCode.size() >=
+                          CSigHashMidstateCache::MIN_SCRIPT_CODE_SIZE)
+                ? cache->scriptCodeMidstates.get()
+                : nullptr;
+        const CSigHashMidstateCache::PrefixType prefixType =
+            sigHashType.hasAnyoneCanPay()
+                ? CSigHashMidstateCache::PrefixType::NO_PREVOUTS
+                : ((sigHashType.getBaseType() == BaseSigHashType::SINGLE ||
+                    sigHashType.getBaseType() == BaseSigHashType::NONE)
+                       ? CSigHashMidstateCache::PrefixType::NO_SEQUENCE
+                       : CSigHashMidstateCache::PrefixType::ALL);
+        std::shared_ptr<const CHashWriter> midstate;
+        if (midstates) {
+            midstate = midstates->Get(nIn, prefixType, scriptCode);
+        }
+
+        CHashWriter ss = midstate ? CHashWriter(*midstate)
+                                  : SignatureHashPrefix(scriptCode, txTo, nIn,
+                                                        hashPrevouts,
+                                                        hashSequence);
+        if (midstates && !midstate) {
+            midstates->Insert(nIn, prefixType, scriptCode, ss);
+        }
         ss << amount.GetSatoshis();
         ss << txTo.vin[nIn].nSequence;
         // Outputs (none/one/all, depending on flags)
@@ -2057,6 +2354,8 @@ std::optional<bool> VerifyScript(
 {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
 
+    CScriptProfileScope profileScope(scriptPubKey);
+
     // If FORKID is enabled, we also ensure strict encoding.
     if (flags & SCRIPT_ENABLE_SIGHASH_FORKID) {
         flags |= SCRIPT_VERIFY_STRICTENC;
@@ -2076,7 +2375,7 @@ std::optional<bool> VerifyScript(
     if ((flags & SCRIPT_VERIFY_P2SH)  && !(flags & SCRIPT_UTXO_AFTER_GENESIS)) {
         stackCopy = stack.makeRootStackCopy();
     }
-    if (auto res = EvalScript(config, consensus, token, stack, scriptPubKey, flags, checker, serror);
+    if (auto res = EvalCachedScript(config, consensus, token, stack, scriptPubKey, flags, checker, serror);
         !res.has_value() || !res.value())
     {
         return res;
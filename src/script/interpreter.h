@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 
+class CCompiledScript;
 class CPubKey;
 class CScript;
 class CScriptConfig;
@@ -123,6 +124,19 @@ std::optional<bool> EvalScript(
     uint32_t flags,
     const BaseSignatureChecker& checker,
     ScriptError* error = nullptr);
+/**
+* Evaluate a compiled script. The result is the same as evaluating
+* program.GetScript() but the script is not decoded again.
+*/
+std::optional<bool> EvalScript(
+    const CScriptConfig& config,
+    bool consensus,
+    const task::CCancellationToken& token,
+    LimitedStack& stack,
+    const CCompiledScript& program,
+    uint32_t flags,
+    const BaseSignatureChecker& checker,
+    ScriptError* error = nullptr);
 std::optional<bool> VerifyScript(
     const CScriptConfig& config,
     bool consensus,
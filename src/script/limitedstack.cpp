@@ -5,12 +5,17 @@
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
 #include "script/int_serialization.h"
+#include <algorithm>
 #include <iostream>
 
 LimitedVector::LimitedVector(const valtype& stackElementIn, LimitedStack& stackIn) : stackElement(stackElementIn), stack(stackIn)
 {
 }
 
+LimitedVector::LimitedVector(valtype&& stackElementIn, LimitedStack& stackIn) : stackElement(std::move(stackElementIn)), stack(stackIn)
+{
+}
+
 const valtype& LimitedVector::GetElement() const
 {
     return stackElement;
@@ -124,16 +129,102 @@ const LimitedStack& LimitedVector::getStack() const
     return stack.get();
 }
 
+LimitedStack::BufferPool::BufferPool(uint64_t maxStackSize)
+    : maxPooledBytes{static_cast<size_t>(std::min<uint64_t>(
+          MAX_POOLED_BYTES, maxStackSize / MAX_POOLED_STACK_SIZE_DIVISOR))}
+{
+}
+
+valtype LimitedStack::BufferPool::take(size_t capacity)
+{
+    if (capacity <= SMALL_BUFFER_CAPACITY)
+    {
+        std::vector<valtype>& buffers{smallBuffers[capacity]};
+        if (!buffers.empty())
+        {
+            valtype buffer{std::move(buffers.back())};
+            buffers.pop_back();
+            --smallBufferCount;
+            pooledBytes -= buffer.capacity();
+            return buffer;
+        }
+    }
+    else
+    {
+        for (auto it = largeBuffers.rbegin(); it != largeBuffers.rend(); ++it)
+        {
+            if (it->capacity() == capacity)
+            {
+                valtype buffer{std::move(*it)};
+                largeBuffers.erase(std::next(it).base());
+                pooledBytes -= buffer.capacity();
+                return buffer;
+            }
+        }
+    }
+
+    valtype buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void LimitedStack::BufferPool::release(valtype&& buffer)
+{
+    const size_t capacity{buffer.capacity()};
+    if (capacity == 0 || capacity > MAX_LARGE_BUFFER_CAPACITY ||
+        pooledBytes + capacity > maxPooledBytes)
+    {
+        return;
+    }
+
+    buffer.clear();
+    if (capacity <= SMALL_BUFFER_CAPACITY)
+    {
+        if (smallBufferCount < MAX_SMALL_BUFFERS)
+        {
+            ++smallBufferCount;
+            pooledBytes += capacity;
+            smallBuffers[capacity].push_back(std::move(buffer));
+        }
+    }
+    else if (largeBuffers.size() < MAX_LARGE_BUFFERS)
+    {
+        pooledBytes += capacity;
+        largeBuffers.push_back(std::move(buffer));
+    }
+}
+
+valtype LimitedStack::makeElement(const valtype& element)
+{
+    if (!bufferPool)
+    {
+        return element;
+    }
+    valtype buffer{bufferPool->take(element.size())};
+    buffer.assign(element.begin(), element.end());
+    return buffer;
+}
+
+void LimitedStack::releaseElement(LimitedVector& element)
+{
+    if (bufferPool)
+    {
+        bufferPool->release(std::move(element.GetElementNonConst()));
+    }
+}
+
 LimitedStack::LimitedStack(uint64_t maxStackSizeIn)
 {
     maxStackSize = maxStackSizeIn;
     parentStack = nullptr;
+    bufferPool = std::make_shared<BufferPool>(maxStackSize);
 }
 
 LimitedStack::LimitedStack(const std::vector<valtype>& stackElements, uint64_t maxStackSizeIn)
 {
     maxStackSize = maxStackSizeIn;
     parentStack = nullptr;
+    bufferPool = std::make_shared<BufferPool>(maxStackSize);
     for (const auto& element : stackElements)
     {
         push_back(element);
@@ -194,6 +285,7 @@ void LimitedStack::pop_back()
         throw std::runtime_error("popstack(): stack empty");
     }
     decreaseCombinedStackSize(stacktop(-1).size() + LimitedVector::ELEMENT_OVERHEAD);
+    releaseElement(stack.back());
     stack.pop_back();
 }
 
@@ -204,13 +296,21 @@ void LimitedStack::push_back(const LimitedVector &element)
         throw std::invalid_argument("Invalid argument - element that is added should have the same parent stack as the one we are adding to.");
     }
     increaseCombinedStackSize(element.size() + LimitedVector::ELEMENT_OVERHEAD);
-    stack.push_back(element);
+    // Copy before growing the stack, which may invalidate element
+    valtype copy{makeElement(element.GetElement())};
+    stack.push_back(LimitedVector{std::move(copy), *this});
 }
 
 void LimitedStack::push_back(const valtype& element)
 {
     increaseCombinedStackSize(element.size() + LimitedVector::ELEMENT_OVERHEAD);
-    stack.push_back(LimitedVector{element, *this});
+    stack.push_back(LimitedVector{makeElement(element), *this});
+}
+
+void LimitedStack::push_back(valtype&& element)
+{
+    increaseCombinedStackSize(element.size() + LimitedVector::ELEMENT_OVERHEAD);
+    stack.push_back(LimitedVector{std::move(element), *this});
 }
 
 LimitedVector& LimitedStack::stacktop(int index)
@@ -241,6 +341,7 @@ void LimitedStack::erase(int first, int last)
     for (std::vector<LimitedVector>::iterator it = stack.end() + first; it != stack.end() + last; it++)
     {
         decreaseCombinedStackSize(it->size() + LimitedVector::ELEMENT_OVERHEAD);
+        releaseElement(*it);
     }
 
     stack.erase(stack.end() + first, stack.end() + last);
@@ -253,6 +354,7 @@ void LimitedStack::erase(int index)
         throw std::invalid_argument("Invalid argument - index should be < 0.");
     };
     decreaseCombinedStackSize(stack.at(stack.size() + index).size() + LimitedVector::ELEMENT_OVERHEAD);
+    releaseElement(*(stack.end() + index));
     stack.erase(stack.end() + index); 
 }
 
@@ -268,7 +370,8 @@ void LimitedStack::insert(int position, const LimitedVector& element)
         throw std::invalid_argument("Invalid argument - position should be < 0.");
     };
     increaseCombinedStackSize(element.size() + LimitedVector::ELEMENT_OVERHEAD);
-    stack.insert(stack.end() + position, element);
+    valtype copy{makeElement(element.GetElement())};
+    stack.insert(stack.end() + position, LimitedVector{std::move(copy), *this});
 }
 
 void LimitedStack::swapElements(size_t index1, size_t index2)
@@ -276,6 +379,15 @@ void LimitedStack::swapElements(size_t index1, size_t index2)
     std::swap(stack.at(index1), stack.at(index2));
 }
 
+void LimitedStack::moveToTop(int index)
+{
+    if (index >= 0 || static_cast<size_t>(-index) > stack.size())
+    {
+        throw std::invalid_argument("Invalid argument - index should be < 0 and within the stack.");
+    }
+    std::rotate(stack.end() + index, stack.end() + index + 1, stack.end());
+}
+
 // this method does not change combinedSize
 // it is allowed only for relations parent-child
 void LimitedStack::moveTopToStack(LimitedStack& otherStack)
@@ -333,6 +445,7 @@ LimitedStack LimitedStack::makeChildStack()
 {
     LimitedStack stack;
     stack.parentStack = this;
+    stack.bufferPool = bufferPool;
 
     return stack;
 }
@@ -347,6 +460,59 @@ LimitedStack LimitedStack::makeRootStackCopy()
     return *this;
 }
 
+void LimitedStack::catTop()
+{
+    if (stack.size() < 2)
+    {
+        throw std::runtime_error("catTop(): stack too small");
+    }
+    valtype& first = stack[stack.size() - 2].GetElementNonConst();
+    valtype& second = stack.back().GetElementNonConst();
+
+    // The second element is removed before its data is added to the first,
+    // so the combined size only shrinks.
+    decreaseCombinedStackSize(second.size() + LimitedVector::ELEMENT_OVERHEAD);
+    increaseCombinedStackSize(second.size());
+
+    const size_t combinedSize{first.size() + second.size()};
+    if (first.capacity() < combinedSize && second.capacity() >= combinedSize)
+    {
+        second.insert(second.begin(), first.begin(), first.end());
+        std::swap(first, second);
+    }
+    else
+    {
+        first.insert(first.end(), second.begin(), second.end());
+    }
+
+    releaseElement(stack.back());
+    stack.pop_back();
+}
+
+void LimitedStack::splitTop(size_t position)
+{
+    if (stack.empty())
+    {
+        throw std::runtime_error("splitTop(): stack empty");
+    }
+    valtype& data = stack.back().GetElementNonConst();
+    if (position > data.size())
+    {
+        throw std::invalid_argument("Invalid argument - position is past the end of the element.");
+    }
+
+    // The data is unchanged, only one more element is on the stack.
+    increaseCombinedStackSize(LimitedVector::ELEMENT_OVERHEAD);
+
+    // Keep the head in place and copy the tail out. Keeping the tail instead
+    // would move it to the front of the buffer, which costs as much.
+    valtype tail{bufferPool ? bufferPool->take(data.size() - position) : valtype{}};
+    tail.assign(data.begin() + position, data.end());
+    data.resize(position);
+
+    stack.push_back(LimitedVector{std::move(tail), *this});
+}
+
 const LimitedStack* LimitedStack::getParentStack() const
 {
     return parentStack;
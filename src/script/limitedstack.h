@@ -5,8 +5,10 @@
 #ifndef MVC_SCRIPT_LIMITEDSTACK_H
 #define MVC_SCRIPT_LIMITEDSTACK_H
 
+#include <array>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -30,6 +32,7 @@ private:
     std::reference_wrapper<LimitedStack> stack;
 
     LimitedVector(const valtype& stackElementIn, LimitedStack& stackIn);
+    LimitedVector(valtype&& stackElementIn, LimitedStack& stackIn);
 
     // WARNING: modifying returned element will NOT adjust stack size
     valtype& GetElementNonConst();
@@ -72,10 +75,54 @@ public:
 class LimitedStack
 {
 private:
+    /**
+     * Buffers of removed stack elements, kept for reuse by later pushes so
+     * that a script evaluation stops allocating once its stack has reached
+     * its working size. A buffer is only handed out for an element of the
+     * size it was allocated for, so that the memory of an element stays what
+     * the combined stack size charges for it. Small buffers, used for
+     * numbers, hashes, public keys and signatures, are kept by capacity. The
+     * pool is shared between a stack and its child stacks.
+     *
+     * Pooled buffers are not counted in the combined stack size, so their
+     * total capacity is kept well below the stack memory limit.
+     */
+    class BufferPool
+    {
+    public:
+        // Largest capacity of the buffers of small elements.
+        static constexpr size_t SMALL_BUFFER_CAPACITY = 80;
+        // Bounds on the memory kept for reuse.
+        static constexpr size_t MAX_SMALL_BUFFERS = 1024;
+        static constexpr size_t MAX_LARGE_BUFFERS = 64;
+        static constexpr size_t MAX_LARGE_BUFFER_CAPACITY = 1024 * 1024;
+        static constexpr size_t MAX_POOLED_BYTES = 4 * 1024 * 1024;
+        // Share of the stack memory limit the pool may keep at most.
+        static constexpr uint64_t MAX_POOLED_STACK_SIZE_DIVISOR = 8;
+
+        explicit BufferPool(uint64_t maxStackSize);
+
+        // Returns an empty buffer with exactly the given capacity.
+        valtype take(size_t capacity);
+        void release(valtype&& buffer);
+
+    private:
+        const size_t maxPooledBytes;
+        size_t pooledBytes = 0;
+        // Small buffers by capacity.
+        std::array<std::vector<valtype>, SMALL_BUFFER_CAPACITY + 1> smallBuffers;
+        size_t smallBufferCount = 0;
+        std::vector<valtype> largeBuffers;
+    };
+
     uint64_t combinedStackSize = 0;
     uint64_t maxStackSize = 0;
     std::vector<LimitedVector> stack;
     LimitedStack* parentStack { nullptr };
+    std::shared_ptr<BufferPool> bufferPool;
+
+    valtype makeElement(const valtype& element);
+    void releaseElement(LimitedVector& element);
     void decreaseCombinedStackSize(uint64_t additionalSize);
     void increaseCombinedStackSize(uint64_t additionalSize);
 
@@ -105,8 +152,10 @@ public:
     bool empty() const;
 
     void pop_back();
+    // The element may be a reference to an element of this stack.
     void push_back(const LimitedVector &element);
     void push_back(const valtype& element);
+    void push_back(valtype&& element);
 
     // erase elements from including (top - first). element until excluding (top - last). element
     // first and last should be negative numbers (distance from the top)
@@ -120,6 +169,18 @@ public:
 
     void swapElements(size_t index1, size_t index2);
 
+    // Moves the element at index (distance from the top) to the top without
+    // copying it. Does not change the combined size.
+    void moveToTop(int index);
+
+    // Replaces the top two elements (x1 x2) with their concatenation. The
+    // result reuses the buffer of x1, or of x2 if only that one has room.
+    void catTop();
+
+    // Splits the top element at position into two elements. The head keeps
+    // the buffer of the element and the tail is copied to a new one.
+    void splitTop(size_t position);
+
     void moveTopToStack(LimitedStack& otherStack);
 
     void MoveToValtypes(std::vector<valtype>& script);
@@ -11,6 +11,17 @@
 #include "taskcancellation.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -60,6 +71,72 @@ inline int set_error(mvcconsensus_error *ret,
     return 0;
 }
 
+/**
+ * Threads that help verify the inputs of batches. A batch is worked on by the
+ * calling thread and by jobs submitted to the pool, which all take the next
+ * input that is left until there is none.
+ */
+class BatchThreadPool {
+public:
+    explicit BatchThreadPool(size_t numThreads) {
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this] { Worker(); });
+        }
+    }
+
+    // Runs the jobs that are left before it returns.
+    ~BatchThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running = false;
+        }
+        cv.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    BatchThreadPool(const BatchThreadPool &) = delete;
+    BatchThreadPool &operator=(const BatchThreadPool &) = delete;
+
+    size_t Size() const { return threads.size(); }
+
+    void Submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.push(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+private:
+    void Worker() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this] { return !running || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> jobs;
+    bool running{true};
+    std::vector<std::thread> threads;
+};
+
+std::mutex batchPoolMtx;
+// Batches hold a reference so that the pool can be replaced while they run.
+std::shared_ptr<BatchThreadPool> batchPool;
+
 } // namespace
 
 /** Check that all specified flags are part of the libconsensus interface. */
@@ -130,6 +207,112 @@ int mvcconsensus_verify_script(const CScriptConfig& config,
                            nIn, flags, err);
 }
 
+/**
+ * The batch API takes the amounts of all spent outputs, so SIGHASH_FORKID can
+ * be enabled.
+ */
+static bool verify_batch_flags(unsigned int flags) {
+    return (flags & ~(mvcconsensus_SCRIPT_FLAGS_VERIFY_ALL |
+                      mvcconsensus_SCRIPT_ENABLE_SIGHASH_FORKID)) == 0;
+}
+
+int mvcconsensus_verify_script_batch(
+    const CScriptConfig& config,
+    const uint8_t *txTo, unsigned int txToLen,
+    const mvcconsensus_spent_output *spentOutputs, unsigned int nSpentOutputs,
+    unsigned int flags, int *results, mvcconsensus_error *err) {
+    if (!verify_batch_flags(flags)) {
+        return set_error(err, mvcconsensus_ERR_INVALID_FLAGS);
+    }
+
+    std::optional<CTransaction> tx;
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        tx.emplace(deserialize, stream);
+    } catch (const std::exception &) {
+        return set_error(err, mvcconsensus_ERR_TX_DESERIALIZE);
+    }
+    if (GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+        return set_error(err, mvcconsensus_ERR_TX_SIZE_MISMATCH);
+    if (tx->vin.size() != nSpentOutputs || (nSpentOutputs && !spentOutputs))
+        return set_error(err, mvcconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+    // Regardless of the verification results, the tx did not error.
+    set_error(err, mvcconsensus_ERR_OK);
+
+    const PrecomputedTransactionData txdata(*tx);
+    auto source = task::CCancellationSource::Make();
+    const auto token = source->GetToken();
+
+    std::atomic<size_t> nextInput{0};
+    std::atomic<bool> allValid{true};
+    auto verifyInputs = [&] {
+        for (size_t nIn; (nIn = nextInput.fetch_add(1)) < nSpentOutputs;) {
+            const mvcconsensus_spent_output &spent = spentOutputs[nIn];
+            bool valid = false;
+            try {
+                valid =
+                  VerifyScript(
+                      config, true,
+                      token,
+                      tx->vin[nIn].scriptSig,
+                      CScript(spent.scriptPubKey,
+                              spent.scriptPubKey + spent.scriptPubKeyLen),
+                      flags,
+                      TransactionSignatureChecker(&*tx, nIn,
+                                                  Amount(spent.amount), txdata),
+                      nullptr)
+                      .value_or(false);
+            } catch (const std::exception &) {
+            }
+            results[nIn] = valid;
+            if (!valid) {
+                allValid = false;
+            }
+        }
+    };
+
+    std::shared_ptr<BatchThreadPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(batchPoolMtx);
+        pool = batchPool;
+    }
+    size_t helpers = 0;
+    if (pool && nSpentOutputs > 1) {
+        helpers = std::min<size_t>(pool->Size(), nSpentOutputs - 1);
+    }
+
+    std::mutex doneMtx;
+    std::condition_variable doneCv;
+    size_t running = helpers;
+    for (size_t i = 0; i < helpers; ++i) {
+        pool->Submit([&] {
+            verifyInputs();
+            // Notify under the lock, the batch is gone once it can see 0.
+            std::lock_guard<std::mutex> lock(doneMtx);
+            --running;
+            doneCv.notify_one();
+        });
+    }
+    verifyInputs();
+    {
+        std::unique_lock<std::mutex> lock(doneMtx);
+        doneCv.wait(lock, [&running] { return running == 0; });
+    }
+
+    return allValid;
+}
+
+void mvcconsensus_set_batch_threads(unsigned int nThreads) {
+    std::shared_ptr<BatchThreadPool> pool;
+    if (nThreads) {
+        pool = std::make_shared<BatchThreadPool>(nThreads);
+    }
+    std::lock_guard<std::mutex> lock(batchPoolMtx);
+    // The old pool is joined by whichever holder releases it last.
+    batchPool.swap(pool);
+}
+
 unsigned int mvcconsensus_version() {
     // Just use the API version for now
     return MVCCONSENSUS_API_VER;
@@ -35,7 +35,7 @@ extern "C" {
 
 class CScriptConfig;
 
-#define MVCCONSENSUS_API_VER 1
+#define MVCCONSENSUS_API_VER 2
 
 typedef enum mvcconsensus_error_t {
     mvcconsensus_ERR_OK = 0,
@@ -44,6 +44,7 @@ typedef enum mvcconsensus_error_t {
     mvcconsensus_ERR_TX_DESERIALIZE,
     mvcconsensus_ERR_AMOUNT_REQUIRED,
     mvcconsensus_ERR_INVALID_FLAGS,
+    mvcconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
 } mvcconsensus_error;
 
 /** Script verification flags */
@@ -87,6 +88,35 @@ EXPORT_SYMBOL int mvcconsensus_verify_script_with_amount(
     const uint8_t *txTo, unsigned int txToLen, unsigned int nIn,
     unsigned int flags, mvcconsensus_error *err);
 
+/// An output spent by an input of the transaction passed to
+/// mvcconsensus_verify_script_batch.
+typedef struct mvcconsensus_spent_output_t {
+    const uint8_t *scriptPubKey;
+    unsigned int scriptPubKeyLen;
+    int64_t amount;
+} mvcconsensus_spent_output;
+
+/// Verifies all inputs of the serialized transaction pointed to by txTo.
+/// spentOutputs must hold the output spent by each input, in the order of the
+/// inputs, and results receives 1 or 0 for each input. The transaction is
+/// deserialized and its signature hash data computed once for all inputs,
+/// which are spread over the threads set by mvcconsensus_set_batch_threads.
+/// mvcconsensus_SCRIPT_ENABLE_SIGHASH_FORKID may be set in flags.
+/// Returns 1 if all inputs are valid.
+/// If not nullptr, err will contain an error/success code for the operation.
+/// results is only written when the code is mvcconsensus_ERR_OK.
+EXPORT_SYMBOL int mvcconsensus_verify_script_batch(
+    const CScriptConfig& config,
+    const uint8_t *txTo, unsigned int txToLen,
+    const mvcconsensus_spent_output *spentOutputs, unsigned int nSpentOutputs,
+    unsigned int flags, int *results, mvcconsensus_error *err);
+
+/// Sets the number of threads that mvcconsensus_verify_script_batch uses in
+/// addition to the calling thread. With 0, the default, all inputs are
+/// verified in the calling thread. Batches that are running keep the threads
+/// they started with.
+EXPORT_SYMBOL void mvcconsensus_set_batch_threads(unsigned int nThreads);
+
 EXPORT_SYMBOL unsigned int mvcconsensus_version();
 
 #ifdef __cplusplus
@@ -0,0 +1,138 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/script_profiler.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace script_profiler_detail {
+std::atomic<bool> enabled{DEFAULT_SCRIPT_PROFILER};
+}
+
+thread_local OpcodeProfiles *CScriptProfileScope::current{nullptr};
+
+namespace {
+
+std::mutex profilesMutex;
+std::map<uint256, ScriptTemplateProfile> profiles;
+ScriptProfileObserver observer;
+
+//! Returns the hash of the template the statistics were added to.
+uint256 AddProfile(const CScript &scriptPubKey, const OpcodeProfiles &opcodes,
+                   uint64_t nanoseconds) {
+    uint256 hash = GetScriptTemplateHash(scriptPubKey);
+
+    std::lock_guard<std::mutex> lock(profilesMutex);
+    auto it = profiles.find(hash);
+    if (it == profiles.end()) {
+        if (profiles.size() >= MAX_PROFILED_SCRIPT_TEMPLATES) {
+            hash.SetNull();
+            it = profiles.find(hash);
+        }
+        if (it == profiles.end()) {
+            it = profiles.emplace(hash, ScriptTemplateProfile{}).first;
+            it->second.templateHash = hash;
+            if (!hash.IsNull()) {
+                it->second.example = scriptPubKey;
+            }
+        }
+    }
+
+    ScriptTemplateProfile &profile = it->second;
+    ++profile.verifications;
+    profile.nanoseconds += nanoseconds;
+    for (size_t i = 0; i < opcodes.size(); ++i) {
+        if (opcodes[i].count) {
+            profile.opcodes[i].count += opcodes[i].count;
+            profile.opcodes[i].bytes += opcodes[i].bytes;
+            profile.opcodes[i].nanoseconds += opcodes[i].nanoseconds;
+        }
+    }
+    return hash;
+}
+
+} // namespace
+
+void EnableScriptProfiler(bool enable) {
+    script_profiler_detail::enabled = enable;
+}
+
+void SetScriptProfileObserver(ScriptProfileObserver observerIn) {
+    observer = std::move(observerIn);
+}
+
+uint256 GetScriptTemplateHash(const CScript &script) {
+    CHashWriter hasher(SER_GETHASH, 0);
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        const size_t offset = pc - script.begin();
+        opcodetype opcode;
+        std::vector<uint8_t> data;
+        if (!script.GetOp(pc, opcode, data)) {
+            // Undecodable remainder, which is part of the template.
+            hasher.write(reinterpret_cast<const char *>(script.data() + offset),
+                         script.size() - offset);
+            break;
+        }
+        hasher << static_cast<uint8_t>(opcode);
+        if (opcode <= OP_PUSHDATA4) {
+            hasher << static_cast<uint32_t>(data.size());
+        }
+    }
+    return hasher.GetHash();
+}
+
+std::vector<ScriptTemplateProfile> GetScriptProfiles() {
+    std::vector<ScriptTemplateProfile> result;
+    {
+        std::lock_guard<std::mutex> lock(profilesMutex);
+        result.reserve(profiles.size());
+        for (const auto &entry : profiles) {
+            result.push_back(entry.second);
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const ScriptTemplateProfile &a, const ScriptTemplateProfile &b) {
+                  return a.nanoseconds > b.nanoseconds;
+              });
+    return result;
+}
+
+void ResetScriptProfiles() {
+    std::lock_guard<std::mutex> lock(profilesMutex);
+    profiles.clear();
+}
+
+CScriptProfileScope::CScriptProfileScope(const CScript &scriptPubKeyIn)
+    : scriptPubKey(scriptPubKeyIn) {
+    if (!IsScriptProfilerEnabled()) {
+        return;
+    }
+    opcodes = std::make_unique<OpcodeProfiles>();
+    previous = current;
+    current = opcodes.get();
+    start = std::chrono::steady_clock::now();
+}
+
+CScriptProfileScope::~CScriptProfileScope() {
+    if (!opcodes) {
+        return;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    current = previous;
+    try {
+        const uint64_t nanoseconds =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count();
+        const uint256 hash = AddProfile(scriptPubKey, *opcodes, nanoseconds);
+        if (observer) {
+            observer(hash, *opcodes, nanoseconds);
+        }
+    } catch (...) {
+        // Losing a sample is preferable to failing validation.
+    }
+}
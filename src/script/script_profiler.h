@@ -0,0 +1,112 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_SCRIPT_SCRIPT_PROFILER_H
+#define MVC_SCRIPT_SCRIPT_PROFILER_H
+
+#include "script/script.h"
+#include "uint256.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/** Default for -scriptprofiler. */
+static const bool DEFAULT_SCRIPT_PROFILER = false;
+/**
+ * Number of script templates that are profiled separately. Scripts with
+ * other templates are added to a single entry with a null template hash.
+ */
+static const size_t MAX_PROFILED_SCRIPT_TEMPLATES = 1000;
+
+/** Execution statistics of one opcode. */
+struct OpcodeProfile {
+    //! Number of times the opcode was executed.
+    uint64_t count{0};
+    //! Size of the push data, or of the top stack element the opcode was
+    //! executed on.
+    uint64_t bytes{0};
+    //! Time spent executing the opcode.
+    uint64_t nanoseconds{0};
+};
+
+using OpcodeProfiles = std::array<OpcodeProfile, 256>;
+
+/**
+ * Execution statistics of the scripts that spend outputs with the same
+ * script template. The template of a script is its sequence of opcodes with
+ * the size but not the content of the data it pushes, so outputs of the same
+ * contract with different keys or parameters share a template.
+ */
+struct ScriptTemplateProfile {
+    uint256 templateHash;
+    //! The first script seen with this template.
+    CScript example;
+    //! Number of VerifyScript() calls and the time they took.
+    uint64_t verifications{0};
+    uint64_t nanoseconds{0};
+    OpcodeProfiles opcodes;
+};
+
+namespace script_profiler_detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool IsScriptProfilerEnabled() {
+    return script_profiler_detail::enabled.load(std::memory_order_relaxed);
+}
+
+void EnableScriptProfiler(bool enable);
+
+/**
+ * Receives the statistics of every profiled VerifyScript() call and the hash
+ * of the template they were added to, so that builds with metrics can feed
+ * them to histograms.
+ */
+using ScriptProfileObserver = std::function<void(
+    const uint256 &templateHash, const OpcodeProfiles &opcodes,
+    uint64_t nanoseconds)>;
+
+//! Must be called before the profiler is enabled.
+void SetScriptProfileObserver(ScriptProfileObserver observer);
+
+/** Hash identifying the template of a script. */
+uint256 GetScriptTemplateHash(const CScript &script);
+
+/** Profiles of all templates, most expensive first. */
+std::vector<ScriptTemplateProfile> GetScriptProfiles();
+
+void ResetScriptProfiles();
+
+/**
+ * Collects the statistics of the opcodes that the interpreter executes on
+ * this thread while the scope exists, and adds them to the profile of the
+ * template of scriptPubKey when it ends. Does nothing if the profiler is
+ * disabled.
+ */
+class CScriptProfileScope {
+public:
+    explicit CScriptProfileScope(const CScript &scriptPubKey);
+    ~CScriptProfileScope();
+
+    CScriptProfileScope(const CScriptProfileScope &) = delete;
+    CScriptProfileScope &operator=(const CScriptProfileScope &) = delete;
+
+    /** Statistics of the innermost scope on this thread, or nullptr. */
+    static OpcodeProfiles *GetCurrent() { return current; }
+
+private:
+    static thread_local OpcodeProfiles *current;
+
+    const CScript &scriptPubKey;
+    std::unique_ptr<OpcodeProfiles> opcodes;
+    OpcodeProfiles *previous{nullptr};
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // MVC_SCRIPT_SCRIPT_PROFILER_H
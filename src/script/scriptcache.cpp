@@ -5,45 +5,39 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "scriptcache.h"
+#include "clientversion.h"
 #include "crypto/sha256.h"
-#include "cuckoocache.h"
+#include "hash.h"
 #include "primitives/transaction.h"
 #include "random.h"
 #include "script/sigcache.h"
+#include "script_config.h"
+#include "streams.h"
 #include "util.h"
-#include <mutex>
+#include "utiltime.h"
 
-std::mutex cs_script_cache;
-static auto scriptExecutionCache =
-    std::make_unique<CuckooCache::cache<uint256, SignatureCacheHasher>>();
+static ShardedCuckooCache<uint256, SignatureCacheHasher, SCRIPT_CACHE_SHARDS>
+    scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
 
-static void InitScriptExecutionCacheUnlocked() 
+void InitScriptExecutionCache()
 {
     // nMaxCacheSize is unsigned. If -maxscriptcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
+    // setup_bytes creates the minimum possible cache (2 elements per shard).
     size_t nMaxCacheSize =
         std::min(static_cast<uint64_t>(std::max(int64_t(0),
                           gArgs.GetArgAsBytes("-maxscriptcachesize",
                                        DEFAULT_MAX_SCRIPT_CACHE_SIZE, ONE_MEBIBYTE))),
                  MAX_MAX_SCRIPT_CACHE_SIZE * ONE_MEBIBYTE);
-    size_t nElems = scriptExecutionCache->setup_bytes(nMaxCacheSize);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu requested for script execution cache, "
               "able to store %zu elements\n",
               (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
 }
 
-void InitScriptExecutionCache()
-{
-    std::lock_guard lock{cs_script_cache};
-    InitScriptExecutionCacheUnlocked();
-}
-
 void ClearCache() 
 {
-    std::lock_guard lock{cs_script_cache};
-    scriptExecutionCache = std::make_unique<CuckooCache::cache<uint256, SignatureCacheHasher>>();
-    InitScriptExecutionCacheUnlocked();
+    InitScriptExecutionCache();
 }
 
 uint256 GetScriptCacheKey(const CTransaction &tx, uint32_t flags) {
@@ -62,11 +56,123 @@ uint256 GetScriptCacheKey(const CTransaction &tx, uint32_t flags) {
 }
 
 bool IsKeyInScriptCache(uint256 key, bool erase) {
-    std::lock_guard lock{cs_script_cache};
-    return scriptExecutionCache->contains(key, erase);
+    return scriptExecutionCache.contains(key, erase);
 }
 
 void AddKeyInScriptCache(uint256 key) {
-    std::lock_guard lock{cs_script_cache};
-    scriptExecutionCache->insert(key);
-}
\ No newline at end of file
+    scriptExecutionCache.insert(key);
+}
+
+std::vector<CacheShardStats> GetScriptCacheStats() {
+    return scriptExecutionCache.GetShardStats();
+}
+
+/**
+ * scriptcache.dat format:
+ *
+ *   uint64  version
+ *   uint256 signature cache nonce
+ *   blocks  valid signature cache entries
+ *   blocks  invalid signature cache entries
+ *   uint256 script limits hash
+ *   uint256 script execution cache nonce
+ *   blocks  script execution cache entries
+ *
+ * where blocks are a uint64 count followed by that many entries, repeated
+ * until a count of zero.
+ */
+
+namespace {
+const uint64_t SCRIPT_CACHE_DUMP_VERSION = 1;
+
+/**
+ * Entries of the script execution cache only depend on the transaction and
+ * the script flags, but whether the scripts passed also depends on the
+ * limits they were evaluated with. Entries are only reloaded if the limits
+ * did not change.
+ */
+uint256 ScriptLimitsHash(const CScriptConfig &config) {
+    CHashWriter hasher(SER_GETHASH, 0);
+    for (const bool genesis : {false, true}) {
+        for (const bool consensus : {false, true}) {
+            hasher << config.GetMaxOpsPerScript(genesis, consensus)
+                   << config.GetMaxScriptNumLength(genesis, consensus)
+                   << config.GetMaxScriptSize(genesis, consensus)
+                   << config.GetMaxPubKeysPerMultiSig(genesis, consensus)
+                   << config.GetMaxStackMemoryUsage(genesis, consensus);
+        }
+    }
+    return hasher.GetHash();
+}
+} // namespace
+
+void DumpScriptCaches(const CScriptConfig &config) {
+    const int64_t start = GetTimeMicros();
+    try {
+        FILE *filestr =
+            fsbridge::fopen(GetDataDir() / "scriptcache.dat.new", "wb");
+        if (!filestr) {
+            return;
+        }
+
+        CAutoFile file{filestr, SER_DISK, CLIENT_VERSION};
+        file << SCRIPT_CACHE_DUMP_VERSION;
+        const size_t signatures = DumpSignatureCache(file);
+        file << ScriptLimitsHash(config);
+        file << scriptExecutionCacheNonce;
+        const size_t scripts = scriptExecutionCache.DumpElements(file);
+
+        FileCommit(file.Get());
+        file.reset();
+        RenameOver(GetDataDir() / "scriptcache.dat.new",
+                   GetDataDir() / "scriptcache.dat");
+        LogPrintf("Dumped script caches: %zu signatures and %zu script "
+                  "executions in %.6fs\n",
+                  signatures, scripts, (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump script caches: %s. Continuing anyway.\n",
+                  e.what());
+    }
+}
+
+void LoadScriptCaches(const CScriptConfig &config) {
+    const int64_t start = GetTimeMicros();
+    CAutoFile file{fsbridge::fopen(GetDataDir() / "scriptcache.dat", "rb"),
+                   SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        LogPrintf("No script cache file from previous session\n");
+        return;
+    }
+
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != SCRIPT_CACHE_DUMP_VERSION) {
+            LogPrintf("Bad script cache dump version: %d. Continuing with "
+                      "empty caches.\n",
+                      version);
+            return;
+        }
+
+        const size_t signatures = LoadSignatureCache(file);
+
+        uint256 limitsHash;
+        uint256 nonce;
+        file >> limitsHash >> nonce;
+        size_t scripts = 0;
+        if (limitsHash == ScriptLimitsHash(config)) {
+            scriptExecutionCacheNonce = nonce;
+            scripts = scriptExecutionCache.LoadElements(file);
+        } else {
+            LogPrintf("Script limits changed since the script execution cache "
+                      "was dumped, not loading it\n");
+        }
+
+        LogPrintf("Loaded script caches: %zu signatures and %zu script "
+                  "executions in %.6fs\n",
+                  signatures, scripts, (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to load script caches: %s. Continuing anyway.\n",
+                  e.what());
+    }
+}
@@ -7,10 +7,13 @@
 #ifndef MVC_SCRIPT_SCRIPTCACHE_H
 #define MVC_SCRIPT_SCRIPTCACHE_H
 
+#include "sharded_cuckoocache.h"
 #include "uint256.h"
 
 #include <cstdint>
+#include <vector>
 
+class CScriptConfig;
 class CTransaction;
 
 // DoS prevention: limit cache size to 64MB (over 2000000 entries on 64-bit
@@ -19,6 +22,10 @@ class CTransaction;
 static const unsigned int DEFAULT_MAX_SCRIPT_CACHE_SIZE = 64;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SCRIPT_CACHE_SIZE = 16384;
+// Number of independently locked parts of the cache
+static const size_t SCRIPT_CACHE_SHARDS = 16;
+// Default for -persistscriptcache
+static const bool DEFAULT_PERSIST_SCRIPT_CACHE = true;
 
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
@@ -35,4 +42,20 @@ bool IsKeyInScriptCache(uint256 key, bool erase);
 /** Add an entry in the cache. */
 void AddKeyInScriptCache(uint256 key);
 
+/** Counters of each shard of the cache. */
+std::vector<CacheShardStats> GetScriptCacheStats();
+
+/**
+ * Write the signature caches and the script execution cache to
+ * scriptcache.dat in the data directory.
+ */
+void DumpScriptCaches(const CScriptConfig &config);
+
+/**
+ * Fill the caches from scriptcache.dat, if there is one. Must be called
+ * after InitSignatureCache() and InitScriptExecutionCache() and before any
+ * script is verified.
+ */
+void LoadScriptCaches(const CScriptConfig &config);
+
 #endif // MVC_SCRIPT_SCRIPTCACHE_H
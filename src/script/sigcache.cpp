@@ -5,13 +5,19 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "sigcache.h"
-#include "cuckoocache.h"
+#include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
+#include "script/compiled_script.h"
+#include "streams.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace {
 
@@ -27,10 +33,11 @@ class CSignatureCache {
 private:
     //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    typedef ShardedCuckooCache<uint256, SignatureCacheHasher,
+                               SIGNATURE_CACHE_SHARDS>
+        map_type;
     map_type setValid;
     map_type setInvalid;
-    boost::shared_mutex cs_sigcache;
 
 public:
     CSignatureCache() { GetRandBytes(nonce.begin(), 32); }
@@ -47,28 +54,150 @@ public:
     }
 
     bool Get(const uint256 &entry, const bool erase) {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
         return setValid.contains(entry, erase);
     }
 
     bool GetInvalid(const uint256 &entry, const bool erase) {
-        boost::shared_lock lock(cs_sigcache);
         return setInvalid.contains(entry, erase);
     }
 
-    void Set(uint256 &entry) {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.insert(entry);
+    void Set(uint256 &entry) { setValid.insert(entry); }
+
+    void SetInvalid(uint256 &entry) { setInvalid.insert(entry); }
+
+    size_t setup_bytes(size_t n) { return setValid.setup_bytes(n); }
+
+    size_t setup_bytes_invalid(size_t n) { return setInvalid.setup_bytes(n); }
+
+    /** Write the nonce and the entries of both caches to s. */
+    template <typename Stream> size_t Dump(Stream &s) const {
+        s << nonce;
+        return setValid.DumpElements(s) + setInvalid.DumpElements(s);
     }
 
-    void SetInvalid(uint256 &entry) {
-        std::scoped_lock lock(cs_sigcache);
-        setInvalid.insert(entry);
+    /**
+     * Read what Dump() wrote, replacing the nonce. Entries that were added
+     * before are no longer found.
+     */
+    template <typename Stream> size_t Load(Stream &s) {
+        uint256 dumpedNonce;
+        s >> dumpedNonce;
+        nonce = dumpedNonce;
+        return setValid.LoadElements(s) + setInvalid.LoadElements(s);
     }
 
-    uint32_t setup_bytes(size_t n) { return setValid.setup_bytes(n); }
+    std::vector<CacheShardStats> GetStats() const {
+        return setValid.GetShardStats();
+    }
 
-    uint32_t setup_bytes_invalid(size_t n) { return setInvalid.setup_bytes(n); }
+    std::vector<CacheShardStats> GetInvalidStats() const {
+        return setInvalid.GetShardStats();
+    }
+};
+
+/**
+ * Bounded cache of public keys parsed by libsecp256k1, keyed by their
+ * serialization. Contract and token keys are used in many transactions of a
+ * block and the signature cache only helps for signatures seen before, so
+ * parsing and decompressing such keys again is avoided here.
+ *
+ * Keys are spread over shards, each with its own lock and least recently used
+ * eviction, so that parallel script checks rarely wait for each other.
+ */
+class CParsedPubKeyCache {
+private:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    class KeyHasher {
+    private:
+        uint64_t k0, k1;
+
+    public:
+        KeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+                      k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+        size_t operator()(const CPubKey &pubkey) const {
+            return CSipHasher(k0, k1).Write(pubkey.begin(), pubkey.size())
+                .Finalize();
+        }
+    };
+
+    using LruList = std::list<std::pair<CPubKey, CPubKey::Parsed>>;
+
+    struct Shard {
+        std::mutex mtx;
+        LruList lru;
+        std::unordered_map<CPubKey, LruList::iterator, KeyHasher> map;
+    };
+
+    std::array<Shard, NUM_SHARDS> shards;
+    KeyHasher shardHasher;
+    std::atomic<size_t> maxEntriesPerShard{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    Shard &GetShard(const CPubKey &pubkey) {
+        return shards[shardHasher(pubkey) % NUM_SHARDS];
+    }
+
+public:
+    /** Estimated memory used by one cached key. */
+    static size_t EntryUsage() {
+        return memusage::MallocUsage(sizeof(LruList::value_type) +
+                                     2 * sizeof(void *)) +
+               memusage::MallocUsage(sizeof(std::pair<const CPubKey,
+                                                      LruList::iterator>) +
+                                     2 * sizeof(void *)) +
+               sizeof(void *);
+    }
+
+    void SetMaxEntries(size_t maxEntries) {
+        maxEntriesPerShard = maxEntries / NUM_SHARDS;
+    }
+
+    bool Get(const CPubKey &pubkey, CPubKey::Parsed &parsed) {
+        Shard &shard = GetShard(pubkey);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto it = shard.map.find(pubkey);
+            if (it != shard.map.end()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                parsed = it->second->second;
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Insert(const CPubKey &pubkey, const CPubKey::Parsed &parsed) {
+        const size_t maxEntries = maxEntriesPerShard;
+        if (!maxEntries) {
+            return;
+        }
+        Shard &shard = GetShard(pubkey);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.map.count(pubkey)) {
+            // Inserted by another thread in the meantime
+            return;
+        }
+        while (shard.map.size() >= maxEntries) {
+            shard.map.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+        }
+        shard.lru.emplace_front(pubkey, parsed);
+        shard.map.emplace(pubkey, shard.lru.begin());
+    }
+
+    PubKeyCacheStats GetStats() {
+        PubKeyCacheStats stats{0, maxEntriesPerShard * NUM_SHARDS,
+                               hits.load(), misses.load()};
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            stats.entries += shard.map.size();
+        }
+        return stats;
+    }
 };
 
 /**
@@ -79,13 +208,27 @@ public:
  * signatureCache could be made local to VerifySignature.
  */
 static CSignatureCache signatureCache;
+static CParsedPubKeyCache pubKeyCache;
+
+/** Verify a signature, parsing the public key only if it is not cached. */
+bool VerifyWithPubKeyCache(const std::vector<uint8_t> &vchSig,
+                           const CPubKey &pubkey, const uint256 &sighash) {
+    CPubKey::Parsed parsed;
+    if (!pubKeyCache.Get(pubkey, parsed)) {
+        if (!pubkey.Parse(parsed)) {
+            return false;
+        }
+        pubKeyCache.Insert(pubkey, parsed);
+    }
+    return CPubKey::VerifyParsed(parsed, sighash, vchSig);
+}
 } // namespace
 
 // To be called once in AppInit2/TestingSetup to initialize the signatureCache
 
 void InitSignatureCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
+    // setup_bytes creates the minimum possible cache (2 elements per shard).
     auto initCache = [](std::string argName, unsigned int defaultSize, std::string_view type, auto& classInstance, auto callback){
       size_t nMaxCacheSize = std::min(static_cast<uint64_t>(std::max(int64_t(0), gArgs.GetArgAsBytes(argName, defaultSize, ONE_MEBIBYTE))), MAX_MAX_SIG_CACHE_SIZE * ONE_MEBIBYTE);
       auto nElems = (classInstance.*callback)(nMaxCacheSize);
@@ -95,6 +238,39 @@ void InitSignatureCache() {
 
     initCache("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE, "", signatureCache, &CSignatureCache::setup_bytes);
     initCache("-maxinvalidsigcachesize", DEFAULT_INVALID_MAX_SIG_CACHE_SIZE, "invalid ", signatureCache, &CSignatureCache::setup_bytes_invalid);
+
+    size_t nMaxPubKeyCacheSize = std::min(static_cast<uint64_t>(std::max(int64_t(0), gArgs.GetArgAsBytes("-maxpubkeycachesize", DEFAULT_MAX_PUBKEY_CACHE_SIZE, ONE_MEBIBYTE))), MAX_MAX_SIG_CACHE_SIZE * ONE_MEBIBYTE);
+    size_t nPubKeys = nMaxPubKeyCacheSize / CParsedPubKeyCache::EntryUsage();
+    pubKeyCache.SetMaxEntries(nPubKeys);
+    LogPrintf("Using %zu MiB for parsed public key cache, able to store %zu "
+              "elements\n", nMaxPubKeyCacheSize >> 20, pubKeyCache.GetStats().maxEntries);
+
+    size_t nMaxScriptProgramCacheSize = std::min(static_cast<uint64_t>(std::max(int64_t(0), gArgs.GetArgAsBytes("-maxscriptprogramcachesize", DEFAULT_MAX_SCRIPT_PROGRAM_CACHE_SIZE, ONE_MEBIBYTE))), MAX_MAX_SIG_CACHE_SIZE * ONE_MEBIBYTE);
+    InitScriptProgramCache(nMaxScriptProgramCacheSize,
+                           GetRand(std::numeric_limits<uint64_t>::max()),
+                           GetRand(std::numeric_limits<uint64_t>::max()));
+    LogPrintf("Using %zu MiB for compiled script cache\n",
+              nMaxScriptProgramCacheSize >> 20);
+}
+
+PubKeyCacheStats GetPubKeyCacheStats() {
+    return pubKeyCache.GetStats();
+}
+
+size_t DumpSignatureCache(CAutoFile &file) {
+    return signatureCache.Dump(file);
+}
+
+size_t LoadSignatureCache(CAutoFile &file) {
+    return signatureCache.Load(file);
+}
+
+std::vector<CacheShardStats> GetSignatureCacheStats() {
+    return signatureCache.GetStats();
+}
+
+std::vector<CacheShardStats> GetInvalidSignatureCacheStats() {
+    return signatureCache.GetInvalidStats();
 }
 
 
@@ -110,8 +286,7 @@ bool CachingTransactionSignatureChecker::VerifySignature(
         return false;
     }
 
-    if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey,
-                                                      sighash)) {
+    if (!VerifyWithPubKeyCache(vchSig, pubkey, sighash)) {
        
         signatureCache.SetInvalid(entry);
         return false;
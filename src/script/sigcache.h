@@ -8,6 +8,7 @@
 #define MVC_SCRIPT_SIGCACHE_H
 
 #include "script/interpreter.h"
+#include "sharded_cuckoocache.h"
 
 #include <vector>
 
@@ -24,6 +25,15 @@ static const unsigned int DEFAULT_INVALID_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
+// Number of independently locked parts of the valid and of the invalid
+// signature cache.
+static const size_t SIGNATURE_CACHE_SHARDS = 16;
+
+// Limit the cache of parsed public keys to 8MB (around 30000 keys on 64-bit
+// systems).
+static const unsigned int DEFAULT_MAX_PUBKEY_CACHE_SIZE = 8;
+
+class CAutoFile;
 class CPubKey;
 
 /**
@@ -65,4 +75,37 @@ public:
 
 void InitSignatureCache();
 
+/** Counters of the parsed public key cache, see GetPubKeyCacheStats(). */
+struct PubKeyCacheStats {
+    size_t entries;
+    size_t maxEntries;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+ * Parsed public keys are cached in front of signature verification, so that
+ * popular keys are not parsed and decompressed for every signature.
+ */
+PubKeyCacheStats GetPubKeyCacheStats();
+
+/**
+ * Write the entries of the valid and invalid signature caches and the nonce
+ * they were computed with to file. Returns the number of entries written.
+ */
+size_t DumpSignatureCache(CAutoFile &file);
+
+/**
+ * Add the entries written by DumpSignatureCache() and take over their nonce.
+ * Must be called after InitSignatureCache() and before any signature is
+ * verified. Throws if file cannot be read.
+ */
+size_t LoadSignatureCache(CAutoFile &file);
+
+/** Counters of each shard of the valid signature cache. */
+std::vector<CacheShardStats> GetSignatureCacheStats();
+
+/** Counters of each shard of the invalid signature cache. */
+std::vector<CacheShardStats> GetInvalidSignatureCacheStats();
+
 #endif // MVC_SCRIPT_SIGCACHE_H
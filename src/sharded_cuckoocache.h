@@ -0,0 +1,172 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_SHARDED_CUCKOOCACHE_H
+#define MVC_SHARDED_CUCKOOCACHE_H
+
+#include "cuckoocache.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+/** Counters of one shard of a ShardedCuckooCache. */
+struct CacheShardStats {
+    //! Number of elements the shard can hold.
+    size_t capacity;
+    //! Lookups that found the element.
+    uint64_t hits;
+    //! Lookups that did not find the element.
+    uint64_t misses;
+    uint64_t inserts;
+};
+
+/**
+ * A CuckooCache::cache split into NUM_SHARDS caches with a lock each.
+ *
+ * Lookups take the lock of their shard shared, which CuckooCache allows even
+ * when they erase, so only inserts take a lock exclusively and they only
+ * block the lookups and inserts of the same shard.
+ *
+ * The shard of an element is selected by the top bits of its hash number 7.
+ * The caches select slots with the low bits of the hashes so that the two do
+ * not overlap for caches of up to 2^(32 - log2(NUM_SHARDS)) elements per
+ * shard.
+ */
+template <typename Element, typename Hash, size_t NUM_SHARDS>
+class ShardedCuckooCache {
+    static_assert(NUM_SHARDS > 1 && (NUM_SHARDS & (NUM_SHARDS - 1)) == 0,
+                  "NUM_SHARDS must be a power of two");
+
+private:
+    using cache_type = CuckooCache::cache<Element, Hash>;
+
+    // Each shard on its own cache lines so that the counters of different
+    // shards are not shared between cores.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unique_ptr<cache_type> cache{std::make_unique<cache_type>()};
+        size_t capacity{0};
+        mutable std::atomic<uint64_t> hits{0};
+        mutable std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> inserts{0};
+    };
+
+    static constexpr uint32_t SHARD_SHIFT = [] {
+        uint32_t bits = 0;
+        while ((size_t(1) << bits) < NUM_SHARDS) {
+            ++bits;
+        }
+        return 32 - bits;
+    }();
+
+    std::array<Shard, NUM_SHARDS> shards;
+    const Hash hash_function{};
+
+    Shard &GetShard(const Element &e) {
+        return shards[hash_function.template operator()<7>(e) >> SHARD_SHIFT];
+    }
+
+public:
+    /**
+     * Split bytes evenly between the shards, see CuckooCache::setup_bytes().
+     * Drops all elements. Returns the number of elements the cache can hold.
+     */
+    size_t setup_bytes(size_t bytes) {
+        size_t total = 0;
+        for (Shard &shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            shard.cache = std::make_unique<cache_type>();
+            shard.capacity = shard.cache->setup_bytes(bytes / NUM_SHARDS);
+            total += shard.capacity;
+        }
+        return total;
+    }
+
+    bool contains(const Element &e, const bool erase) {
+        Shard &shard = GetShard(e);
+        bool found;
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mtx);
+            found = shard.cache->contains(e, erase);
+        }
+        (found ? shard.hits : shard.misses)
+            .fetch_add(1, std::memory_order_relaxed);
+        return found;
+    }
+
+    void insert(Element e) {
+        Shard &shard = GetShard(e);
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            shard.cache->insert(std::move(e));
+        }
+        shard.inserts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Write the elements that have not been erased to s, as blocks of a
+     * uint64_t count followed by the elements, ending with an empty block.
+     * Returns the number of elements written.
+     */
+    template <typename Stream> size_t DumpElements(Stream &s) const {
+        size_t total = 0;
+        std::vector<Element> elements;
+        for (const Shard &shard : shards) {
+            elements.clear();
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mtx);
+                shard.cache->for_each(
+                    [&elements](const Element &e) { elements.push_back(e); });
+            }
+            if (elements.empty()) {
+                continue;
+            }
+            s << uint64_t(elements.size());
+            for (const Element &e : elements) {
+                s << e;
+            }
+            total += elements.size();
+        }
+        s << uint64_t(0);
+        return total;
+    }
+
+    /**
+     * Insert the elements written by DumpElements(). Returns the number of
+     * elements read.
+     */
+    template <typename Stream> size_t LoadElements(Stream &s) {
+        size_t total = 0;
+        uint64_t count;
+        s >> count;
+        while (count) {
+            for (uint64_t i = 0; i < count; ++i) {
+                Element e;
+                s >> e;
+                insert(std::move(e));
+            }
+            total += count;
+            s >> count;
+        }
+        return total;
+    }
+
+    std::vector<CacheShardStats> GetShardStats() const {
+        std::vector<CacheShardStats> stats;
+        stats.reserve(NUM_SHARDS);
+        for (const Shard &shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mtx);
+            stats.push_back({shard.capacity, shard.hits.load(),
+                             shard.misses.load(), shard.inserts.load()});
+        }
+        return stats;
+    }
+};
+
+#endif // MVC_SHARDED_CUCKOOCACHE_H
@@ -0,0 +1,229 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_SUPPORT_ALLOCATORS_POOL_H
+#define MVC_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A memory resource that carves small allocations out of large chunks and
+ * keeps a free list for every allocation size, so that node based containers
+ * pay neither the per allocation overhead of malloc nor its cost.
+ *
+ * Allocations of up to MAX_BLOCK_SIZE_BYTES with an alignment of up to
+ * ALIGN_BYTES are rounded up to a multiple of ALIGN_BYTES and served from the
+ * chunks, all others are passed to operator new. Memory served from the
+ * chunks is only given back to the system when the resource is destroyed;
+ * deallocated blocks are reused for allocations of the same size.
+ *
+ * Chunks start small so that short lived containers with a few elements stay
+ * cheap, and double in size up to MAX_CHUNK_SIZE_BYTES.
+ *
+ * Not thread safe, like the containers that use it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource final {
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0,
+                  "ALIGN_BYTES must be a power of two");
+
+    //! A deallocated block, linked into the free list of its size.
+    struct ListNode {
+        ListNode *next;
+    };
+
+    static constexpr std::size_t ELEM_ALIGN_BYTES =
+        std::max(alignof(ListNode), ALIGN_BYTES);
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES,
+                  "free list nodes must fit into the smallest block");
+
+public:
+    static constexpr std::size_t MIN_CHUNK_SIZE_BYTES = 4096;
+    static constexpr std::size_t MAX_CHUNK_SIZE_BYTES = 262144;
+
+    PoolResource() = default;
+
+    ~PoolResource() {
+        for (std::byte *chunk : mChunks) {
+            ::operator delete(chunk, std::align_val_t{ELEM_ALIGN_BYTES});
+        }
+    }
+
+    PoolResource(const PoolResource &) = delete;
+    PoolResource &operator=(const PoolResource &) = delete;
+
+    void *Allocate(std::size_t bytes, std::size_t alignment) {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes, std::align_val_t{alignment});
+        }
+
+        const std::size_t numElems = NumElemAlignBytes(bytes);
+        if (ListNode *node = mFreeLists[numElems]) {
+            mFreeLists[numElems] = node->next;
+            node->~ListNode();
+            return node;
+        }
+
+        const std::size_t roundedBytes = numElems * ELEM_ALIGN_BYTES;
+        if (std::size_t(mAvailableEnd - mAvailableBegin) < roundedBytes) {
+            AllocateChunk();
+        }
+        void *block = mAvailableBegin;
+        mAvailableBegin += roundedBytes;
+        return block;
+    }
+
+    void Deallocate(void *p, std::size_t bytes,
+                    std::size_t alignment) noexcept {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p, std::align_val_t{alignment});
+            return;
+        }
+        AddToFreeList(p, NumElemAlignBytes(bytes));
+    }
+
+    //! Memory allocated from the system for the chunks, in bytes.
+    std::size_t DynamicMemoryUsage() const {
+        return mChunkBytes + mChunks.capacity() * sizeof(std::byte *);
+    }
+
+    std::size_t NumAllocatedChunks() const { return mChunks.size(); }
+
+private:
+    static constexpr bool IsFreeListUsable(std::size_t bytes,
+                                           std::size_t alignment) {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    //! Number of ELEM_ALIGN_BYTES units needed for bytes, at least one.
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes) {
+        return std::max<std::size_t>(
+            1, (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES);
+    }
+
+    void AddToFreeList(void *p, std::size_t numElems) {
+        mFreeLists[numElems] = new (p) ListNode{mFreeLists[numElems]};
+    }
+
+    void AllocateChunk() {
+        // The rest of the current chunk is a multiple of ELEM_ALIGN_BYTES
+        // that is too small for the request but may serve smaller ones.
+        const std::size_t remaining = mAvailableEnd - mAvailableBegin;
+        if (remaining > 0) {
+            AddToFreeList(mAvailableBegin, remaining / ELEM_ALIGN_BYTES);
+        }
+
+        const std::size_t chunkBytes =
+            mChunks.empty()
+                ? MIN_CHUNK_SIZE_BYTES
+                : std::min(MAX_CHUNK_SIZE_BYTES, mLastChunkBytes * 2);
+        mChunks.reserve(mChunks.size() + 1);
+        std::byte *chunk = static_cast<std::byte *>(
+            ::operator new(chunkBytes, std::align_val_t{ELEM_ALIGN_BYTES}));
+        mChunks.push_back(chunk);
+        mChunkBytes += chunkBytes;
+        mLastChunkBytes = chunkBytes;
+        mAvailableBegin = chunk;
+        mAvailableEnd = chunk + chunkBytes;
+    }
+
+    static_assert(MAX_BLOCK_SIZE_BYTES <= MIN_CHUNK_SIZE_BYTES,
+                  "blocks must fit into a chunk");
+
+    //! Free lists indexed by block size in ELEM_ALIGN_BYTES units.
+    std::array<ListNode *, MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1>
+        mFreeLists{};
+
+    std::vector<std::byte *> mChunks;
+    std::size_t mChunkBytes{0};
+    std::size_t mLastChunkBytes{0};
+
+    //! The part of the newest chunk that has not been handed out yet.
+    std::byte *mAvailableBegin{nullptr};
+    std::byte *mAvailableEnd{nullptr};
+};
+
+/**
+ * A standard allocator that allocates from a PoolResource.
+ *
+ * The resource is shared by the copies of an allocator, including the ones a
+ * container rebinds for its nodes and buckets, and lives as long as any of
+ * them. A default constructed allocator creates a new resource, so every
+ * container gets its own pool unless it is handed the allocator of another
+ * one. Allocators are propagated on move assignment and swap, so memory moves
+ * along with the elements.
+ */
+template <typename T, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES = alignof(void *)>
+class PoolAllocator {
+public:
+    using value_type = T;
+    using ResourceType = PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template <typename U> struct rebind {
+        using other = PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+    };
+
+    PoolAllocator() : mResource{std::make_shared<ResourceType>()} {}
+
+    // No move constructor on purpose, a moved from allocator keeps its
+    // resource so that the container it belongs to stays usable.
+    PoolAllocator(const PoolAllocator &other) noexcept = default;
+    PoolAllocator &operator=(const PoolAllocator &other) noexcept = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>
+                      &other) noexcept
+        : mResource{other.GetResource()} {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(
+            mResource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        mResource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    //! Copies of a container get a pool of their own.
+    PoolAllocator select_on_container_copy_construction() const {
+        return PoolAllocator{};
+    }
+
+    const std::shared_ptr<ResourceType> &GetResource() const {
+        return mResource;
+    }
+
+private:
+    std::shared_ptr<ResourceType> mResource;
+};
+
+template <typename T1, typename T2, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES>
+bool operator==(
+    const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a,
+    const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept {
+    return a.GetResource() == b.GetResource();
+}
+
+template <typename T1, typename T2, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES>
+bool operator!=(
+    const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a,
+    const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept {
+    return !(a == b);
+}
+
+#endif // MVC_SUPPORT_ALLOCATORS_POOL_H
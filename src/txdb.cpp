@@ -9,15 +9,18 @@
 #include "block_file_info.h"
 #include "chainparams.h"
 #include "config.h"
+#include "dbcompaction.h"
 #include "disk_block_index.h"
 #include "disk_tx_pos.h"
 #include "hash.h"
 #include "init.h"
 #include "pow.h"
 #include "random.h"
+#include "task_helpers.h"
 #include "uint256.h"
 #include "util.h"
 #include "ui_interface.h"
+#include "utiltime.h"
 #include <boost/thread.hpp>
 #include <string>
 #include <vector>
@@ -33,6 +36,8 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_SET_HASH = 'U';
+static const char DB_SNAPSHOT_LOAD = 'S';
 
 namespace {
 
@@ -57,6 +62,13 @@ struct CoinEntry {
         *outpoint = COutPoint(id, n);
     }
 };
+
+//! The coin with the script rebuilt from its compact form.
+CoinWithScript ExpandCoin(const CoinImpl& coin, const CompactScript& script) {
+    return CoinWithScript::MakeOwning(
+        CTxOut{coin.GetTxOut().nValue, script.Expand()}, coin.GetHeight(),
+        coin.IsCoinBase());
+}
 } // namespace
 
 namespace {
@@ -102,6 +114,26 @@ struct CDataStreamInput_NoScr : TBase
     bool wasUnserializeScriptCalled;
 };
 
+/**
+ * The coin read with CDataStreamInput_NoScr, without its script if the
+ * script was not unserialized.
+ */
+CoinImpl FromStoredCoin(CoinImpl&& coin, const std::optional<std::size_t>& actualScriptSize)
+{
+    if(actualScriptSize.has_value())
+    {
+        // Script was not unserialized
+        return
+            CoinImpl{
+                coin.GetTxOut().nValue,
+                *actualScriptSize,
+                coin.GetHeight(),
+                coin.IsCoinBase()};
+    }
+
+    return std::move(coin);
+}
+
 } // anonymous namespace
 
 /**
@@ -149,18 +181,7 @@ std::optional<CoinImpl> CoinsDB::DBGetCoin(const COutPoint &outpoint, uint64_t m
         bool res = db.Read<CDataStreamInput_NoScr>(CoinEntry(&outpoint), coin.value(), maxScriptSize, actualScriptSize);
         if( res )
         {
-            if(actualScriptSize.has_value())
-            {
-                // Script was not unserialized
-                return {
-                    CoinImpl{
-                        coin->GetTxOut().nValue,
-                        *actualScriptSize,
-                        coin->GetHeight(),
-                        coin->IsCoinBase()}};
-            }
-
-            return coin;
+            return FromStoredCoin(std::move(coin.value()), actualScriptSize);
         }
 
         return {};
@@ -178,6 +199,43 @@ std::optional<CoinImpl> CoinsDB::DBGetCoin(const COutPoint &outpoint, uint64_t m
     }
 }
 
+std::vector<std::optional<CoinImpl>> CoinsDB::DBGetCoins(
+    const std::vector<COutPoint>& outpoints,
+    uint64_t maxScriptSize) const
+{
+    std::vector<std::optional<CoinImpl>> coins(outpoints.size());
+    std::vector<CoinEntry> keys;
+    keys.reserve(outpoints.size());
+    for (const COutPoint& outpoint : outpoints)
+    {
+        keys.emplace_back(&outpoint);
+    }
+
+    try
+    {
+        db.ReadMany(
+            keys,
+            [maxScriptSize, &coins](size_t i, CDBIterator& it)
+            {
+                CoinImpl coin;
+                std::optional<std::size_t> actualScriptSize;
+                if (it.GetValue<CDataStreamInput_NoScr>(coin, maxScriptSize, actualScriptSize))
+                {
+                    coins[i] = FromStoredCoin(std::move(coin), actualScriptSize);
+                }
+            });
+    } catch (const std::runtime_error &e) {
+        // See DBGetCoin().
+        uiInterface.ThreadSafeMessageBox(
+            _("Error reading from database, shutting down."), "",
+            CClientUIInterface::MSG_ERROR);
+        LogPrintf("Error reading from database: %s\n", e.what());
+        abort();
+    }
+
+    return coins;
+}
+
 uint256 CoinsDB::DBGetBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain)) return uint256();
@@ -192,7 +250,10 @@ std::vector<uint256> CoinsDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CoinsDB::DBBatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CoinsDB::DBBatchWrite(
+    const FlushedCoins& flushed,
+    const uint256 &hashBlock,
+    const std::optional<UtxoSetHash>& utxoSetHash) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -218,35 +279,43 @@ bool CoinsDB::DBBatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.GetCoin().IsSpent()) {
-                batch.Erase(entry);
-            } else {
-                auto coinWithScript = it->second.GetCoinWithScript();
-
-                // coin entries that have DIRTY flag set and are not spent must
-                // always contain the script
-                assert(coinWithScript.has_value());
-
-                batch.Write(entry, coinWithScript.value());
+    for (size_t stripe = 0; stripe < NUM_CACHE_STRIPES; ++stripe) {
+        const CCoinsMap& mapCoins = flushed.coins[stripe];
+        const CompactScriptMap& compactScripts = flushed.compactScripts[stripe];
+        for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+            if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+                CoinEntry entry(&it->first);
+                if (it->second.GetCoin().IsSpent()) {
+                    batch.Erase(entry);
+                } else {
+                    auto coinWithScript = it->second.GetCoinWithScript();
+
+                    // coin entries that have DIRTY flag set and are not spent must
+                    // always contain the script or have it in compactScripts
+                    if (coinWithScript.has_value()) {
+                        batch.Write(entry, coinWithScript.value());
+                    } else {
+                        auto compact = compactScripts.find(it->first);
+                        assert(compact != compactScripts.end());
+                        batch.Write(entry,
+                                    ExpandCoin(it->second.GetCoinImpl(),
+                                               compact->second));
+                    }
+                }
+                changed++;
             }
-            changed++;
-        }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
-        if (batch.SizeEstimate() > batch_size) {
-            LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n",
-                     batch.SizeEstimate() * (1.0 / 1048576.0));
-            db.WriteBatch(batch);
-            batch.Clear();
-            if (crash_simulate) {
-                static FastRandomContext rng;
-                if (rng.randrange(crash_simulate) == 0) {
-                    LogPrintf("Simulating a crash. Goodbye.\n");
-                    _Exit(0);
+            count++;
+            if (batch.SizeEstimate() > batch_size) {
+                LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n",
+                         batch.SizeEstimate() * (1.0 / 1048576.0));
+                db.WriteBatch(batch);
+                batch.Clear();
+                if (crash_simulate) {
+                    static FastRandomContext rng;
+                    if (rng.randrange(crash_simulate) == 0) {
+                        LogPrintf("Simulating a crash. Goodbye.\n");
+                        _Exit(0);
+                    }
                 }
             }
         }
@@ -255,6 +324,11 @@ bool CoinsDB::DBBatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (utxoSetHash.has_value()) {
+        batch.Write(DB_UTXO_SET_HASH, std::make_pair(hashBlock, *utxoSetHash));
+    } else {
+        batch.Erase(DB_UTXO_SET_HASH);
+    }
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n",
              batch.SizeEstimate() * (1.0 / 1048576.0));
@@ -269,6 +343,10 @@ size_t CoinsDB::EstimateSize() const {
     return db.EstimateSize(DB_COIN, char(DB_COIN + 1));
 }
 
+void CoinsDB::AddCompactionRanges(CDBCompactionController& controller) const {
+    controller.AddRange("chainstate", db, DB_COIN);
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe)
     : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory,
                  fWipe) {}
@@ -294,6 +372,8 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewDBCursor *CoinsDB::Cursor() const {
+    // The coins of a background flush are not in the database yet.
+    WaitForFlush();
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(
         const_cast<CDBWrapper &>(db).NewIterator(), GetBestBlock());
     /**
@@ -316,6 +396,7 @@ CCoinsViewDBCursor *CoinsDB::Cursor() const {
 
 // Same as CCoinsViewCursor::Cursor() with added Seek() to key txId
 CCoinsViewDBCursor* CoinsDB::Cursor(const TxId &txId) const {
+    WaitForFlush();
     CCoinsViewDBCursor* i = new CCoinsViewDBCursor(
         const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     
@@ -432,6 +513,25 @@ bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
     return Read(std::make_pair(DB_TXINDEX, txid), pos);
 }
 
+std::vector<std::optional<CDiskTxPos>> CBlockTreeDB::ReadTxIndex(
+    const std::vector<uint256> &txids) {
+    std::vector<std::optional<CDiskTxPos>> positions(txids.size());
+    std::vector<std::pair<char, uint256>> keys;
+    keys.reserve(txids.size());
+    for (const uint256 &txid : txids) {
+        keys.emplace_back(DB_TXINDEX, txid);
+    }
+
+    ReadMany(keys, [&positions](size_t i, CDBIterator &it) {
+        CDiskTxPos pos;
+        if (it.GetValue(pos)) {
+            positions[i] = pos;
+        }
+    });
+
+    return positions;
+}
+
 bool CBlockTreeDB::WriteTxIndex(
     const std::vector<std::pair<uint256, CDiskTxPos>> &vect) {
     CDBBatch batch(*this);
@@ -442,6 +542,14 @@ bool CBlockTreeDB::WriteTxIndex(
     return WriteBatch(batch);
 }
 
+void CBlockTreeDB::AddCompactionRanges(CDBCompactionController &controller,
+                                       bool txIndex) const {
+    controller.AddRange("blockindex", *this, DB_BLOCK_INDEX);
+    if (txIndex) {
+        controller.AddRange("txindex", *this, DB_TXINDEX);
+    }
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -477,19 +585,109 @@ CoinsDB::CoinsDB(
         bool fWipe)
     : db{ GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, maxFiles }
     , mCacheSizeThreshold{cacheSizeThreshold}
-{}
+{
+    const uint256 bestBlock = DBGetBestBlock();
+    std::pair<uint256, UtxoSetHash> stored;
+    if (bestBlock.IsNull())
+    {
+        // A new database holds the empty set, unless a flush was interrupted
+        // and has to be replayed.
+        if (GetHeadBlocks().empty())
+        {
+            mUtxoSetHashBlock = uint256{};
+        }
+    }
+    else if (db.Read(DB_UTXO_SET_HASH, stored) && stored.first == bestBlock)
+    {
+        mUtxoSetHashBlock = stored.first;
+        mUtxoSetHash = stored.second;
+    }
+}
+
+CoinsDB::~CoinsDB()
+{
+    WaitForFlush();
+}
 
 size_t CoinsDB::DynamicMemoryUsage() const {
-    std::unique_lock lock { mCoinsViewCacheMtx };
-    return mCache.DynamicMemoryUsage();
+    return mCacheUsage.load() + mScriptBodies.DynamicMemoryUsage();
+}
+
+std::vector<CoinsCacheStripeStats> CoinsDB::GetCacheStripeStats() const {
+    std::vector<CoinsCacheStripeStats> stats;
+    stats.reserve(NUM_CACHE_STRIPES);
+    for (CacheStripe& stripe : mStripes) {
+        size_t coins;
+        size_t compactScripts;
+        {
+            // Not counted, the stats should not change by being read.
+            std::unique_lock lock { stripe.mtx };
+            coins = stripe.coins.CachedCoinsCount();
+            compactScripts = stripe.compactScripts.size();
+        }
+        stats.push_back({coins, compactScripts, stripe.locks.load(),
+                         stripe.contended.load(), stripe.waitMicros.load()});
+    }
+    return stats;
+}
+
+std::unique_lock<std::mutex> CoinsDB::LockStripe(CacheStripe& stripe) const {
+    stripe.locks.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock lock { stripe.mtx, std::try_to_lock };
+    if (!lock.owns_lock()) {
+        const int64_t start = GetTimeMicros();
+        lock.lock();
+        stripe.contended.fetch_add(1, std::memory_order_relaxed);
+        stripe.waitMicros.fetch_add(GetTimeMicros() - start,
+                                    std::memory_order_relaxed);
+    }
+    return lock;
+}
+
+void CoinsDB::UpdateUsage(CacheStripe& stripe) const {
+    const size_t usage = stripe.coins.DynamicMemoryUsage() +
+                         memusage::DynamicUsage(stripe.compactScripts) +
+                         stripe.compactScriptsUsage;
+    // Wraps around when the usage shrinks, which adds the difference.
+    mCacheUsage.fetch_add(usage - stripe.usage);
+    stripe.usage = usage;
+}
+
+bool CoinsDB::TryCompactScript(
+    CacheStripe& stripe,
+    const COutPoint& outpoint,
+    const CScript& script) const
+{
+    auto compact = mScriptBodies.Compact(script);
+    if (!compact.has_value())
+    {
+        return false;
+    }
+
+    auto [it, inserted] = stripe.compactScripts.emplace(outpoint, std::move(compact.value()));
+    assert(inserted);
+    stripe.compactScriptsUsage += it->second.DynamicMemoryUsage();
+
+    return true;
+}
+
+void CoinsDB::EraseCompactScript(CacheStripe& stripe, const COutPoint& outpoint) const
+{
+    if (auto it = stripe.compactScripts.find(outpoint); it != stripe.compactScripts.end())
+    {
+        stripe.compactScriptsUsage -= it->second.DynamicMemoryUsage();
+        stripe.compactScripts.erase(it);
+    }
 }
 
 std::optional<CoinImpl> CoinsDB::GetCoin(const COutPoint &outpoint, uint64_t maxScriptSize) const {
+    CacheStripe& stripe = mStripes[GetStripeIndex(outpoint)];
+
     auto erase =
-        [this](const COutPoint* outpoint)
+        [this, &stripe](const COutPoint* outpoint)
         {
-            std::unique_lock lock{ mCoinsViewCacheMtx };
-            mFetchingCoins.erase(*outpoint);
+            auto lock = LockStripe(stripe);
+            stripe.fetchingCoins.erase(*outpoint);
         };
     std::unique_ptr<const COutPoint, decltype(erase)> guard{&outpoint, erase};
 
@@ -499,9 +697,9 @@ std::optional<CoinImpl> CoinsDB::GetCoin(const COutPoint &outpoint, uint64_t max
     while(true)
     {
         {
-            std::unique_lock lock { mCoinsViewCacheMtx };
+            auto lock = LockStripe(stripe);
 
-            coinFromCache = mCache.FetchCoin(outpoint);
+            coinFromCache = stripe.coins.FetchCoin(outpoint);
 
             if (coinFromCache.has_value())
             {
@@ -531,10 +729,18 @@ std::optional<CoinImpl> CoinsDB::GetCoin(const COutPoint &outpoint, uint64_t max
                             coinFromCache->GetHeight(),
                             coinFromCache->IsCoinBase()};
                 }
+                else if (auto compact = stripe.compactScripts.find(outpoint);
+                         compact != stripe.compactScripts.end())
+                {
+                    guard.release();
+
+                    return CoinImpl::FromCoinWithScript(
+                        ExpandCoin(coinFromCache.value(), compact->second));
+                }
             }
-            if(!mFetchingCoins.count(outpoint))
+            if(!stripe.fetchingCoins.count(outpoint))
             {
-                mFetchingCoins.insert(outpoint);
+                stripe.fetchingCoins.insert(outpoint);
 
                 // it can happen that we'll get multiple requests and unnecessarily
                 // load more scripts than needed but that should be rare enough
@@ -565,19 +771,25 @@ std::optional<CoinImpl> CoinsDB::GetCoin(const COutPoint &outpoint, uint64_t max
 
     // Only one thread can reach this point for each distinct outpoint – this
     // will perform a read from the backing view and remove the outpoint from
-    // mFetchcingCoins when local variable “guard” goes out of scope so that
+    // fetchingCoins when local variable “guard” goes out of scope so that
     // the rare potential other threads that are waiting for the same outpoint
     // may continue.
 
-    auto coinFromView = DBGetCoin(outpoint, maxScriptLoadingSize);
+    // Coins that a background flush is writing may not be in the database
+    // yet, or still be there although they were spent.
+    std::optional<CoinImpl> coinFromView;
+    if (!FindFlushedCoin(outpoint, coinFromView))
+    {
+        coinFromView = DBGetCoin(outpoint, maxScriptLoadingSize);
+    }
     if (!coinFromView.has_value())
     {
         return {};
     }
 
-    std::unique_lock lock { mCoinsViewCacheMtx };
+    auto lock = LockStripe(stripe);
 
-    mFetchingCoins.erase(outpoint);
+    stripe.fetchingCoins.erase(outpoint);
     guard.release();
 
     if (coinFromCache.has_value())
@@ -586,51 +798,248 @@ std::optional<CoinImpl> CoinsDB::GetCoin(const COutPoint &outpoint, uint64_t max
 
         if (hasSpaceForScript(coinFromView.value().GetScriptSize()))
         {
-            return mCache.ReplaceWithCoinWithScript(outpoint, std::move(coinFromView.value())).MakeNonOwning();
+            if (TryCompactScript(stripe, outpoint, coinFromView->GetTxOut().scriptPubKey))
+            {
+                UpdateUsage(stripe);
+
+                return coinFromView;
+            }
+
+            auto coin = stripe.coins.ReplaceWithCoinWithScript(outpoint, std::move(coinFromView.value())).MakeNonOwning();
+            UpdateUsage(stripe);
+
+            return coin;
         }
 
         return coinFromView;
     }
 
-    if (!hasSpaceForScript(coinFromView->GetScriptSize()))
+    return AddFetchedCoin(stripe, outpoint, std::move(coinFromView.value()));
+}
+
+CoinImpl CoinsDB::AddFetchedCoin(
+    CacheStripe& stripe,
+    const COutPoint& outpoint,
+    CoinImpl&& coin) const
+{
+    if (!hasSpaceForScript(coin.GetScriptSize()) ||
+        TryCompactScript(stripe, outpoint, coin.GetTxOut().scriptPubKey))
     {
-        mCache.AddCoin(
+        stripe.coins.AddCoin(
             outpoint,
             CoinImpl{
-                coinFromView->GetTxOut().nValue,
-                coinFromView->GetScriptSize(),
-                coinFromView->GetHeight(),
-                coinFromView->IsCoinBase()});
+                coin.GetTxOut().nValue,
+                coin.GetScriptSize(),
+                coin.GetHeight(),
+                coin.IsCoinBase()});
+        UpdateUsage(stripe);
 
-        return coinFromView;
+        return std::move(coin);
     }
 
-    auto& cws = mCache.AddCoin(outpoint, std::move(coinFromView.value()));
+    auto& cws = stripe.coins.AddCoin(outpoint, std::move(coin));
     assert(cws.IsStorageOwner());
+    auto cached = cws.MakeNonOwning();
+    UpdateUsage(stripe);
+
+    return cached;
+}
+
+std::vector<std::optional<CoinImpl>> CoinsDB::GetCoins(
+    const std::vector<COutPoint>& outpoints,
+    uint64_t maxScriptSize) const
+{
+    std::vector<std::optional<CoinImpl>> coins(outpoints.size());
+
+    // Claim the coins that are neither cached nor being loaded, the others
+    // are left to GetCoin().
+    std::vector<size_t> claimed;
+    std::vector<bool> isClaimed(outpoints.size(), false);
+    for (size_t i = 0; i < outpoints.size(); ++i)
+    {
+        CacheStripe& stripe = mStripes[GetStripeIndex(outpoints[i])];
+        auto lock = LockStripe(stripe);
+        if (!stripe.coins.FetchCoin(outpoints[i]).has_value() &&
+            stripe.fetchingCoins.insert(outpoints[i]).second)
+        {
+            claimed.push_back(i);
+            isClaimed[i] = true;
+        }
+    }
+
+    auto release =
+        [this, &outpoints](std::vector<size_t>* claimed)
+        {
+            for (size_t i : *claimed)
+            {
+                CacheStripe& stripe = mStripes[GetStripeIndex(outpoints[i])];
+                auto lock = LockStripe(stripe);
+                stripe.fetchingCoins.erase(outpoints[i]);
+            }
+        };
+    std::unique_ptr<std::vector<size_t>, decltype(release)> guard{&claimed, release};
 
-    return cws.MakeNonOwning();
+    if (!claimed.empty())
+    {
+        // As in GetCoin(), coins of a background flush are taken from the
+        // flush and only the rest is read from the database.
+        std::vector<COutPoint> toRead;
+        std::vector<size_t> toReadIndex;
+        for (size_t i : claimed)
+        {
+            if (!FindFlushedCoin(outpoints[i], coins[i]))
+            {
+                toRead.push_back(outpoints[i]);
+                toReadIndex.push_back(i);
+            }
+        }
+        auto read = DBGetCoins(toRead, getMaxScriptLoadingSize(maxScriptSize));
+        for (size_t j = 0; j < read.size(); ++j)
+        {
+            coins[toReadIndex[j]] = std::move(read[j]);
+        }
+
+        for (size_t i : claimed)
+        {
+            CacheStripe& stripe = mStripes[GetStripeIndex(outpoints[i])];
+            auto lock = LockStripe(stripe);
+            stripe.fetchingCoins.erase(outpoints[i]);
+            if (coins[i].has_value())
+            {
+                coins[i] = AddFetchedCoin(stripe, outpoints[i], std::move(coins[i].value()));
+            }
+        }
+    }
+    guard.release();
+
+    for (size_t i = 0; i < outpoints.size(); ++i)
+    {
+        if (!isClaimed[i])
+        {
+            coins[i] = GetCoin(outpoints[i], maxScriptSize);
+        }
+    }
+
+    return coins;
 }
 
 bool CoinsDB::HaveCoinInCache(const COutPoint &outpoint) const {
-    std::unique_lock lock { mCoinsViewCacheMtx };
-    return mCache.FetchCoin(outpoint).has_value();
+    CacheStripe& stripe = mStripes[GetStripeIndex(outpoint)];
+    auto lock = LockStripe(stripe);
+    return stripe.coins.FetchCoin(outpoint).has_value();
 }
 
 uint256 CoinsDB::GetBestBlock() const {
-    std::unique_lock lock { mCoinsViewCacheMtx };
+    std::unique_lock lock { mHashBlockMtx };
     if (hashBlock.IsNull()) {
         hashBlock = DBGetBestBlock();
     }
     return hashBlock;
 }
 
+std::optional<std::pair<uint256, UtxoSetHash>> CoinsDB::GetUtxoSetHash() const {
+    // Loads the best block from the database if it was not loaded yet.
+    GetBestBlock();
+    std::unique_lock lock { mHashBlockMtx };
+    AddPendingUtxoSetHashChanges();
+    if (mUtxoSetHashBlock != hashBlock) {
+        return {};
+    }
+    return std::make_pair(hashBlock, mUtxoSetHash);
+}
+
+void CoinsDB::AddPendingUtxoSetHashChanges() const {
+    if (mUtxoSetHashPending.empty()) {
+        return;
+    }
+    if (!::AddPendingUtxoSetHashChanges(mUtxoSetHash, mUtxoSetHashPending) &&
+        mUtxoSetHashBlock.has_value()) {
+        LogPrintf("Failed to hash the UTXO set change of a block, the UTXO "
+                  "set hash is recomputed by the next gettxoutsetinfo "
+                  "muhash\n");
+        mUtxoSetHashBlock.reset();
+    }
+}
+
+bool CoinsDB::SetUtxoSetHash(const uint256& block, const UtxoSetHash& utxoSetHash) {
+    WPUSMutex::Lock writeLock = mMutex.WriteLock();
+    // A background flush writes the best block and the hash it knew of.
+    WaitForFlush();
+    if (GetBestBlock() != block) {
+        return false;
+    }
+    {
+        std::unique_lock lock { mHashBlockMtx };
+        mUtxoSetHash = utxoSetHash;
+        mUtxoSetHashPending.clear();
+        mUtxoSetHashBlock = block;
+    }
+    // Otherwise it is written by the next flush.
+    if (DBGetBestBlock() == block) {
+        db.Write(DB_UTXO_SET_HASH, std::make_pair(block, utxoSetHash));
+    }
+    return true;
+}
+
+bool CoinsDB::BeginSnapshotLoad(const uint256& block) {
+    WPUSMutex::Lock writeLock = mMutex.WriteLock();
+    if (!GetBestBlock().IsNull() || !GetHeadBlocks().empty()) {
+        return false;
+    }
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COIN);
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    if (pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN) {
+        return false;
+    }
+
+    {
+        std::unique_lock lock { mHashBlockMtx };
+        mUtxoSetHashPending.clear();
+        mUtxoSetHashBlock.reset();
+    }
+    return db.Write(DB_SNAPSHOT_LOAD, block, true);
+}
+
+bool CoinsDB::WriteSnapshotCoins(
+    const std::vector<std::pair<COutPoint, CoinWithScript>>& coins) {
+    CDBBatch batch(db);
+    for (const auto& [outpoint, coin] : coins) {
+        batch.Write(CoinEntry(&outpoint), coin);
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CoinsDB::FinishSnapshotLoad(const uint256& block, const UtxoSetHash& utxoSetHash) {
+    WPUSMutex::Lock writeLock = mMutex.WriteLock();
+    CDBBatch batch(db);
+    batch.Erase(DB_SNAPSHOT_LOAD);
+    batch.Write(DB_BEST_BLOCK, block);
+    batch.Write(DB_UTXO_SET_HASH, std::make_pair(block, utxoSetHash));
+    if (!db.WriteBatch(batch, true)) {
+        return false;
+    }
+
+    std::unique_lock lock { mHashBlockMtx };
+    hashBlock = block;
+    mUtxoSetHash = utxoSetHash;
+    mUtxoSetHashPending.clear();
+    mUtxoSetHashBlock = block;
+    return true;
+}
+
+bool CoinsDB::IsSnapshotLoadIncomplete() const {
+    return db.Exists(DB_SNAPSHOT_LOAD);
+}
+
 bool CoinsDB::BatchWrite(
     const WPUSMutex::Lock& writeLock,
     const uint256& hashBlockIn,
-    CCoinsMap&& mapCoins)
+    CCoinsMap&& mapCoins,
+    std::optional<UtxoSetHashDelta>&& utxoSetHashDelta)
 {
     assert( writeLock.GetLockType() == WPUSMutex::Lock::Type::write );
-    std::unique_lock lock { mCoinsViewCacheMtx };
 
     if(hashBlockIn.IsNull())
     {
@@ -638,38 +1047,276 @@ bool CoinsDB::BatchWrite(
     }
     else
     {
-        mCache.BatchWrite(mapCoins);
+        const uint256 hashBlockOld = GetBestBlock();
+
+        bool changed = false;
+        std::array<CCoinsMap, NUM_CACHE_STRIPES> stripeCoins;
+        for (auto& entry : mapCoins)
+        {
+            changed = changed || (entry.second.flags & CCoinsCacheEntry::DIRTY);
+            stripeCoins[GetStripeIndex(entry.first)].emplace(
+                entry.first, std::move(entry.second));
+        }
+        mapCoins.clear();
+
+        for (size_t i = 0; i < NUM_CACHE_STRIPES; ++i)
+        {
+            if (stripeCoins[i].empty())
+            {
+                continue;
+            }
+            CacheStripe& stripe = mStripes[i];
+            auto lock = LockStripe(stripe);
+
+            // The written coins replace the cached ones, together with their
+            // compact scripts. New coins with large scripts get compacted
+            // once they are in the cache.
+            std::vector<COutPoint> compacted;
+            for (const auto& entry : stripeCoins[i])
+            {
+                if (!(entry.second.flags & CCoinsCacheEntry::DIRTY))
+                {
+                    continue;
+                }
+                EraseCompactScript(stripe, entry.first);
+
+                const CoinImpl& coin = entry.second.GetCoinImpl();
+                if (!coin.IsSpent() && coin.HasScript() && coin.IsStorageOwner() &&
+                    TryCompactScript(stripe, entry.first, coin.GetTxOut().scriptPubKey))
+                {
+                    compacted.push_back(entry.first);
+                }
+            }
+
+            stripe.coins.BatchWrite(stripeCoins[i]);
+            for (const COutPoint& outpoint : compacted)
+            {
+                stripe.coins.RemoveScript(outpoint);
+            }
+            UpdateUsage(stripe);
+        }
+
+        std::unique_lock lock { mHashBlockMtx };
         hashBlock = hashBlockIn;
+
+        if (!mUtxoSetHashBlock.has_value() || *mUtxoSetHashBlock != hashBlockOld)
+        {
+            mUtxoSetHashBlock.reset();
+        }
+        else if (utxoSetHashDelta.has_value())
+        {
+            if (!utxoSetHashDelta->broken &&
+                utxoSetHashDelta->from == hashBlockOld &&
+                utxoSetHashDelta->to == hashBlockIn)
+            {
+                // The pending changes are added once the hash is needed.
+                mUtxoSetHash += utxoSetHashDelta->change;
+                mUtxoSetHashPending.insert(
+                    mUtxoSetHashPending.end(),
+                    std::make_move_iterator(utxoSetHashDelta->pending.begin()),
+                    std::make_move_iterator(utxoSetHashDelta->pending.end()));
+                mUtxoSetHashBlock = hashBlockIn;
+            }
+            else
+            {
+                mUtxoSetHashBlock.reset();
+            }
+        }
+        else if (changed || hashBlockIn != hashBlockOld)
+        {
+            mUtxoSetHashBlock.reset();
+        }
+
+        if (!mUtxoSetHashBlock.has_value())
+        {
+            // Releases the blocks the pending changes refer to.
+            mUtxoSetHashPending.clear();
+        }
     }
     return true;
 }
 
-bool CoinsDB::Flush()
+bool CoinsDB::Flush(bool async)
 {
     WPUSMutex::Lock writeLock = mMutex.WriteLock();
-    std::unique_lock lock { mCoinsViewCacheMtx };
 
-    if(hashBlock.IsNull())
+    if (!WaitForFlush())
+    {
+        return false;
+    }
+
+    uint256 hashBlockFlush;
+    std::optional<UtxoSetHash> utxoSetHash;
+    {
+        std::unique_lock lock { mHashBlockMtx };
+        hashBlockFlush = hashBlock;
+        AddPendingUtxoSetHashChanges();
+        if (mUtxoSetHashBlock == hashBlockFlush)
+        {
+            utxoSetHash = mUtxoSetHash;
+        }
+    }
+    if(hashBlockFlush.IsNull())
     {
         // nothing new was added
         return true;
     }
 
-    auto coins = mCache.MoveOutCoins();
+    auto flushed = std::make_shared<FlushedCoins>();
+    for (size_t index = 0; index < NUM_CACHE_STRIPES; ++index)
+    {
+        CacheStripe& stripe = mStripes[index];
+        auto lock = LockStripe(stripe);
+        flushed->coins[index] = stripe.coins.MoveOutCoins();
+        flushed->compactScripts[index].swap(stripe.compactScripts);
+        stripe.compactScriptsUsage = 0;
+        UpdateUsage(stripe);
+    }
+
+    if (!async)
+    {
+        const bool written =
+            DBBatchWrite(*flushed, hashBlockFlush, utxoSetHash);
+
+        // No coin refers to the script bodies anymore.
+        flushed.reset();
+        mScriptBodies.Prune();
+
+        return written;
+    }
+
+    auto write =
+        [this, hashBlockFlush, utxoSetHash](std::shared_ptr<const FlushedCoins> flushed)
+        {
+            bool written = false;
+            try
+            {
+                written =
+                    DBBatchWrite(*flushed, hashBlockFlush, utxoSetHash);
+            }
+            catch (const std::exception& e)
+            {
+                LogPrintf("Error writing coins in the background: %s\n", e.what());
+            }
+            if (!written)
+            {
+                // Keep the coins so that they can still be found.
+                return false;
+            }
+
+            {
+                std::lock_guard lock { mFlushMtx };
+                mFlushedCoins.reset();
+            }
+            // Readers may still hold the coins, their script bodies are then
+            // pruned after the next flush.
+            flushed.reset();
+            mScriptBodies.Prune();
+            return true;
+        };
+
+    std::lock_guard lock { mFlushMtx };
+    mFlushedCoins = flushed;
+    mFlushResult = make_task(mFlushPool, write, std::move(flushed)).share();
+    return true;
+}
+
+bool CoinsDB::WaitForFlush() const
+{
+    std::shared_future<bool> result;
+    {
+        std::lock_guard lock { mFlushMtx };
+        result = mFlushResult;
+    }
+    return !result.valid() || result.get();
+}
+
+bool CoinsDB::HasFlushFailed() const
+{
+    std::lock_guard lock { mFlushMtx };
+    return
+        mFlushResult.valid() &&
+        mFlushResult.wait_for(std::chrono::seconds{0}) == std::future_status::ready &&
+        !mFlushResult.get();
+}
 
-    return DBBatchWrite(coins, hashBlock);
+bool CoinsDB::FindFlushedCoin(const COutPoint& outpoint, std::optional<CoinImpl>& coin) const
+{
+    std::shared_ptr<const FlushedCoins> flushed;
+    {
+        std::lock_guard lock { mFlushMtx };
+        flushed = mFlushedCoins;
+    }
+    return flushed && flushed->FindCoin(GetStripeIndex(outpoint), outpoint, coin);
+}
+
+bool CoinsDB::FlushedCoins::FindCoin(
+    size_t stripe,
+    const COutPoint& outpoint,
+    std::optional<CoinImpl>& coin) const
+{
+    auto it = coins[stripe].find(outpoint);
+    if (it == coins[stripe].end() || !(it->second.flags & CCoinsCacheEntry::DIRTY))
+    {
+        // Not changed by the flush, the database has the coin.
+        return false;
+    }
+
+    const CoinImpl& flushedCoin = it->second.GetCoinImpl();
+    if (flushedCoin.IsSpent())
+    {
+        coin.reset();
+    }
+    else if (flushedCoin.HasScript())
+    {
+        coin = flushedCoin.MakeOwning();
+    }
+    else
+    {
+        auto compact = compactScripts[stripe].find(outpoint);
+        assert(compact != compactScripts[stripe].end());
+        coin = CoinImpl::FromCoinWithScript(ExpandCoin(flushedCoin, compact->second));
+    }
+    return true;
 }
 
 void CoinsDB::Uncache(const std::vector<COutPoint>& vOutpoints)
 {
     WPUSMutex::Lock writeLock = mMutex.WriteLock();
-    std::unique_lock lock { mCoinsViewCacheMtx };
-    mCache.Uncache(vOutpoints);
+
+    std::array<std::vector<COutPoint>, NUM_CACHE_STRIPES> stripeOutpoints;
+    for (const COutPoint& outpoint : vOutpoints)
+    {
+        stripeOutpoints[GetStripeIndex(outpoint)].push_back(outpoint);
+    }
+    for (size_t i = 0; i < NUM_CACHE_STRIPES; ++i)
+    {
+        if (stripeOutpoints[i].empty())
+        {
+            continue;
+        }
+        CacheStripe& stripe = mStripes[i];
+        auto lock = LockStripe(stripe);
+        stripe.coins.Uncache(stripeOutpoints[i]);
+        for (const COutPoint& outpoint : stripeOutpoints[i])
+        {
+            if (!stripe.coins.FetchCoin(outpoint).has_value())
+            {
+                EraseCompactScript(stripe, outpoint);
+            }
+        }
+        UpdateUsage(stripe);
+    }
 }
 
 unsigned int CoinsDB::GetCacheSize() const {
-    std::unique_lock lock { mCoinsViewCacheMtx };
-    return mCache.CachedCoinsCount();
+    size_t size = 0;
+    for (CacheStripe& stripe : mStripes)
+    {
+        auto lock = LockStripe(stripe);
+        size += stripe.coins.CachedCoinsCount();
+    }
+    return size;
 }
 
 std::optional<Coin> CoinsDB::GetCoinByTxId(const TxId& txid) const
@@ -726,7 +1373,11 @@ auto CoinsDBSpan::TryFlush() -> WriteState
     std::unique_ptr<WPUSMutex::Lock, decltype(revertToReadLock)> guard{&mView.mLock, revertToReadLock};
 
     return
-        mDB.BatchWrite(mView.mLock, hashBlock, mCache.MoveOutCoins())
+        mDB.BatchWrite(
+            mView.mLock,
+            hashBlock,
+            mCache.MoveOutCoins(),
+            std::exchange(mUtxoSetHashDelta, std::nullopt))
         ? WriteState::ok
         : WriteState::error;
 }
@@ -10,15 +10,25 @@
 #include "chain.h"
 #include "coins.h"
 #include "dbwrapper.h"
+#include "script/compact_script.h"
+#include "threadpool.h"
 #include "write_preferring_upgradable_mutex.h"
 
+#include <array>
+#include <atomic>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class CBlockFileInfo;
 class CBlockIndex;
+class CDBCompactionController;
 struct CDiskTxPos;
 class uint256;
 
@@ -28,6 +38,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -asynccoinsflush default
+static const bool DEFAULT_ASYNC_COINS_FLUSH = true;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void *) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -68,6 +80,20 @@ private:
     friend class CoinsDB;
 };
 
+/** Counters of one stripe of the CoinsDB cache. */
+struct CoinsCacheStripeStats {
+    //! Number of coins in the stripe.
+    size_t coins;
+    //! Number of those whose script is kept as a CompactScript.
+    size_t compactScripts;
+    //! Number of times the lock of the stripe was taken.
+    uint64_t locks;
+    //! Number of those that had to wait for another thread.
+    uint64_t contended;
+    //! Total time spent waiting, in microseconds.
+    uint64_t waitMicros;
+};
+
 /**
  * CCoinsProvider backed by the coin database (chainstate/)
  * and adds a memory cache of de-serialized coins.
@@ -80,18 +106,82 @@ private:
  * providers down without caring for the threshold limit) so once the cache is
  * full only coins without script are stored in it while coins with script are
  * re-requested from base on every call to GetCoin() that requires a script.
+ *
+ * Large scripts of cached coins are kept as CompactScripts that share their
+ * body with the scripts of other coins, see ScriptBodyPool. Such coins are
+ * stored without script and GetCoin() rebuilds the script on request.
  */
 class CoinsDB {
 private:
     friend class CoinsDBView;
     friend class CoinsDBSpan;
 
+    /**
+     * The cache is split by outpoint into stripes with a lock each so that
+     * threads that fetch different coins do not wait for each other.
+     */
+    static constexpr size_t NUM_CACHE_STRIPES = 16;
+
+    typedef std::unordered_map<COutPoint, CompactScript, SaltedOutpointHasher>
+        CompactScriptMap;
+
+    //! The coins and compact scripts taken out of the cache by a flush, kept
+    //! by stripe as they were in the cache.
+    struct FlushedCoins
+    {
+        std::array<CCoinsMap, NUM_CACHE_STRIPES> coins;
+        std::array<CompactScriptMap, NUM_CACHE_STRIPES> compactScripts;
+
+        /**
+         * Returns false if the flush does not write the coin at outpoint,
+         * otherwise sets coin to the written coin or to nothing if the coin
+         * is erased. stripe is the index of the stripe of outpoint.
+         */
+        bool FindCoin(
+            size_t stripe,
+            const COutPoint& outpoint,
+            std::optional<CoinImpl>& coin) const;
+    };
+
+    // Each stripe on its own cache lines so that the locks and counters of
+    // different stripes are not shared between cores.
+    struct alignas(64) CacheStripe
+    {
+        std::mutex mtx;
+        CoinsStore coins;
+
+        /**
+         * Contains outpoints of this stripe that are currently being loaded
+         * from base view by GetCoin(). This prevents simultaneous loads of the
+         * same coin by multiple threads and enables us not to hold the locks
+         * while loading from base view, which can be slow if it is backed by
+         * disk.
+         */
+        std::set<COutPoint> fetchingCoins;
+
+        /**
+         * Scripts of the coins that are stored without script in coins. A
+         * coin that is dirty and not spent always has its script either in
+         * coins or in here.
+         */
+        CompactScriptMap compactScripts;
+        //! Memory used by compactScripts besides the map.
+        size_t compactScriptsUsage{0};
+
+        //! Memory usage of coins as last added to mCacheUsage.
+        size_t usage{0};
+
+        std::atomic<uint64_t> locks{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> waitMicros{0};
+    };
+
     /**
      * Make mutable so that we can "fill the cache" even from Get-methods
      * declared as "const".
      */
     mutable uint256 hashBlock;
-    mutable CoinsStore mCache;
+    mutable std::array<CacheStripe, NUM_CACHE_STRIPES> mStripes;
 
 public:
     template<typename T> struct UnitTestAccess;
@@ -120,6 +210,8 @@ public:
     CoinsDB(CoinsDB&&) = delete;
     CoinsDB& operator=(CoinsDB&&) = delete;
 
+    ~CoinsDB();
+
     /**
      * Check if we have the given utxo already loaded in this cache.
      */
@@ -131,20 +223,88 @@ public:
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
+    //! Return the sizes and lock contention of the stripes of the cache
+    std::vector<CoinsCacheStripeStats> GetCacheStripeStats() const;
+
+    //! Number of script bodies shared by the compact scripts of the cache
+    size_t GetScriptBodyCount() const { return mScriptBodies.Size(); }
+
     //! Returns true if database is in an older format.
     bool IsOldDBFormat();
 
+    //! Get a cursor to iterate over the coins in the database. Waits for a
+    //! background flush to finish first.
     CCoinsViewDBCursor* Cursor() const;
 
+    //! Get a cursor to iterate over coins by txId. Cursor is positioned at the first key in the source that is at or past target.
+    //! If coin with txId is not found then cursor is at position at first record after txId - source is sorted by txId
+    CCoinsViewDBCursor* Cursor(const TxId &txId) const;
+
     size_t EstimateSize() const;
 
+    //! Return the file layout and write counters of the database.
+    CDBWrapperStats GetDBStats() const { return db.GetStats(); }
+
+    //! Let controller compact the coins of the database.
+    void AddCompactionRanges(CDBCompactionController& controller) const;
+
+    /**
+     * Return the best block and the hash of the UTXO set at it, or nothing if
+     * the hash is not known. The hash is kept up to date with the deltas
+     * passed to BatchWrite() and stored with the best block on Flush().
+     */
+    std::optional<std::pair<uint256, UtxoSetHash>> GetUtxoSetHash() const;
+
+    /**
+     * Set the hash of the UTXO set at block, as computed from all coins.
+     * Ignored and false returned if block is no longer the best block.
+     */
+    bool SetUtxoSetHash(const uint256& block, const UtxoSetHash& utxoSetHash);
+
+    /**
+     * Mark the database as loading the coins of a UTXO snapshot taken at
+     * block, see LoadUtxoSnapshot(). Fails if the database has coins or a
+     * best block.
+     */
+    bool BeginSnapshotLoad(const uint256& block);
+
+    //! Write coins of the snapshot being loaded. May be called from several
+    //! threads at once.
+    bool WriteSnapshotCoins(
+        const std::vector<std::pair<COutPoint, CoinWithScript>>& coins);
+
+    //! Make block, at which all coins of the snapshot were written and
+    //! hashed to utxoSetHash, the best block.
+    bool FinishSnapshotLoad(const uint256& block, const UtxoSetHash& utxoSetHash);
+
+    //! Returns true if the loading of a UTXO snapshot was interrupted.
+    bool IsSnapshotLoadIncomplete() const;
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to
      * be forgotten. If false is returned, the state of this cache (and its
      * backing view) will be undefined.
+     *
+     * If async is true the coins are taken out of the cache and written by a
+     * background thread while the cache is used for the following blocks.
+     * Until they are written GetCoin() finds them among the flushed coins
+     * before it looks in the database. A crash while they are written is
+     * recovered from by replaying the blocks as for any interrupted flush.
+     *
+     * Only one flush is written at a time, a flush first waits for the
+     * previous one. Returns false if that one failed.
+     */
+    bool Flush(bool async = false);
+
+    /**
+     * Wait until the coins of a background flush are written. Returns false
+     * if writing them failed.
      */
-    bool Flush();
+    bool WaitForFlush() const;
+
+    //! Returns true if a background flush finished and failed.
+    bool HasFlushFailed() const;
 
     /**
      * Removes UTXOs with the given outpoints from the cache.
@@ -155,15 +315,14 @@ private:
     uint256 GetBestBlock() const;
 
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
-    //! The passed mapCoins can be modified.
+    //! The passed mapCoins can be modified. The UTXO set hash is updated by
+    //! utxoSetHashDelta if it leads from the current best block to hashBlock
+    //! and forgotten if the coins changed otherwise.
     bool BatchWrite(
         const WPUSMutex::Lock& writeLock,
         const uint256& hashBlock,
-        CCoinsMap&& mapCoins);
-
-    //! Get a cursor to iterate over coins by txId. Cursor is positioned at the first key in the source that is at or past target.
-    //! If coin with txId is not found then cursor is at position at first record after txId - source is sorted by txId
-    CCoinsViewDBCursor* Cursor(const TxId &txId) const;
+        CCoinsMap&& mapCoins,
+        std::optional<UtxoSetHashDelta>&& utxoSetHashDelta);
 
     //! Get any unspent output with a given txid.
     std::optional<Coin> GetCoinByTxId(const TxId &txid) const;
@@ -179,10 +338,67 @@ private:
     }
 
     std::optional<CoinImpl> GetCoin(const COutPoint &outpoint, uint64_t maxScriptSize) const;
+    //! GetCoin() for several outpoints. The coins that are neither cached nor
+    //! being loaded by another thread are read from the database in one
+    //! batch.
+    std::vector<std::optional<CoinImpl>> GetCoins(
+        const std::vector<COutPoint>& outpoints,
+        uint64_t maxScriptSize) const;
     std::optional<CoinImpl> DBGetCoin(const COutPoint &outpoint, uint64_t maxScriptSize) const;
+    //! DBGetCoin() for several outpoints with one CDBWrapper::ReadMany().
+    std::vector<std::optional<CoinImpl>> DBGetCoins(
+        const std::vector<COutPoint>& outpoints,
+        uint64_t maxScriptSize) const;
     uint256 DBGetBestBlock() const;
+
+    size_t GetStripeIndex(const COutPoint& outpoint) const
+    {
+        // Use the top half of the hash, the coins maps of the stripes select
+        // buckets by the whole hash.
+        return (mStripeHasher(outpoint) >> (sizeof(size_t) * 4)) %
+               NUM_CACHE_STRIPES;
+    }
+
+    //! Lock the stripe, counting the times it had to wait for the lock.
+    std::unique_lock<std::mutex> LockStripe(CacheStripe& stripe) const;
+
+    //! Add the change in memory usage of the stripe to mCacheUsage.
+    //! Must be called with the stripe locked after its coins changed.
+    void UpdateUsage(CacheStripe& stripe) const;
+
+    /**
+     * Keep the script of the coin at outpoint as a CompactScript if it is
+     * large enough. The caller must store the coin without script. Must be
+     * called with the stripe locked.
+     */
+    bool TryCompactScript(
+        CacheStripe& stripe,
+        const COutPoint& outpoint,
+        const CScript& script) const;
+
+    /**
+     * Cache the coin at outpoint that was not in the cache and was read from
+     * the database, and return it as GetCoin() does. Must be called with the
+     * stripe locked.
+     */
+    CoinImpl AddFetchedCoin(
+        CacheStripe& stripe,
+        const COutPoint& outpoint,
+        CoinImpl&& coin) const;
+
+    //! Drop the compact script of the coin at outpoint, if it has one. Must
+    //! be called with the stripe locked.
+    void EraseCompactScript(CacheStripe& stripe, const COutPoint& outpoint) const;
+
     std::vector<uint256> GetHeadBlocks() const;
-    bool DBBatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Write the dirty coins of flushed, taking the scripts of the coins
+    //! without script from the compact scripts of their stripe, and the UTXO
+    //! set hash at hashBlock if it is known.
+    bool DBBatchWrite(
+        const FlushedCoins& flushed,
+        const uint256 &hashBlock,
+        const std::optional<UtxoSetHash>& utxoSetHash);
 
     /**
      * A mutex that guarantees that coins from cache will not be removed and
@@ -199,9 +415,10 @@ private:
      */
     uint64_t getMaxScriptLoadingSize(uint64_t requestedMaxScriptSize) const
     {
-        if(mCacheSizeThreshold > mCache.DynamicMemoryUsage())
+        const size_t usage = DynamicMemoryUsage();
+        if(mCacheSizeThreshold > usage)
         {
-            return std::max(requestedMaxScriptSize, mCacheSizeThreshold - mCache.DynamicMemoryUsage());
+            return std::max(requestedMaxScriptSize, mCacheSizeThreshold - usage);
         }
 
         return requestedMaxScriptSize;
@@ -210,21 +427,51 @@ private:
     //! Returns whether we still have space to store a script of certain size
     bool hasSpaceForScript(uint64_t scriptSize) const
     {
-        return mCacheSizeThreshold >= (mCache.DynamicMemoryUsage() + scriptSize);
+        return mCacheSizeThreshold >= (DynamicMemoryUsage() + scriptSize);
     }
 
     uint64_t mCacheSizeThreshold;
 
-    /* A mutex to support a thread safe access to cache. */
-    mutable std::mutex mCoinsViewCacheMtx {};
+    const SaltedOutpointHasher mStripeHasher{};
 
     /**
-     * Contains outpoints that are currently being loaded from base view by
-     * FetchCoin(). This prevents simultaneous loads of the same coin by
-     * multiple threads and enables us not to hold the locks while loading from
-     * base view, which can be slow if it is backed by disk.
+     * Sum of the memory usage of all stripes. Updated without holding all of
+     * their locks, so the cache size threshold is not exact.
      */
-    mutable std::set<COutPoint> mFetchingCoins;
+    mutable std::atomic<size_t> mCacheUsage{0};
+
+    //! Bodies of the compact scripts of all stripes.
+    mutable ScriptBodyPool mScriptBodies;
+
+    /* A mutex to support a thread safe access to hashBlock. */
+    mutable std::mutex mHashBlockMtx {};
+
+    //! Hash of the UTXO set at mUtxoSetHashBlock, valid while that is the
+    //! best block, together with the changes that are still being hashed in
+    //! the background. Guarded by mHashBlockMtx.
+    mutable UtxoSetHash mUtxoSetHash;
+    mutable std::vector<std::shared_future<UtxoSetHash>> mUtxoSetHashPending;
+    mutable std::optional<uint256> mUtxoSetHashBlock;
+
+    //! Add the pending changes to mUtxoSetHash, or forget the hash if one of
+    //! them failed. Must be called with mHashBlockMtx locked.
+    void AddPendingUtxoSetHashChanges() const;
+
+    //! Look the coin up among the coins of a background flush, see
+    //! FlushedCoins::FindCoin().
+    bool FindFlushedCoin(const COutPoint& outpoint, std::optional<CoinImpl>& coin) const;
+
+    //! Guards mFlushedCoins and mFlushResult.
+    mutable std::mutex mFlushMtx;
+    //! Coins that are being written by a background flush, kept until they
+    //! were written successfully.
+    std::shared_ptr<const FlushedCoins> mFlushedCoins;
+    //! Result of the last background flush.
+    std::shared_future<bool> mFlushResult;
+
+    //! Writes the background flushes. Declared after db so that it is
+    //! stopped before the database is closed.
+    CThreadPool<CQueueAdaptor> mFlushPool{"CoinsDBFlushPool", 1};
 };
 
 /**
@@ -277,6 +524,31 @@ public:
 
         return {};
     }
+
+    // GetCoinWithScript() for several outpoints, the coins that are not
+    // cached are read from the database in one batch
+    std::vector<std::optional<CoinWithScript>> GetCoinsWithScript(
+        const std::vector<COutPoint>& outpoints) const
+    {
+        auto coinsData = mDB.GetCoins(outpoints, std::numeric_limits<size_t>::max());
+        std::vector<std::optional<CoinWithScript>> coins;
+        coins.reserve(coinsData.size());
+        for (auto& coinData : coinsData)
+        {
+            if (coinData.has_value())
+            {
+                assert(coinData->HasScript());
+
+                coins.emplace_back(std::move(coinData.value()));
+            }
+            else
+            {
+                coins.emplace_back();
+            }
+        }
+
+        return coins;
+    }
     uint256 GetBestBlock() const override { return mDB.GetBestBlock(); }
     std::vector<uint256> GetHeadBlocks() const { return mDB.GetHeadBlocks(); }
 
@@ -382,10 +654,18 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
+    //! ReadTxIndex() for several txids with one CDBWrapper::ReadMany().
+    std::vector<std::optional<CDiskTxPos>> ReadTxIndex(
+        const std::vector<uint256> &txids);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>> &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
 
+    //! Let controller compact the block index, and the transaction index if
+    //! txIndex is true.
+    void AddCompactionRanges(CDBCompactionController &controller,
+                             bool txIndex) const;
+
     std::unique_ptr<CDBIterator> GetIterator();
 };
 
@@ -121,7 +121,9 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx,
     : tx{std::make_shared<CTransactionWrapper>(_tx, nullptr)},
       nFee{_nFee},
       nTxSize{_tx->GetTotalSize()},
-      nUsageSize{RecursiveDynamicUsage(_tx)},
+      // Every transaction accepted to the mempool had its scripts checked,
+      // which attached its precomputed sighash data to it.
+      nUsageSize{RecursiveDynamicUsage(_tx) + PrecomputedTransactionDataUsage()},
       nTime{_nTime},
       feeDelta{Amount{0}},
       lockPoints{lp},
@@ -0,0 +1,82 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxo_set_hash.h"
+
+#include "streams.h"
+#include "version.h"
+
+namespace {
+
+//! The bytes an output contributes to the hash.
+CDataStream SerializeCoin(const COutPoint &outpoint, const CTxOut &txout,
+                          int32_t height, bool coinbase) {
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << uint32_t(height * 2 + coinbase);
+    ss << txout;
+    return ss;
+}
+
+int64_t GetCoinBogoSize(const CTxOut &txout) {
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
+           8 /* amount */ + 2 /* scriptPubKey len */ +
+           txout.scriptPubKey.size() /* scriptPubKey */;
+}
+
+} // namespace
+
+void UtxoSetHash::AddCoin(const COutPoint &outpoint, const CTxOut &txout,
+                          int32_t height, bool coinbase) {
+    const CDataStream ss = SerializeCoin(outpoint, txout, height, coinbase);
+    mMuHash.Insert(reinterpret_cast<const uint8_t *>(ss.data()), ss.size());
+    ++mTxOuts;
+    mTotalAmount += txout.nValue;
+    mBogoSize += GetCoinBogoSize(txout);
+}
+
+void UtxoSetHash::RemoveCoin(const COutPoint &outpoint, const CTxOut &txout,
+                             int32_t height, bool coinbase) {
+    const CDataStream ss = SerializeCoin(outpoint, txout, height, coinbase);
+    mMuHash.Remove(reinterpret_cast<const uint8_t *>(ss.data()), ss.size());
+    --mTxOuts;
+    mTotalAmount -= txout.nValue;
+    mBogoSize -= GetCoinBogoSize(txout);
+}
+
+UtxoSetHash &UtxoSetHash::operator+=(const UtxoSetHash &other) {
+    mMuHash *= other.mMuHash;
+    mTxOuts += other.mTxOuts;
+    mTotalAmount += other.mTotalAmount;
+    mBogoSize += other.mBogoSize;
+    return *this;
+}
+
+UtxoSetHash &UtxoSetHash::operator-=(const UtxoSetHash &other) {
+    mMuHash /= other.mMuHash;
+    mTxOuts -= other.mTxOuts;
+    mTotalAmount -= other.mTotalAmount;
+    mBogoSize -= other.mBogoSize;
+    return *this;
+}
+
+uint256 UtxoSetHash::GetHash() const {
+    MuHash3072 muHash = mMuHash;
+    return muHash.Finalize();
+}
+
+bool AddPendingUtxoSetHashChanges(
+    UtxoSetHash &hash, std::vector<std::shared_future<UtxoSetHash>> &pending) {
+    bool complete = true;
+    for (const std::shared_future<UtxoSetHash> &change : pending) {
+        try {
+            hash += change.get();
+        } catch (const std::exception &) {
+            // E.g. the pool was stopped before the change was hashed.
+            complete = false;
+        }
+    }
+    pending.clear();
+    return complete;
+}
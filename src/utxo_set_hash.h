@@ -0,0 +1,88 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_UTXO_SET_HASH_H
+#define MVC_UTXO_SET_HASH_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "primitives/transaction.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+/**
+ * Hash and statistics of a set of unspent transaction outputs that do not
+ * depend on the order in which the outputs were added and can be updated as
+ * outputs are added and removed, so that the hash of the UTXO set can be kept
+ * up to date block by block instead of being recomputed from all coins.
+ *
+ * Every output contributes its outpoint, height, coinbase flag and CTxOut to a
+ * MuHash3072. Removing an output that was never added is not detected; the
+ * value is then the hash of a set with a negative element count.
+ */
+class UtxoSetHash {
+public:
+    void AddCoin(const COutPoint &outpoint, const CTxOut &txout,
+                 int32_t height, bool coinbase);
+    void RemoveCoin(const COutPoint &outpoint, const CTxOut &txout,
+                    int32_t height, bool coinbase);
+
+    //! Add the outputs of other to this set and remove the ones it removed.
+    UtxoSetHash &operator+=(const UtxoSetHash &other);
+    //! Undo the changes of other to this set.
+    UtxoSetHash &operator-=(const UtxoSetHash &other);
+
+    //! The 256-bit hash of the set.
+    uint256 GetHash() const;
+
+    int64_t GetTxOutCount() const { return mTxOuts; }
+    Amount GetTotalAmount() const { return mTotalAmount; }
+    //! Same database-independent size metric as gettxoutsetinfo's bogosize.
+    int64_t GetBogoSize() const { return mBogoSize; }
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(mMuHash);
+        READWRITE(mTxOuts);
+        READWRITE(mTotalAmount);
+        READWRITE(mBogoSize);
+    }
+
+private:
+    MuHash3072 mMuHash;
+    int64_t mTxOuts{0};
+    Amount mTotalAmount{0};
+    int64_t mBogoSize{0};
+};
+
+/**
+ * The change of the UTXO set hash from the UTXO set at block from to the one
+ * at block to, as recorded by a coins view while blocks are connected or
+ * disconnected.
+ */
+struct UtxoSetHashDelta {
+    uint256 from;
+    uint256 to;
+    UtxoSetHash change;
+    //! Parts of the change that are still being hashed in the background.
+    std::vector<std::shared_future<UtxoSetHash>> pending;
+    //! Set if the view changed between blocks without recording the change,
+    //! the delta can then not be applied.
+    bool broken{false};
+};
+
+/**
+ * Wait for the pending changes and add them to hash. Returns false if one of
+ * them failed, hash is then incomplete. pending is cleared either way.
+ */
+bool AddPendingUtxoSetHashChanges(
+    UtxoSetHash &hash, std::vector<std::shared_future<UtxoSetHash>> &pending);
+
+#endif // MVC_UTXO_SET_HASH_H
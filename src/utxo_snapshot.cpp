@@ -0,0 +1,502 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxo_snapshot.h"
+
+#include "block_index_store.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "config.h"
+#include "consensus/consensus.h"
+#include "hash.h"
+#include "streams.h"
+#include "task_helpers.h"
+#include "taskcancellation.h"
+#include "threadpool.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <deque>
+#include <future>
+#include <memory>
+
+namespace
+{
+//! "utxo" in little endian.
+constexpr uint32_t UTXO_SNAPSHOT_MAGIC = 0x6f787475;
+constexpr uint32_t UTXO_SNAPSHOT_VERSION = 1;
+
+//! A chunk is closed once its coins take this many bytes. Each chunk is
+//! written to the chain state as one batch when the snapshot is loaded.
+constexpr uint64_t UTXO_SNAPSHOT_CHUNK_SIZE = 4 * ONE_MEBIBYTE;
+
+//! Largest chunk that is loaded: a full chunk followed by a coin with the
+//! largest script a transaction can have.
+constexpr uint64_t MAX_UTXO_SNAPSHOT_CHUNK_SIZE =
+    UTXO_SNAPSHOT_CHUNK_SIZE + MAX_TX_SIZE_CONSENSUS_AFTER_GENESIS;
+
+//! Number of chunks per thread that are processed or wait to be written at
+//! the same time, which bounds the memory used by a dump or load.
+constexpr size_t UTXO_SNAPSHOT_CHUNKS_PER_THREAD = 2;
+
+using SnapshotCoins = std::vector<std::pair<COutPoint, CoinWithScript>>;
+
+struct SnapshotChunk
+{
+    uint32_t coins{0};
+    CDataStream data{SER_DISK, CLIENT_VERSION};
+    uint256 checksum;
+};
+
+UtxoSetHash HashCoins(const SnapshotCoins& coins)
+{
+    UtxoSetHash hash;
+    for (const auto& [outpoint, coin] : coins)
+    {
+        hash.AddCoin(outpoint, coin.GetTxOut(), coin.GetHeight(), coin.IsCoinBase());
+    }
+    return hash;
+}
+
+//! Serialize coins, which must be in database order, into a chunk.
+SnapshotChunk MakeChunk(const SnapshotCoins& coins)
+{
+    SnapshotChunk chunk;
+    chunk.coins = coins.size();
+    for (size_t i = 0; i < coins.size();)
+    {
+        const TxId& txid = coins[i].first.GetTxId();
+        size_t end = i + 1;
+        while (end < coins.size() && coins[end].first.GetTxId() == txid)
+        {
+            ++end;
+        }
+
+        uint64_t count = end - i;
+        chunk.data << txid << VARINT(count);
+        for (; i < end; ++i)
+        {
+            uint32_t n = coins[i].first.GetN();
+            chunk.data << VARINT(n) << coins[i].second;
+        }
+    }
+    chunk.checksum = Hash(chunk.data.begin(), chunk.data.end());
+    return chunk;
+}
+
+//! Check the chunk and return its coins, or nothing if it is corrupt.
+std::optional<SnapshotCoins> ParseChunk(SnapshotChunk& chunk)
+{
+    if (Hash(chunk.data.begin(), chunk.data.end()) != chunk.checksum)
+    {
+        LogPrintf("UTXO snapshot chunk does not match its checksum\n");
+        return {};
+    }
+
+    SnapshotCoins coins;
+    // Every coin takes more than one byte.
+    coins.reserve(std::min<size_t>(chunk.coins, chunk.data.size()));
+    while (!chunk.data.empty())
+    {
+        uint256 txid;
+        uint64_t count = 0;
+        chunk.data >> txid >> VARINT(count);
+        if (count == 0 || count > chunk.coins - coins.size())
+        {
+            LogPrintf("UTXO snapshot chunk has more coins than it declares\n");
+            return {};
+        }
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint32_t n = 0;
+            CoinImpl coin;
+            chunk.data >> VARINT(n) >> coin;
+            if (coin.IsSpent())
+            {
+                LogPrintf("UTXO snapshot chunk contains a spent coin\n");
+                return {};
+            }
+            coins.emplace_back(COutPoint{TxId{txid}, n}, CoinWithScript{std::move(coin)});
+        }
+    }
+    if (coins.size() != chunk.coins)
+    {
+        LogPrintf("UTXO snapshot chunk has fewer coins than it declares\n");
+        return {};
+    }
+    return coins;
+}
+
+void WriteChunk(CAutoFile& file, const SnapshotChunk& chunk)
+{
+    file << chunk.coins << uint64_t(chunk.data.size());
+    file.write(chunk.data.data(), chunk.data.size());
+    file << chunk.checksum;
+}
+
+//! Write the coins of cursor to file, adding them to info.utxoSetHash.
+bool WriteCoins(
+    CAutoFile& file,
+    CCoinsViewDBCursor& cursor,
+    UtxoSnapshotInfo& info,
+    const task::CCancellationToken& token)
+{
+    // Serializing and hashing the coins takes much longer than reading them,
+    // so the chunks are built by the pool and written in order as they are
+    // done.
+    CThreadPool<CQueueAdaptor> pool{"UtxoSnapshotPool"};
+    const size_t maxChunks = pool.getPoolSize() * UTXO_SNAPSHOT_CHUNKS_PER_THREAD;
+    std::deque<std::future<std::pair<SnapshotChunk, UtxoSetHash>>> chunks;
+
+    auto writeFront =
+        [&file, &info, &chunks]
+        {
+            auto [chunk, utxoSetHash] = chunks.front().get();
+            chunks.pop_front();
+            WriteChunk(file, chunk);
+            info.utxoSetHash += utxoSetHash;
+        };
+    auto submit =
+        [&pool, &chunks](SnapshotCoins&& coins)
+        {
+            chunks.push_back(
+                make_task(
+                    pool,
+                    [coins = std::move(coins)]
+                    {
+                        return std::make_pair(MakeChunk(coins), HashCoins(coins));
+                    }));
+        };
+
+    SnapshotCoins coins;
+    uint64_t coinsSize = 0;
+    for (; cursor.Valid(); cursor.Next())
+    {
+        if (token.IsCanceled())
+        {
+            LogPrintf("Writing of the UTXO snapshot canceled\n");
+            return false;
+        }
+
+        COutPoint key;
+        CoinWithScript coin;
+        if (!cursor.GetKey(key) || !cursor.GetValue(coin))
+        {
+            LogPrintf("Unable to read a coin for the UTXO snapshot\n");
+            return false;
+        }
+        coinsSize += GetSerializeSize(coin, SER_DISK, CLIENT_VERSION);
+        coins.emplace_back(key, std::move(coin));
+        if (coinsSize < UTXO_SNAPSHOT_CHUNK_SIZE)
+        {
+            continue;
+        }
+
+        if (chunks.size() >= maxChunks)
+        {
+            writeFront();
+        }
+        submit(std::move(coins));
+        coins.clear();
+        coinsSize = 0;
+    }
+    if (!coins.empty())
+    {
+        submit(std::move(coins));
+    }
+    while (!chunks.empty())
+    {
+        writeFront();
+    }
+
+    file << uint32_t{0};
+    file << info.utxoSetHash;
+    return true;
+}
+//! Read the header of the snapshot at path from file and set block to the
+//! block of the snapshot. Returns false and logs the reason if the file is
+//! not a snapshot for the network of chainparams.
+bool ReadHeader(
+    CAutoFile& file,
+    const fs::path& path,
+    const CChainParams& chainparams,
+    uint256& block)
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    CMessageHeader::MessageMagic netMagic;
+    file >> magic >> version;
+    if (magic != UTXO_SNAPSHOT_MAGIC || version != UTXO_SNAPSHOT_VERSION)
+    {
+        LogPrintf("%s is not a UTXO snapshot of version %d\n",
+                  path.string(), UTXO_SNAPSHOT_VERSION);
+        return false;
+    }
+    file >> FLATDATA(netMagic) >> block;
+
+    if (netMagic != chainparams.NetMagic())
+    {
+        LogPrintf("UTXO snapshot %s is for a different network\n", path.string());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+std::optional<UtxoSnapshotInfo> DumpUtxoSnapshot(
+    const Config& config,
+    const fs::path& path,
+    const task::CCancellationToken& token)
+{
+    const int64_t start = GetTimeMicros();
+
+    // The cursor reads the database as it was when it was created.
+    std::unique_ptr<CCoinsViewDBCursor> cursor;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        cursor.reset(pcoinsTip->Cursor());
+    }
+
+    UtxoSnapshotInfo info;
+    info.block = cursor->GetBestBlock();
+
+    const fs::path tmpPath = path.string() + ".incomplete";
+    try
+    {
+        CAutoFile file{fsbridge::fopen(tmpPath, "wb"), SER_DISK, CLIENT_VERSION};
+        if (file.IsNull())
+        {
+            LogPrintf("Unable to open %s to write the UTXO snapshot\n",
+                      tmpPath.string());
+            return {};
+        }
+
+        CMessageHeader::MessageMagic netMagic = config.GetChainParams().NetMagic();
+        file << UTXO_SNAPSHOT_MAGIC << UTXO_SNAPSHOT_VERSION;
+        file << FLATDATA(netMagic) << info.block;
+        if (!WriteCoins(file, *cursor, info, token))
+        {
+            file.reset();
+            fs::remove(tmpPath);
+            return {};
+        }
+
+        FileCommit(file.Get());
+        file.reset();
+        RenameOver(tmpPath, path);
+    }
+    catch (const std::exception& e)
+    {
+        LogPrintf("Failed to write UTXO snapshot %s: %s\n", path.string(), e.what());
+        fs::remove(tmpPath);
+        return {};
+    }
+
+    LogPrintf("Wrote %d coins at block %s to UTXO snapshot %s in %.6fs\n",
+              info.utxoSetHash.GetTxOutCount(), info.block.ToString(),
+              path.string(), (GetTimeMicros() - start) * 0.000001);
+    return info;
+}
+
+bool LoadUtxoSnapshot(
+    const Config& config,
+    const fs::path& path,
+    const std::optional<uint256>& expectedHash,
+    CoinsDB& db,
+    const task::CCancellationToken& token)
+{
+    const int64_t start = GetTimeMicros();
+    CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull())
+    {
+        LogPrintf("Unable to open UTXO snapshot %s\n", path.string());
+        return false;
+    }
+
+    try
+    {
+        uint256 block;
+        const CChainParams& chainparams = config.GetChainParams();
+        if (!ReadHeader(file, path, chainparams, block))
+        {
+            return false;
+        }
+
+        const CBlockIndex* index = mapBlockIndex.Get(block);
+        if (!index || !index->IsValid(BlockValidity::TRANSACTIONS) ||
+            !index->GetChainTx())
+        {
+            LogPrintf("Block %s of the UTXO snapshot is not in the block index "
+                      "or its transactions are missing\n",
+                      block.ToString());
+            return false;
+        }
+
+        std::optional<uint256> expected = expectedHash;
+        if (!expected.has_value())
+        {
+            auto it = chainparams.UtxoSnapshotHashes().find(block);
+            if (it != chainparams.UtxoSnapshotHashes().end())
+            {
+                expected = it->second;
+            }
+        }
+        if (!expected.has_value())
+        {
+            LogPrintf("No UTXO set hash is known for block %s, set "
+                      "-utxosnapshothash to the muhash that gettxoutsetinfo "
+                      "reports at that block\n",
+                      block.ToString());
+            return false;
+        }
+
+        if (!db.BeginSnapshotLoad(block))
+        {
+            LogPrintf("Unable to load a UTXO snapshot into a chain state that "
+                      "already has coins\n");
+            return false;
+        }
+        LogPrintf("Loading UTXO snapshot %s at block %s, height %d\n",
+                  path.string(), block.ToString(), index->GetHeight());
+
+        // Checking, writing and hashing the chunks is done by the pool while
+        // the next chunks are read. Each chunk is written as one batch with
+        // its coins in key order; LevelDB applies concurrent batches one
+        // after the other.
+        UtxoSetHash utxoSetHash;
+        {
+            CThreadPool<CQueueAdaptor> pool{"UtxoSnapshotPool"};
+            const size_t maxChunks =
+                pool.getPoolSize() * UTXO_SNAPSHOT_CHUNKS_PER_THREAD;
+            std::deque<std::future<std::optional<UtxoSetHash>>> chunks;
+
+            auto finishFront =
+                [&chunks, &utxoSetHash]
+                {
+                    std::optional<UtxoSetHash> chunkHash = chunks.front().get();
+                    chunks.pop_front();
+                    if (!chunkHash.has_value())
+                    {
+                        return false;
+                    }
+                    utxoSetHash += *chunkHash;
+                    return true;
+                };
+
+            while (true)
+            {
+                if (token.IsCanceled())
+                {
+                    LogPrintf("Loading of the UTXO snapshot canceled\n");
+                    return false;
+                }
+
+                SnapshotChunk chunk;
+                file >> chunk.coins;
+                if (chunk.coins == 0)
+                {
+                    break;
+                }
+                uint64_t size = 0;
+                file >> size;
+                if (size > MAX_UTXO_SNAPSHOT_CHUNK_SIZE)
+                {
+                    LogPrintf("UTXO snapshot chunk of %d bytes is too large\n", size);
+                    return false;
+                }
+                chunk.data.resize(size);
+                file.read(chunk.data.data(), size);
+                file >> chunk.checksum;
+
+                if (chunks.size() >= maxChunks && !finishFront())
+                {
+                    return false;
+                }
+                chunks.push_back(
+                    make_task(
+                        pool,
+                        [&db, chunk = std::move(chunk)]() mutable
+                            -> std::optional<UtxoSetHash>
+                        {
+                            std::optional<SnapshotCoins> coins = ParseChunk(chunk);
+                            if (!coins.has_value() || !db.WriteSnapshotCoins(*coins))
+                            {
+                                return {};
+                            }
+                            return HashCoins(*coins);
+                        }));
+            }
+            while (!chunks.empty())
+            {
+                if (!finishFront())
+                {
+                    return false;
+                }
+            }
+        }
+
+        UtxoSetHash fileHash;
+        file >> fileHash;
+        if (fileHash.GetHash() != utxoSetHash.GetHash() ||
+            fileHash.GetTxOutCount() != utxoSetHash.GetTxOutCount())
+        {
+            LogPrintf("Coins of the UTXO snapshot do not match its UTXO set hash\n");
+            return false;
+        }
+        if (utxoSetHash.GetHash() != expected.value())
+        {
+            LogPrintf("UTXO set hash %s of the snapshot does not match the "
+                      "expected %s\n",
+                      utxoSetHash.GetHash().ToString(), expected->ToString());
+            return false;
+        }
+
+        if (!db.FinishSnapshotLoad(block, utxoSetHash))
+        {
+            LogPrintf("Unable to complete loading of the UTXO snapshot\n");
+            return false;
+        }
+
+        LogPrintf("Loaded %d coins at block %s from UTXO snapshot in %.6fs\n",
+                  utxoSetHash.GetTxOutCount(), block.ToString(),
+                  (GetTimeMicros() - start) * 0.000001);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        LogPrintf("Failed to load UTXO snapshot %s: %s\n", path.string(), e.what());
+        return false;
+    }
+}
+
+std::optional<uint256> ReadUtxoSnapshotBlock(
+    const Config& config,
+    const fs::path& path)
+{
+    CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull())
+    {
+        LogPrintf("Unable to open UTXO snapshot %s\n", path.string());
+        return {};
+    }
+
+    try
+    {
+        uint256 block;
+        if (!ReadHeader(file, path, config.GetChainParams(), block))
+        {
+            return {};
+        }
+        return block;
+    }
+    catch (const std::exception& e)
+    {
+        LogPrintf("Failed to read UTXO snapshot %s: %s\n", path.string(), e.what());
+        return {};
+    }
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2021-2024 The MVC developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MVC_UTXO_SNAPSHOT_H
+#define MVC_UTXO_SNAPSHOT_H
+
+#include "fs.h"
+#include "uint256.h"
+#include "utxo_set_hash.h"
+
+#include <optional>
+
+class CoinsDB;
+class Config;
+
+namespace task
+{
+    class CCancellationToken;
+}
+
+/**
+ * A UTXO snapshot holds all coins of the chain state at one block so that a
+ * node that already has the blocks up to that block can build its chain state
+ * from the snapshot instead of connecting all blocks again.
+ *
+ * File format:
+ *
+ *   uint32  UTXO_SNAPSHOT_MAGIC
+ *   uint32  version
+ *   bytes   network magic
+ *   uint256 hash of the block at which the snapshot was taken
+ *   chunks  coins in database order
+ *   uint32  0, ends the chunks
+ *   UtxoSetHash of all coins
+ *
+ * where each chunk is
+ *
+ *   uint32  number of coins
+ *   uint64  size of the coins in bytes
+ *   bytes   coins
+ *   uint256 hash of the coins bytes
+ *
+ * and the coins are grouped by txid, each group being the txid, the number
+ * of coins as VARINT and per coin its output index as VARINT followed by the
+ * coin as stored in the database.
+ *
+ * Every chunk can be checked, parsed and hashed on its own, which lets both
+ * the dump and the load spread the work over threads while the file is
+ * written or read sequentially. Neither keeps more than a few chunks per
+ * thread in memory.
+ */
+struct UtxoSnapshotInfo
+{
+    //! Block at which the snapshot was taken.
+    uint256 block;
+    //! Hash and statistics of the coins in the snapshot.
+    UtxoSetHash utxoSetHash;
+};
+
+/**
+ * Write the coins of pcoinsTip at its current best block to path, which must
+ * not exist yet. The state is flushed first and the coins are read from a
+ * database snapshot, so blocks can be connected while the file is written.
+ *
+ * Returns nothing and logs the reason if the snapshot could not be written.
+ */
+std::optional<UtxoSnapshotInfo> DumpUtxoSnapshot(
+    const Config& config,
+    const fs::path& path,
+    const task::CCancellationToken& token);
+
+/**
+ * Load the coins of the snapshot at path into db, which must not contain any
+ * coins. The block of the snapshot must be in the block index with all its
+ * transactions and the UTXO set hash of the snapshot must match
+ * expectedHash or, if that is not given, the hash that the chain parameters
+ * list for the block.
+ *
+ * db is marked as loading a snapshot until all coins were written and
+ * checked, after which its best block is the block of the snapshot.
+ *
+ * Returns false and logs the reason if the snapshot could not be loaded.
+ */
+bool LoadUtxoSnapshot(
+    const Config& config,
+    const fs::path& path,
+    const std::optional<uint256>& expectedHash,
+    CoinsDB& db,
+    const task::CCancellationToken& token);
+
+/**
+ * Return the block at which the snapshot at path was taken, or nothing and
+ * log the reason if the file is not a snapshot for the network of config.
+ */
+std::optional<uint256> ReadUtxoSnapshotBlock(
+    const Config& config,
+    const fs::path& path);
+
+#endif // MVC_UTXO_SNAPSHOT_H
@@ -25,6 +25,7 @@
 #include "fs.h"
 #include "hash.h"
 #include "init.h"
+#include "merkletreestore.h"
 #include "mining/journal_builder.h"
 #include "net/net.h"
 #include "net/net_processing.h"
@@ -34,14 +35,18 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "processing_block_index.h"
+#include "script/script_profiler.h"
 #include "script/scriptcache.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
+#include "task_helpers.h"
 #include "taskcancellation.h"
+#include "threadpool.h"
 #include "timedata.h"
 #include "tinyformat.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "txhasher.h"
 #include "txn_validator.h"
 #include "ui_interface.h"
 #include "undo.h"
@@ -91,6 +96,7 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fAsyncCoinsFlush = DEFAULT_ASYNC_COINS_FLUSH;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -2197,6 +2203,52 @@ bool GetTransaction(const Config &config, const TxId &txid,
     return false;
 }
 
+bool GetTransactions(const Config &config, const std::vector<TxId> &txids,
+                     std::vector<CTransactionRef> &txs) {
+    LOCK(cs_main);
+
+    txs.assign(txids.size(), nullptr);
+    if (fTxIndex) {
+        std::vector<uint256> toRead;
+        std::vector<size_t> toReadIndex;
+        for (size_t i = 0; i < txids.size(); ++i) {
+            if (!mempool.Exists(txids[i])) {
+                toRead.push_back(txids[i]);
+                toReadIndex.push_back(i);
+            }
+        }
+
+        auto positions = pblocktree->ReadTxIndex(toRead);
+        for (size_t j = 0; j < positions.size(); ++j) {
+            const size_t i = toReadIndex[j];
+            uint256 hashBlock;
+            if (!positions[j].has_value() ||
+                !BlockFileAccess::LoadBlockHashAndTx(*positions[j], hashBlock, txs[i])) {
+                txs[i] = nullptr;
+                continue;
+            }
+            if (txs[i]->GetId() != txids[i]) {
+                return error("%s: txid mismatch", __func__);
+            }
+        }
+    }
+
+    // The transactions that are in the mempool or could not be loaded with
+    // the index are looked up one by one.
+    for (size_t i = 0; i < txids.size(); ++i) {
+        if (!txs[i]) {
+            uint256 hashBlock;
+            bool isGenesisEnabled;
+            if (!GetTransaction(config, txids[i], txs[i], true, hashBlock,
+                                isGenesisEnabled)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CBlock and CBlockIndex
@@ -2454,8 +2506,99 @@ void UpdateCoins(const CTransaction &tx, CCoinsViewCache &inputs, int32_t nHeigh
     UpdateCoins(tx, inputs, txundo, nHeight);
 }
 
+#ifdef COLLECT_METRICS
+namespace {
+/**
+ * Histograms of the statistics of the script profiler: per opcode the
+ * average time of one execution within a VerifyScript() call and per script
+ * template the time of the whole call.
+ */
+class ScriptProfileHistograms
+{
+public:
+    void Add(const uint256& templateHash, const OpcodeProfiles& opcodes, uint64_t nanoseconds)
+    {
+        std::lock_guard lock{ mMtx };
+        for (size_t op = 0; op < opcodes.size(); ++op)
+        {
+            if (opcodes[op].count == 0)
+            {
+                continue;
+            }
+            auto& histogram = mOpcodes[op];
+            if (!histogram)
+            {
+                histogram =
+                    std::make_unique<metrics::Histogram>(
+                        std::string{"SCRIPT_OP_"} + GetOpName(static_cast<opcodetype>(op)) + "_NS",
+                        1000);
+            }
+            histogram->count(opcodes[op].nanoseconds / opcodes[op].count);
+        }
+
+        // Bounded by the number of templates the profiler tracks.
+        auto& histogram = mTemplates[templateHash];
+        if (!histogram)
+        {
+            histogram =
+                std::make_unique<metrics::Histogram>(
+                    "SCRIPT_TEMPLATE_" + templateHash.GetHex() + "_US",
+                    1000);
+        }
+        histogram->count(nanoseconds / 1000);
+    }
+
+    void Dump() const
+    {
+        std::lock_guard lock{ mMtx };
+        for (const auto& histogram : mOpcodes)
+        {
+            if (histogram)
+            {
+                histogram->dump();
+            }
+        }
+        for (const auto& [hash, histogram] : mTemplates)
+        {
+            histogram->dump();
+        }
+    }
+
+private:
+    mutable std::mutex mMtx;
+    std::array<std::unique_ptr<metrics::Histogram>, 256> mOpcodes;
+    std::map<uint256, std::unique_ptr<metrics::Histogram>> mTemplates;
+};
+} // namespace
+#endif
+
+void InitScriptProfileMetrics()
+{
+#ifdef COLLECT_METRICS
+    static ScriptProfileHistograms histograms;
+    static metrics::HistogramWriter histogramLogger {"SCRIPTPROFILE", std::chrono::milliseconds {10000}, []() {
+        histograms.Dump();
+    }};
+    SetScriptProfileObserver(
+        [](const uint256& templateHash, const OpcodeProfiles& opcodes, uint64_t nanoseconds)
+        {
+            histograms.Add(templateHash, opcodes, nanoseconds);
+        });
+#endif
+}
+
 std::optional<bool> CScriptCheck::operator()(const task::CCancellationToken& token)
 {
+#ifdef COLLECT_METRICS
+    static metrics::Histogram durations_script_t_us {"SCRIPT_VERIFY_TIME_US", 10000};
+    static metrics::Histogram durations_script_cpu_us {"SCRIPT_VERIFY_CPU_US", 10000};
+    static metrics::HistogramWriter histogramLogger {"SCRIPT", std::chrono::milliseconds {10000}, []() {
+        durations_script_t_us.dump();
+        durations_script_cpu_us.dump();
+    }};
+    auto timeTimer = metrics::TimedScope<std::chrono::steady_clock, std::chrono::microseconds> { durations_script_t_us };
+    auto cpuTimer = metrics::TimedScope<task::thread_clock, std::chrono::microseconds> { durations_script_cpu_us };
+#endif
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     return
         VerifyScript(
@@ -2785,6 +2928,437 @@ void ShutdownScriptCheckQueues()
     scriptCheckQueuePool.reset();
 }
 
+static std::unique_ptr<CThreadPool<CQueueAdaptor>> coinsPrefetchPool;
+
+void InitCoinsPrefetchPool(size_t numThreads)
+{
+    if (numThreads > 0)
+    {
+        coinsPrefetchPool =
+            std::make_unique<CThreadPool<CQueueAdaptor>>(
+                "CoinsPrefetchPool", numThreads);
+    }
+}
+
+void ShutdownCoinsPrefetchPool()
+{
+    coinsPrefetchPool.reset();
+}
+
+namespace {
+/**
+ * Loads the coins spent by a block into the CoinsDB cache on the threads of
+ * coinsPrefetchPool, while the block is being checked and connected, so that
+ * ConnectBlock() finds them in memory instead of waiting for one database
+ * read after another. Each thread takes the coins in batches that are read
+ * with one database iterator. Coins created by the block itself are skipped
+ * as they can not be in the database.
+ *
+ * The loads share a read lock of the database that is taken in the
+ * constructor, so it must be constructed before the CoinsDBSpan of the block
+ * while no other lock of the database is held by the thread. The lock is
+ * released as soon as the last load finishes so that it never keeps other
+ * blocks from being flushed for longer than the loads take.
+ */
+class CBlockCoinsPrefetch
+{
+public:
+    CBlockCoinsPrefetch(const CoinsDB& db, const CBlock& block)
+    {
+        if (!coinsPrefetchPool)
+        {
+            return;
+        }
+
+        std::unordered_set<TxId, SaltedTxidHasher> blockTxIds;
+        blockTxIds.reserve(block.vtx.size());
+        for (const CTransactionRef& tx : block.vtx)
+        {
+            blockTxIds.insert(tx->GetId());
+        }
+        for (const CTransactionRef& tx : block.vtx)
+        {
+            if (tx->IsCoinBase())
+            {
+                continue;
+            }
+            for (const CTxIn& txin : tx->vin)
+            {
+                if (!blockTxIds.count(txin.prevout.GetTxId()))
+                {
+                    mOutpoints.push_back(txin.prevout);
+                }
+            }
+        }
+        if (mOutpoints.empty())
+        {
+            return;
+        }
+
+        mView = std::make_unique<CoinsDBView>(db);
+        mRunning =
+            std::min(
+                coinsPrefetchPool->getPoolSize(),
+                (mOutpoints.size() + BATCH_SIZE - 1) / BATCH_SIZE);
+        for (size_t i = mRunning; i > 0; --i)
+        {
+            mTasks.push_back(make_task(*coinsPrefetchPool, [this] { Run(); }));
+        }
+    }
+
+    ~CBlockCoinsPrefetch() { Stop(); }
+
+    CBlockCoinsPrefetch(const CBlockCoinsPrefetch&) = delete;
+    CBlockCoinsPrefetch& operator=(const CBlockCoinsPrefetch&) = delete;
+
+    /** Skip the coins that are left and wait for the loads in progress. */
+    void Stop()
+    {
+        mStopped = true;
+        for (std::future<void>& task : mTasks)
+        {
+            // Errors reading the database are reported by ConnectBlock().
+            task.wait();
+        }
+        mTasks.clear();
+        // Tasks that were dropped by a stopped pool did not release it.
+        ReleaseView();
+    }
+
+private:
+    void Run()
+    {
+        try
+        {
+            std::vector<COutPoint> batch;
+            for (size_t i; !mStopped && (i = mNext.fetch_add(BATCH_SIZE)) < mOutpoints.size();)
+            {
+                const size_t end = std::min(i + BATCH_SIZE, mOutpoints.size());
+                batch.assign(mOutpoints.begin() + i, mOutpoints.begin() + end);
+                mView->GetCoinsWithScript(batch);
+            }
+        }
+        catch (...)
+        {
+            FinishTask();
+            throw;
+        }
+        FinishTask();
+    }
+
+    void FinishTask()
+    {
+        if (--mRunning == 0)
+        {
+            ReleaseView();
+        }
+    }
+
+    void ReleaseView()
+    {
+        std::lock_guard lock{ mViewMtx };
+        mView.reset();
+    }
+
+    //! Small enough that the first coins ConnectBlock() needs are loaded soon.
+    static constexpr size_t BATCH_SIZE = 64;
+
+    std::vector<COutPoint> mOutpoints;
+    std::atomic<size_t> mNext{0};
+    std::atomic<bool> mStopped{false};
+    std::atomic<size_t> mRunning{0};
+    std::mutex mViewMtx;
+    std::unique_ptr<CoinsDBView> mView;
+    std::vector<std::future<void>> mTasks;
+};
+} // namespace
+
+static std::unique_ptr<CThreadPool<CQueueAdaptor>> utxoSetHashPool;
+
+void InitUtxoSetHashPool(size_t numThreads)
+{
+    if (numThreads > 0)
+    {
+        utxoSetHashPool =
+            std::make_unique<CThreadPool<CQueueAdaptor>>(
+                "UtxoSetHashPool", numThreads);
+    }
+}
+
+void ShutdownUtxoSetHashPool()
+{
+    utxoSetHashPool.reset();
+}
+
+bool IsUtxoSetHashEnabled()
+{
+    return static_cast<bool>(utxoSetHashPool);
+}
+
+namespace {
+//! Blocks that spend and create fewer coins are hashed on the calling thread.
+constexpr size_t MIN_PARALLEL_UTXO_SET_HASH_COINS = 1000;
+//! Number of txid ranges that ScanUtxoSetHash() hashes in parallel.
+constexpr size_t NUM_UTXO_SET_HASH_SCAN_RANGES = 32;
+
+void AddBlockUtxoSetHashChange(
+    UtxoSetHash& change,
+    const CBlock& block,
+    const CBlockUndo& blockUndo,
+    size_t beginTx,
+    size_t endTx,
+    int32_t height,
+    bool isGenesisEnabled)
+{
+    for (size_t i = beginTx; i < endTx; ++i)
+    {
+        const CTransaction& tx = *block.vtx[i];
+        if (i > 0)
+        {
+            const CTxUndo& txUndo = blockUndo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); ++j)
+            {
+                const CoinWithScript& coin = txUndo.vprevout[j];
+                change.RemoveCoin(
+                    tx.vin[j].prevout,
+                    coin.GetTxOut(),
+                    coin.GetHeight(),
+                    coin.IsCoinBase());
+            }
+        }
+
+        const TxId txid = tx.GetId();
+        for (size_t o = 0; o < tx.vout.size(); ++o)
+        {
+            // Same as CCoinsViewCache::AddCoin(), unspendable outputs never
+            // become coins.
+            if (!tx.vout[o].scriptPubKey.IsUnspendable(isGenesisEnabled))
+            {
+                change.AddCoin(
+                    COutPoint(txid, o), tx.vout[o], height, tx.IsCoinBase());
+            }
+        }
+    }
+}
+
+//! Hash the coins from the position of cursor up to the first one whose txid
+//! starts with endByte.
+std::optional<UtxoSetHash> ScanUtxoSetHashRange(
+    CCoinsViewDBCursor& cursor,
+    unsigned int endByte,
+    const task::CCancellationToken& token)
+{
+    UtxoSetHash hash;
+    for (; cursor.Valid(); cursor.Next())
+    {
+        if (token.IsCanceled())
+        {
+            return {};
+        }
+
+        COutPoint key;
+        CoinWithScript coin;
+        if (!cursor.GetKey(key) || !cursor.GetValue(coin))
+        {
+            error("%s: unable to read value", __func__);
+            return {};
+        }
+        if (*key.GetTxId().begin() >= endByte)
+        {
+            break;
+        }
+        hash.AddCoin(key, coin.GetTxOut(), coin.GetHeight(), coin.IsCoinBase());
+    }
+    return hash;
+}
+} // namespace
+
+namespace {
+/**
+ * Split the transactions of block into ranges [begin, end) that are hashed
+ * on the UTXO set hash pool, with about the same number of coins and a few
+ * per thread so that one large transaction does not keep the other threads
+ * waiting. Small blocks are one range.
+ */
+std::vector<std::pair<size_t, size_t>> GetUtxoSetHashRanges(const CBlock& block)
+{
+    size_t numCoins = 0;
+    for (const CTransactionRef& tx : block.vtx)
+    {
+        numCoins += tx->vin.size() + tx->vout.size();
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (!utxoSetHashPool || numCoins < MIN_PARALLEL_UTXO_SET_HASH_COINS)
+    {
+        ranges.emplace_back(0, block.vtx.size());
+        return ranges;
+    }
+
+    const size_t coinsPerRange = numCoins / (utxoSetHashPool->getPoolSize() * 4) + 1;
+    size_t beginTx = 0;
+    size_t rangeCoins = 0;
+    for (size_t i = 0; i < block.vtx.size(); ++i)
+    {
+        rangeCoins += block.vtx[i]->vin.size() + block.vtx[i]->vout.size();
+        if (rangeCoins < coinsPerRange && i + 1 < block.vtx.size())
+        {
+            continue;
+        }
+        ranges.emplace_back(beginTx, i + 1);
+        beginTx = i + 1;
+        rangeCoins = 0;
+    }
+    return ranges;
+}
+} // namespace
+
+UtxoSetHash GetBlockUtxoSetHashChange(
+    const CBlock& block,
+    const CBlockUndo& blockUndo,
+    int32_t height,
+    int32_t genesisActivationHeight)
+{
+    assert(blockUndo.vtxundo.size() + 1 == block.vtx.size());
+    const bool isGenesisEnabled = height >= genesisActivationHeight;
+
+    UtxoSetHash change;
+    const std::vector<std::pair<size_t, size_t>> ranges = GetUtxoSetHashRanges(block);
+    if (ranges.size() == 1)
+    {
+        AddBlockUtxoSetHashChange(
+            change, block, blockUndo, 0, block.vtx.size(), height, isGenesisEnabled);
+        return change;
+    }
+
+    std::vector<std::future<UtxoSetHash>> tasks;
+    for (const auto& [beginTx, endTx] : ranges)
+    {
+        tasks.push_back(
+            make_task(
+                *utxoSetHashPool,
+                [&block, &blockUndo, beginTx = beginTx, endTx = endTx, height, isGenesisEnabled]
+                {
+                    UtxoSetHash rangeChange;
+                    AddBlockUtxoSetHashChange(
+                        rangeChange, block, blockUndo, beginTx, endTx, height, isGenesisEnabled);
+                    return rangeChange;
+                }));
+    }
+
+    // The tasks refer to the block, wait for all of them before rethrowing.
+    for (std::future<UtxoSetHash>& task : tasks)
+    {
+        task.wait();
+    }
+    for (std::future<UtxoSetHash>& task : tasks)
+    {
+        change += task.get();
+    }
+    return change;
+}
+
+std::vector<std::shared_future<UtxoSetHash>> StartBlockUtxoSetHashChange(
+    const std::shared_ptr<const CBlock>& block,
+    const std::shared_ptr<const CBlockUndo>& blockUndo,
+    int32_t height,
+    int32_t genesisActivationHeight)
+{
+    assert(utxoSetHashPool);
+    assert(blockUndo->vtxundo.size() + 1 == block->vtx.size());
+    const bool isGenesisEnabled = height >= genesisActivationHeight;
+
+    std::vector<std::shared_future<UtxoSetHash>> tasks;
+    for (const auto& [beginTx, endTx] : GetUtxoSetHashRanges(*block))
+    {
+        tasks.push_back(
+            make_task(
+                *utxoSetHashPool,
+                [block, blockUndo, beginTx = beginTx, endTx = endTx, height, isGenesisEnabled]
+                {
+                    UtxoSetHash rangeChange;
+                    AddBlockUtxoSetHashChange(
+                        rangeChange, *block, *blockUndo, beginTx, endTx, height, isGenesisEnabled);
+                    return rangeChange;
+                }).share());
+    }
+    return tasks;
+}
+
+std::optional<std::pair<uint256, UtxoSetHash>> ScanUtxoSetHash(
+    const task::CCancellationToken& token)
+{
+    // Each cursor sees the database as it was when the cursor was created, so
+    // they are all created while no flush can change it.
+    std::vector<std::unique_ptr<CCoinsViewDBCursor>> cursors;
+    uint256 bestBlock;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        for (size_t i = 0; i < NUM_UTXO_SET_HASH_SCAN_RANGES; ++i)
+        {
+            uint256 start;
+            *start.begin() = uint8_t(i * 256 / NUM_UTXO_SET_HASH_SCAN_RANGES);
+            cursors.emplace_back(pcoinsTip->Cursor(TxId{start}));
+            assert(cursors.back()->GetBestBlock() ==
+                   cursors.front()->GetBestBlock());
+        }
+        bestBlock = cursors.front()->GetBestBlock();
+    }
+
+    auto scanRange =
+        [&cursors, &token](size_t i)
+        {
+            return
+                ScanUtxoSetHashRange(
+                    *cursors[i],
+                    (i + 1) * 256 / NUM_UTXO_SET_HASH_SCAN_RANGES,
+                    token);
+        };
+
+    std::vector<std::optional<UtxoSetHash>> rangeHashes;
+    if (utxoSetHashPool)
+    {
+        // A pool of its own, the scan takes long and must not keep blocks from
+        // being hashed on utxoSetHashPool meanwhile.
+        CThreadPool<CQueueAdaptor> scanPool{
+            "UtxoSetHashScanPool", utxoSetHashPool->getPoolSize()};
+        std::vector<std::future<std::optional<UtxoSetHash>>> tasks;
+        for (size_t i = 0; i < cursors.size(); ++i)
+        {
+            tasks.push_back(make_task(scanPool, scanRange, i));
+        }
+        // The tasks refer to the cursors, wait for all of them before
+        // rethrowing.
+        for (auto& task : tasks)
+        {
+            task.wait();
+        }
+        for (auto& task : tasks)
+        {
+            rangeHashes.push_back(task.get());
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < cursors.size(); ++i)
+        {
+            rangeHashes.push_back(scanRange(i));
+        }
+    }
+
+    UtxoSetHash hash;
+    for (const std::optional<UtxoSetHash>& rangeHash : rangeHashes)
+    {
+        if (!rangeHash.has_value())
+        {
+            return {};
+        }
+        hash += *rangeHash;
+    }
+    return std::make_pair(bestBlock, hash);
+}
+
 uint32_t GetBlockScriptFlags(const Config& config, const CBlockIndex* pChainTip)
 {
     const Consensus::Params &consensusparams =
@@ -2857,7 +3431,8 @@ public:
         CBlockIndex* pindex_,
         CCoinsViewCache& view_,
         const arith_uint256& mostWorkOnChain_,
-        bool fJustCheck_ )
+        bool fJustCheck_,
+        const std::shared_ptr<const CBlock>& sharedBlock_ )
     : config{ config_ }
     , block{ block_ }
     , state{ state_ }
@@ -2866,6 +3441,7 @@ public:
     , mostWorkOnChain{ mostWorkOnChain_ }
     , fJustCheck{ fJustCheck_ }
     , parallelBlockValidation{ parallelBlockValidation_ }
+    , sharedBlock{ sharedBlock_ }
     {}
 
     bool Connect( const task::CCancellationToken& token )
@@ -2895,6 +3471,11 @@ public:
         if (block.GetHash() == consensusParams.hashGenesisBlock) {
             if (!fJustCheck) {
                 view.SetBestBlock(pindex->GetBlockHash());
+                if (IsUtxoSetHashEnabled()) {
+                    // The genesis block adds no coins.
+                    view.AddUtxoSetHashChange(
+                        hashPrevBlock, pindex->GetBlockHash(), UtxoSetHash{});
+                }
             }
 
             return true;
@@ -3071,6 +3652,31 @@ public:
 
         // add this block to the view's block chain
         view.SetBestBlock(pindex->GetBlockHash());
+        if (IsUtxoSetHashEnabled() && sharedBlock)
+        {
+            // Hashed in the background while cs_main is held, the coins
+            // database waits for the change only once it needs the hash.
+            view.AddUtxoSetHashChange(
+                hashPrevBlock,
+                pindex->GetBlockHash(),
+                UtxoSetHash{},
+                StartBlockUtxoSetHashChange(
+                    sharedBlock,
+                    std::make_shared<const CBlockUndo>(std::move(blockundo)),
+                    pindex->GetHeight(),
+                    config.GetGenesisActivationHeight()));
+        }
+        else if (IsUtxoSetHashEnabled())
+        {
+            view.AddUtxoSetHashChange(
+                hashPrevBlock,
+                pindex->GetBlockHash(),
+                GetBlockUtxoSetHashChange(
+                    block,
+                    blockundo,
+                    pindex->GetHeight(),
+                    config.GetGenesisActivationHeight()));
+        }
 
         int64_t nTime5 = GetTimeMicros();
         nTimeIndex += nTime5 - nTime4;
@@ -3394,6 +4000,8 @@ private:
     const arith_uint256& mostWorkOnChain;
     bool fJustCheck;
     bool parallelBlockValidation;
+    //! Owner of block if the caller has one, see ConnectBlock().
+    std::shared_ptr<const CBlock> sharedBlock;
 };
 
 /**
@@ -3402,6 +4010,9 @@ private:
  * done; ConnectBlock() can fail if those validity checks fail (among other
  * reasons).
  *
+ * If sharedBlock owns block, the change of the UTXO set hash is hashed in the
+ * background rather than before ConnectBlock() returns.
+ *
  * THROWS (only when parallelBlockValidation is set to true):
  *     - CBestBlockAttachmentCancellation when chain tip has changed while cs_main
  *       was unlocked (a different best block candidate has finished validation
@@ -3424,7 +4035,8 @@ static bool ConnectBlock(
     CBlockIndex *pindex,
     CCoinsViewCache &view,
     const arith_uint256& mostWorkOnChain,
-    bool fJustCheck = false)
+    bool fJustCheck = false,
+    const std::shared_ptr<const CBlock>& sharedBlock = nullptr)
 {
     BlockConnector connector{
         parallelBlockValidation,
@@ -3434,7 +4046,8 @@ static bool ConnectBlock(
         pindex,
         view,
         mostWorkOnChain,
-        fJustCheck };
+        fJustCheck,
+        sharedBlock };
 
     return connector.Connect( token );
 }
@@ -3459,6 +4072,9 @@ bool FlushStateToDisk(
     bool fDoFullFlush = false;
     int64_t nNow = 0;
     try {
+        if (pcoinsTip->HasFlushFailed()) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
         {
             LOCK(pBlockFileInfoStore->GetLock());
             if (fPruneMode && (fCheckForPruning || nManualPruneHeight > 0) &&
@@ -3564,8 +4180,13 @@ bool FlushStateToDisk(
                     return state.Error("out of disk space");
                 }
                 // Flush the chainstate (which may refer to block index
-                // entries).
-                if (!pcoinsTip->Flush()) {
+                // entries). Unless the caller needs the coins on disk now or
+                // block files are pruned, they are written in the background
+                // while blocks continue to be connected.
+                const bool fAsync = fAsyncCoinsFlush &&
+                                    mode != FLUSH_STATE_ALWAYS &&
+                                    !fFlushForPrune;
+                if (!pcoinsTip->Flush(fAsync)) {
                     return AbortNode(state, "Failed to write to coin database");
                 }
                 nLastFlush = nNow;
@@ -3876,6 +4497,7 @@ static bool ConnectTip(
     }
 
     const CBlock &blockConnecting = *pthisBlock;
+    CBlockCoinsPrefetch prefetch{ *pcoinsTip, blockConnecting };
 
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
@@ -3899,11 +4521,15 @@ static bool ConnectTip(
                 state,
                 pindexNew,
                 pCoinsTipSpan,
-                mostWorkOnChain);
+                mostWorkOnChain,
+                false,
+                pthisBlock);
 
         // re-enable tracing of events if it was disabled
         connectTrace.TracePoolEntryRemovedEvents(true);
 
+        prefetch.Stop();
+
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid()) {
@@ -5039,7 +5665,8 @@ static bool CheckBlockHeader(
 bool CheckBlock(const Config &config, const CBlock &block,
                 CValidationState &state,
                 int32_t blockHeight,
-                BlockValidationOptions validationOptions) {
+                BlockValidationOptions validationOptions,
+                std::unique_ptr<CMerkleTree>* merkleTreeOut) {
     // These are checks that are independent of context.
     if (block.fChecked) {
         return true;
@@ -5054,7 +5681,20 @@ bool CheckBlock(const Config &config, const CBlock &block,
     // Check the merkle root.
     if (validationOptions.shouldValidateMerkleRoot()) {
         bool mutated;
-        uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
+        uint256 hashMerkleRoot2;
+        // Big blocks get their whole Merkle tree calculated in parallel, so
+        // that the tree can be cached for merkle proofs once the block is
+        // connected instead of being recalculated from disk on the first
+        // request.
+        std::unique_ptr<CMerkleTree> merkleTree;
+        if (pMerkleTreeFactory &&
+            block.vtx.size() >= MIN_TRANSACTIONS_FOR_PARALLEL_MERKLE_TREE) {
+            merkleTree = pMerkleTreeFactory->CalculateMerkleTree(block, blockHeight);
+            hashMerkleRoot2 = merkleTree->GetMerkleRoot();
+            mutated = merkleTree->IsMutated();
+        } else {
+            hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
+        }
         if (config.GetChainParams().NetworkIDString() == CBaseChainParams::MAIN && blockHeight == 0) {
             hashMerkleRoot2 = uint256S("da2b9eb7e8a3619734a17b55c47bdd6fd855b0afa9c7e14e3a164a279e51bba9");
         }
@@ -5068,6 +5708,10 @@ bool CheckBlock(const Config &config, const CBlock &block,
         if (mutated) {
             return state.CorruptionOrDoS("bad-txns-duplicate", "duplicate transaction");
         }
+
+        if (merkleTreeOut) {
+            *merkleTreeOut = std::move(merkleTree);
+        }
     }
 
     // All potential-corruption validation must be done before we do any
@@ -5718,6 +6362,7 @@ std::function<bool()> ProcessNewBlockWithAsyncBestChainActivation(
     const BlockValidationOptions& validationOptions)
 {
     auto guard = CBlockProcessing::GetCountGuard();
+    CMerkleTreeRef merkleTree;
 
     {
         CBlockIndex *pindex = nullptr;
@@ -5738,7 +6383,9 @@ std::function<bool()> ProcessNewBlockWithAsyncBestChainActivation(
 
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
-        bool ret = CheckBlock(config, *pblock, state, pindexPrev->GetHeight() + 1, validationOptions);
+        std::unique_ptr<CMerkleTree> calculatedMerkleTree;
+        bool ret = CheckBlock(config, *pblock, state, pindexPrev->GetHeight() + 1, validationOptions, &calculatedMerkleTree);
+        merkleTree = std::move(calculatedMerkleTree);
 
         LOCK(cs_main);
 
@@ -5759,7 +6406,7 @@ std::function<bool()> ProcessNewBlockWithAsyncBestChainActivation(
     NotifyHeaderTip();
 
     auto bestChainActivation =
-        [&config, pblock, guard, token]
+        [&config, pblock, guard, token, merkleTree]
         {
             // dummyState is used to report errors, not block related invalidity - ignore it
             // (see description of ActivateBestChain)
@@ -5777,6 +6424,16 @@ std::function<bool()> ProcessNewBlockWithAsyncBestChainActivation(
                 return error("%s: ActivateBestChain failed", __func__);
             }
 
+            // Keep the Merkle tree calculated by CheckBlock() only if the
+            // block made it into the active chain.
+            if (merkleTree) {
+                LOCK(cs_main);
+                const CBlockIndex* pindex = mapBlockIndex.Get(pblock->GetHash());
+                if (pindex && chainActive.Contains(pindex)) {
+                    pMerkleTreeFactory->Insert(pblock->GetHash(), merkleTree, config);
+                }
+            }
+
             return true;
         };
 
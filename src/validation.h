@@ -34,6 +34,7 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <thread>
@@ -42,10 +43,12 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CConnman;
 class CInv;
+class CMerkleTree;
 class Config;
 class CScriptCheck;
 class CTxMemPool;
@@ -102,6 +105,14 @@ static const unsigned int DEFAULT_PREFERRED_BLOCKFILE_SIZE = 0x8000000; // 128 M
 static const int MAX_SCRIPTCHECK_THREADS = 64;
 /** -threadsperblock default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads that prefetch the coins spent by a block */
+static const int MAX_UTXO_PREFETCH_THREADS = 64;
+/** -utxoprefetchthreads default (0 = prefetching disabled) */
+static const int DEFAULT_UTXO_PREFETCH_THREADS = 4;
+/** Maximum number of threads that update the UTXO set hash */
+static const int MAX_UTXO_SET_HASH_THREADS = 64;
+/** -utxosethashthreads default (0 = UTXO set hash not maintained) */
+static const int DEFAULT_UTXO_SET_HASH_THREADS = 4;
 /** Number of blocks that can be requested at any given time from a single peer.
  */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
@@ -226,6 +237,8 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Whether coins cache flushes that nobody waits for run in the background. */
+extern bool fAsyncCoinsFlush;
 extern size_t nCoinCacheUsage;
 
 /**
@@ -529,6 +542,67 @@ void InitScriptCheckQueues(const Config& config, boost::thread_group& threadGrou
 //! Shutdown script checking pool.
 void ShutdownScriptCheckQueues();
 
+/**
+ * Initialize the pool of threads that load the coins spent by a block before
+ * it is connected. With numThreads of 0 coins are not prefetched.
+ */
+void InitCoinsPrefetchPool(size_t numThreads);
+//! Shutdown coins prefetching pool.
+void ShutdownCoinsPrefetchPool();
+
+/**
+ * In builds with metrics, write the statistics of the script profiler to the
+ * log as histograms per opcode and per script template. Does nothing in
+ * other builds.
+ */
+void InitScriptProfileMetrics();
+
+/**
+ * Initialize the pool of threads that update the UTXO set hash as blocks are
+ * connected and disconnected. With numThreads of 0 the UTXO set hash is not
+ * maintained.
+ */
+void InitUtxoSetHashPool(size_t numThreads);
+//! Shutdown UTXO set hash pool.
+void ShutdownUtxoSetHashPool();
+
+//! Whether the UTXO set hash is maintained, see InitUtxoSetHashPool().
+bool IsUtxoSetHashEnabled();
+
+/**
+ * Return the change of the UTXO set hash by connecting block at height, which
+ * removes the coins in blockUndo and adds the spendable outputs of the block.
+ */
+UtxoSetHash GetBlockUtxoSetHashChange(
+    const CBlock& block,
+    const CBlockUndo& blockUndo,
+    int32_t height,
+    int32_t genesisActivationHeight);
+
+/**
+ * Same as GetBlockUtxoSetHashChange() but the change is hashed on the UTXO
+ * set hash pool and returned in parts that are still being hashed. The parts
+ * keep block and blockUndo alive. Must only be called if
+ * IsUtxoSetHashEnabled().
+ */
+std::vector<std::shared_future<UtxoSetHash>> StartBlockUtxoSetHashChange(
+    const std::shared_ptr<const CBlock>& block,
+    const std::shared_ptr<const CBlockUndo>& blockUndo,
+    int32_t height,
+    int32_t genesisActivationHeight);
+
+/**
+ * Compute the hash of the UTXO set at the best block of pcoinsTip from all
+ * coins in the database. The coins are split into ranges of txids that are
+ * hashed in parallel on as many threads as the UTXO set hash pool has, or on
+ * the calling thread if there is no pool. The state is flushed to disk first.
+ *
+ * Returns the block and the hash, or nothing if the scan was canceled or a
+ * coin could not be read.
+ */
+std::optional<std::pair<uint256, UtxoSetHash>> ScanUtxoSetHash(
+    const task::CCancellationToken& token);
+
 /**
  * Check whether we are doing an initial block download (synchronizing from disk
  * or network)
@@ -553,6 +627,14 @@ std::string GetWarnings(const std::string &strFor);
 bool GetTransaction(const Config &config, const TxId &txid, CTransactionRef &tx,
     bool fAllowSlow, uint256 &hashBlock, bool& isGenesisEnabled);
 
+/**
+ * Retrieve several transactions as GetTransaction() with fAllowSlow does.
+ * With -txindex the positions of the transactions that are not in the memory
+ * pool are looked up in one batch. Returns false if any of them is not found.
+ */
+bool GetTransactions(const Config &config, const std::vector<TxId> &txids,
+    std::vector<CTransactionRef> &txs);
+
 /**
  * Find the best known block, and make it the active tip of the block chain.
  * If it fails, the tip is not updated.
@@ -1029,10 +1111,16 @@ public:
  *
  * Returns true if the provided block is valid (has valid header,
  * transactions are valid, block is a valid size, etc.)
+ *
+ * If merkleTree is not null it is set to the Merkle tree of the block when
+ * the tree was calculated to check the Merkle root of a big block. The block
+ * is not known to be valid yet, so the caller may only cache the tree once
+ * the block is connected.
  */
 bool CheckBlock(
     const Config &Config, const CBlock &block, CValidationState &state, int32_t blockHeight,
-    BlockValidationOptions validationOptions = BlockValidationOptions());
+    BlockValidationOptions validationOptions = BlockValidationOptions(),
+    std::unique_ptr<CMerkleTree>* merkleTree = nullptr);
 
 /**
  * Context dependent validity checks for non coinbase transactions. This